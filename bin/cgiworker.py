@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+
+''' Persistent worker for Python CGI scripts.
+
+The server starts this with the path of a script and talks to it over a Unix
+socket on standard input.  Each request is a native-endian 32-bit length
+followed by that many bytes of NUL terminated NAME=VALUE environment strings.
+The script is run in this interpreter with that environment and its standard
+output captured, and the response is the length of the output followed by the
+output itself.  The worker exits once the server closes the socket.
+'''
+
+import io
+import os
+import socket
+import struct
+import sys
+import traceback
+
+# Constants
+
+FRAME = struct.Struct('=I')
+
+# Functions
+
+def usage(status=0):
+    progname = os.path.basename(sys.argv[0])
+    print('''Usage: {} SCRIPT
+
+Run Python CGI SCRIPT for each request framed on standard input (a Unix socket).
+    '''.format(progname), file=sys.stderr)
+    sys.exit(status)
+
+def receive(connection, length):
+    ''' Receive exactly length bytes from connection (None at end of file). '''
+    data = b''
+    while len(data) < length:
+        chunk = connection.recv(length - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+def compile_script(path, cache):
+    ''' Compile script, reusing the cached code until the script changes.
+
+    - path:     Path to script
+    - cache:    Tuple of modification time and code of previous compile
+
+    Return the new cache tuple.
+    '''
+    mtime = os.stat(path).st_mtime_ns
+    if cache and cache[0] == mtime:
+        return cache
+
+    with open(path, 'rb') as stream:
+        source = stream.read()
+
+    return (mtime, compile(source, path, 'exec'))
+
+def run(code, path, environment):
+    ''' Run compiled script with environment and return its standard output. '''
+    output = io.TextIOWrapper(io.BytesIO(), encoding='utf-8', write_through=True)
+    stdout = sys.stdout
+    stdin  = sys.stdin
+
+    os.environ.clear()
+    os.environ.update(environment)
+
+    sys.stdout = output
+    sys.stdin  = io.TextIOWrapper(io.BytesIO())
+    sys.argv   = [path]
+    try:
+        exec(code, {'__name__': '__main__', '__file__': path})
+    except SystemExit:
+        pass
+    except Exception:
+        traceback.print_exc(file=sys.stderr)
+        output = io.TextIOWrapper(io.BytesIO(), encoding='utf-8', write_through=True)
+        output.write('Status: 500 Internal Server Error\r\nContent-Type: text/plain\r\n\r\n')
+    finally:
+        sys.stdout = stdout
+        sys.stdin  = stdin
+
+    output.flush()
+    return output.buffer.getvalue()
+
+def main():
+    arguments = sys.argv[1:]
+
+    if len(arguments) != 1:
+        usage(1)
+
+    path       = arguments[0]
+    connection = socket.socket(fileno=sys.stdin.fileno())
+    cache      = None
+
+    sys.path.insert(0, os.path.dirname(path))
+
+    # Serve requests until the server closes the connection
+    while True:
+        header = receive(connection, FRAME.size)
+        if header is None:
+            break
+
+        data = receive(connection, FRAME.unpack(header)[0])
+        if data is None:
+            break
+
+        environment = {}
+        for variable in data.split(b'\0'):
+            if b'=' in variable:
+                name, value = variable.split(b'=', 1)
+                environment[name.decode()] = value.decode(errors='replace')
+
+        try:
+            cache  = compile_script(path, cache)
+            output = run(cache[1], path, environment)
+        except Exception:
+            traceback.print_exc(file=sys.stderr)
+            output = b'Status: 500 Internal Server Error\r\nContent-Type: text/plain\r\n\r\n'
+
+        connection.sendall(FRAME.pack(len(output)) + output)
+
+# Main execution
+
+if __name__ == '__main__':
+    main()
+
+# vim: set sts=4 sw=4 ts=8 expandtab ft=python:
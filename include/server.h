@@ -3,10 +3,14 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include <netdb.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
 /* Constants */
@@ -20,6 +24,10 @@
 typedef enum {
     SINGLE,                             /**< Single connection */
     FORKING,                            /**< Process per connection */
+    EVENT,                              /**< Event loop (epoll) */
+    PREFORK,                            /**< Pool of pre-forked processes */
+    THREADED,                           /**< Pool of worker threads */
+    URING,                              /**< Event loop (io_uring) */
     UNKNOWN
 } ServerMode;
 
@@ -29,73 +37,420 @@ extern char *Port;                      /**< Port number */
 extern char *MimeTypesPath;             /**< Path to mime.types file */
 extern char *DefaultMimeType;           /**< Default file mimetype */
 extern char *RootPath;                  /**< Path to root directory */
+extern int   RootFd;                    /**< Root directory (held open for resolving request paths) */
+extern size_t Workers;                  /**< Number of workers */
+extern size_t MaxRequests;              /**< Requests per worker before recycling (0 = unlimited) */
+extern size_t Acceptors;                /**< Number of acceptor threads */
+extern int    KeepAliveTimeout;         /**< Idle seconds before closing persistent connections (0 = disabled) */
+extern size_t KeepAliveRequests;        /**< Maximum requests per persistent connection */
+extern int    FileCacheTTL;             /**< Seconds before cached file metadata is revalidated (0 = disabled) */
+extern size_t ResponseCacheBudget;      /**< Bytes of small file responses kept in memory (0 = disabled) */
+extern size_t ResponseCacheMaxObject;   /**< Largest file kept in response cache */
+extern size_t CompressCacheBudget;      /**< Bytes of compressed responses kept in memory (0 = disabled) */
+extern size_t CompressMaxObject;        /**< Largest file compressed on the fly */
+extern char  *ScriptWorkerLauncher;     /**< Persistent script worker program (NULL = disabled) */
+extern char  *ScriptWorkerExtension;    /**< Extension of scripts served by persistent workers */
+extern size_t ScriptWorkers;            /**< Persistent workers per script */
+extern size_t ScriptMaxRequests;        /**< Requests per script worker before recycling (0 = unlimited) */
+extern size_t ScriptQueueLimit;         /**< Requests allowed to wait for a script worker */
+extern int    DeferAccept;              /**< Seconds listener waits for request data before accepting (0 = disabled) */
+extern int    FastOpenQueue;            /**< Pending TCP Fast Open requests allowed (0 = disabled) */
+extern int    CGITimeout;               /**< Seconds before CGI scripts are killed (0 = unlimited) */
+extern char  *StatusPath;               /**< URI of metrics endpoint (empty = disabled) */
 
-/* Logging Macros */
+/* Logging */
+
+typedef enum {
+    LOG_LEVEL_FATAL = 0,                /*< Errors the server cannot continue after */
+    LOG_LEVEL_LOG,                      /*< Errors and notable events */
+    LOG_LEVEL_DEBUG,                    /*< Details of every request */
+    LOG_LEVEL_ACCESS,                   /*< Access log lines (not a verbosity) */
+    LOG_LEVEL_TRACE,                    /*< Trace events (not a verbosity) */
+} LogLevel;
+
+extern LogLevel LogVerbosity;           /**< Most verbose level of messages recorded */
+extern char  *AccessLogPath;            /**< Path to access log (NULL = disabled) */
+extern bool   AccessLogCombined;        /**< Whether access log is in Combined (not Common) Log Format */
+
+void        log_record(LogLevel level, const char *file, int line, const char *format, ...)
+                       __attribute__((format(printf, 4, 5)));
+
+/* Logging Macros (messages above LogVerbosity cost one comparison) */
+
+#define log_at(L, M, ...) \
+    do { if ((L) <= LogVerbosity) log_record((L), __FILE__, __LINE__, M, ##__VA_ARGS__); } while (0)
 
 #ifdef NDEBUG
 #define debug(M, ...)
 #else
-#define debug(M, ...)   fprintf(stderr, "[%5d] DEBUG %10s:%-4d " M "\n", getpid(), __FILE__, __LINE__, ##__VA_ARGS__)
+#define debug(M, ...)   log_at(LOG_LEVEL_DEBUG, M, ##__VA_ARGS__)
 #endif
 
-#define fatal(M, ...)   fprintf(stderr, "[%5d] FATAL %10s:%-4d " M "\n", getpid(), __FILE__, __LINE__, ##__VA_ARGS__); exit(EXIT_FAILURE)
-#define log(M, ...)     fprintf(stderr, "[%5d] LOG   %10s:%-4d " M "\n", getpid(), __FILE__, __LINE__, ##__VA_ARGS__)
+#define fatal(M, ...)   do { log_at(LOG_LEVEL_FATAL, M, ##__VA_ARGS__); exit(EXIT_FAILURE); } while (0)
+#define log(M, ...)     log_at(LOG_LEVEL_LOG, M, ##__VA_ARGS__)
 
-/* HTTP Request */
+/* File Cache */
+
+typedef struct file_entry FileEntry;
+struct file_entry {
+    char       *path;                   /*< Resolved path of file */
+    uint32_t    hash;                   /*< Hash of path */
+    bool        exists;                 /*< Whether path exists (false for negative entries) */
+    int         fd;                     /*< Shared read-only descriptor of regular file (-1 otherwise) */
+    mode_t      mode;                   /*< File type and permissions */
+    bool        executable;             /*< Whether file is executable (CGI) */
+    off_t       size;                   /*< Size of file */
+    struct timespec mtime;              /*< Last modification time of file */
+    char        etag[64];               /*< Strong entity tag (from inode, size, and mtime) */
+    char        modified[32];           /*< Last modification time as HTTP date */
+    const char *mimetype;               /*< Mime-type of regular file */
+    time_t      expires;                /*< Time at which entry is revalidated */
+    size_t      references;             /*< Number of holders (cache and requests) */
+    FileEntry  *next;                   /*< Next entry in hash bucket */
+    FileEntry  *newer;                  /*< Next more recently used entry */
+    FileEntry  *older;                  /*< Next less recently used entry */
+};
+
+void        filecache_init(void);
+FileEntry * filecache_lookup(const char *path);
+void        filecache_release(FileEntry *entry);
+
+/* Response Cache */
+
+typedef struct cached_response CachedResponse;
+struct cached_response {
+    char           *path;               /*< Resolved path of file */
+    uint32_t        hash;               /*< Hash of path */
+    off_t           size;               /*< Size of file body */
+    struct timespec mtime;              /*< Modification time of file when cached */
+    char           *data;               /*< Pre-serialized headers followed by body */
+    size_t          header_length;      /*< Length of headers in data */
+    bool            protected;          /*< Whether response is in protected segment */
+    size_t          references;         /*< Number of holders (cache and requests) */
+    CachedResponse *next;               /*< Next response in hash bucket */
+    CachedResponse *newer;              /*< Next more recently used response in segment */
+    CachedResponse *older;              /*< Next less recently used response in segment */
+};
+
+CachedResponse *respcache_lookup(const FileEntry *file);
+CachedResponse *respcache_insert(const FileEntry *file, const char *headers, size_t length);
+void        respcache_release(CachedResponse *response);
+void        respcache_stats(size_t *hits, size_t *misses, size_t *bytes);
+
+/* Content Encoding */
+
+typedef enum {
+    ENCODING_IDENTITY = 0,              /*< No encoding */
+    ENCODING_GZIP     = 1 << 0,         /*< gzip (compressed on the fly or precompressed .gz) */
+    ENCODING_BROTLI   = 1 << 1,         /*< br (precompressed .br only) */
+} Encoding;
 
-typedef struct header Header;
-struct header {
-    char    *name;                      /*< Name of header entry */
-    char    *data;                      /*< Data of header entry */
-    Header  *next;                      /*< Next header entry */
+typedef struct compressed_response CompressedResponse;
+struct compressed_response {
+    char               *path;           /*< Resolved path of file */
+    uint32_t            hash;           /*< Hash of path */
+    Encoding            encoding;       /*< Encoding of data */
+    off_t               size;           /*< Size of file when compressed */
+    struct timespec     mtime;          /*< Modification time of file when compressed */
+    char               *data;           /*< Compressed body */
+    size_t              length;         /*< Length of compressed body */
+    size_t              references;     /*< Number of holders (cache and requests) */
+    CompressedResponse *next;           /*< Next response in hash bucket */
+    CompressedResponse *newer;          /*< Next more recently used response */
+    CompressedResponse *older;          /*< Next less recently used response */
 };
 
+unsigned    encoding_accepted(const char *value);
+bool        encoding_compressible(const char *mimetype);
+const char *encoding_name(Encoding encoding);
+char *      gzip_compress(const char *data, size_t length, size_t *compressed);
+CompressedResponse *compcache_lookup(const FileEntry *file, Encoding encoding);
+void        compcache_release(CompressedResponse *response);
+
+/* Directory Listing Cache */
+
+typedef struct dir_listing DirListing;
+struct dir_listing {
+    char       *uri;                    /*< Request URI of directory (links are relative to it) */
+    uint32_t    hash;                   /*< Hash of URI */
+    char        validator[64];          /*< Entity tag of directory when listed */
+    uint64_t    checksum;               /*< Hash of rendered listing (FNV-1a) */
+    char       *body;                   /*< Rendered HTML listing */
+    size_t      length;                 /*< Length of rendered listing */
+    char       *gzip;                   /*< Gzipped listing (NULL if unavailable) */
+    size_t      gzip_length;            /*< Length of gzipped listing */
+    size_t      references;             /*< Number of holders (cache and requests) */
+    DirListing *next;                   /*< Next listing in hash bucket */
+    DirListing *newer;                  /*< Next more recently used listing */
+    DirListing *older;                  /*< Next less recently used listing */
+};
+
+DirListing *dircache_lookup(const FileEntry *directory, const char *uri);
+void        dircache_release(DirListing *listing);
+
+/* HTTP Request */
+
+#define REQUEST_MAX_HEADERS 64
+
+/* Known HTTP Headers (interned with a perfect hash generated by src/genheaders.c) */
+
+#define HTTP_HEADERS(X) \
+    X(ACCEPT,               "Accept")               \
+    X(ACCEPT_ENCODING,      "Accept-Encoding")      \
+    X(ACCEPT_LANGUAGE,      "Accept-Language")      \
+    X(AUTHORIZATION,        "Authorization")        \
+    X(CACHE_CONTROL,        "Cache-Control")        \
+    X(CONNECTION,           "Connection")           \
+    X(CONTENT_LENGTH,       "Content-Length")       \
+    X(CONTENT_TYPE,         "Content-Type")         \
+    X(COOKIE,               "Cookie")               \
+    X(EXPECT,               "Expect")               \
+    X(HOST,                 "Host")                 \
+    X(IF_MATCH,             "If-Match")             \
+    X(IF_MODIFIED_SINCE,    "If-Modified-Since")    \
+    X(IF_NONE_MATCH,        "If-None-Match")        \
+    X(IF_RANGE,             "If-Range")             \
+    X(IF_UNMODIFIED_SINCE,  "If-Unmodified-Since")  \
+    X(ORIGIN,               "Origin")               \
+    X(RANGE,                "Range")                \
+    X(REFERER,              "Referer")              \
+    X(TE,                   "TE")                   \
+    X(TRANSFER_ENCODING,    "Transfer-Encoding")    \
+    X(UPGRADE,              "Upgrade")              \
+    X(USER_AGENT,           "User-Agent")
+
+typedef enum {
+#define HEADER_ENUM(name, string) HEADER_##name,
+    HTTP_HEADERS(HEADER_ENUM)
+#undef HEADER_ENUM
+    HEADER_COUNT,
+    HEADER_UNKNOWN = HEADER_COUNT,
+} HeaderName;
+
+#define HEADER_HASH_BITS            6
+#define header_hash_step(hash, c)   ((((hash) ^ ((unsigned char)(c) | 0x20)) * 16777619u) & 0xffffffffu)
+#define header_hash_slot(hash)      ((hash) >> (32 - HEADER_HASH_BITS))
+
+typedef struct {
+    uint16_t name;                      /*< Offset of header name in request buffer */
+    uint16_t name_length;               /*< Length of header name */
+    uint16_t value;                     /*< Offset of header value in request buffer */
+    uint16_t value_length;              /*< Length of header value */
+} Header;
+
+typedef enum {
+    REQUEST_LINE = 0,                   /* Waiting for request line */
+    REQUEST_HEADERS,                    /* Waiting for end of header block */
+    REQUEST_COMPLETE,                   /* Header block parsed */
+    REQUEST_MALFORMED,                  /* Header block invalid or too large */
+} RequestState;
+
 typedef struct {
     int     fd;                         /*< Client socket file descripter */
     FILE    *stream;                    /*< Client socket file stream */
-    char    *method;                    /*< HTTP method */
-    char    *uri;                       /*< HTTP uniform resource identifier */
+    char    *method;                    /*< HTTP method (in buffer) */
+    char    *uri;                       /*< HTTP uniform resource identifier (in buffer) */
     char    *path;                      /*< Real path corrsponding to URI and RootPath */
-    char    *query;                     /*< HTTP query string */
+    char    *query;                     /*< HTTP query string (in buffer) */
+    FileEntry *file;                    /*< Cached metadata of path */
+
+    struct sockaddr_storage address;    /*< Raw address of client */
+    socklen_t address_length;           /*< Length of address (0 if not looked up, -1 if unknown) */
+    char     host[NI_MAXHOST];          /*< Numeric host of client (formatted on demand) */
+    char     port[NI_MAXSERV];          /*< Numeric port of client (formatted on demand) */
+
+    Header   known[HEADER_COUNT];       /*< Known header slices of buffer (by HeaderName) */
+    Header   unknown[REQUEST_MAX_HEADERS]; /*< Other header slices of buffer */
+    size_t   nunknown;                  /*< Number of other headers */
+    size_t   nheaders;                  /*< Number of headers (known and other) */
 
-    char     host[NI_MAXHOST];          /*< Host name of client */
-    char     port[NI_MAXSERV];          /*< Port number of client */
+    char     buffer[BUFSIZ];            /*< Raw bytes received from client */
+    size_t   length;                    /*< Number of bytes in buffer */
+    size_t   offset;                    /*< Start of next unparsed line in buffer */
+    size_t   scanned;                   /*< Bytes after offset already searched for end of line */
+    RequestState state;                 /*< State of request parser */
 
-    Header  *headers;                   /*< List of name, data Header pairs */
+    uint64_t accepted;                  /*< Trace clock when accepted (0 unless tracing) */
+    off_t    content_length;            /*< Length of response body (counted as it is streamed) */
+    bool     defer_body;                /*< Leave file body for server loop to send */
+    bool     deferred;                  /*< Handler left for a helper thread (see resume_request) */
+    struct timespec started;            /*< When handling of request began */
+    int      body_fd;                   /*< File body left to send (-1 if none) */
+    off_t    body_offset;               /*< Offset of next body byte to send */
+    off_t    body_length;               /*< Offset just past last body byte to send */
+
+    bool     http11;                    /*< Whether client speaks HTTP/1.1 */
+    bool     keep_alive;                /*< Whether connection persists after response */
+    size_t   requests;                  /*< Number of requests parsed on connection */
 } Request;
 
 Request *   accept_request(int sfd);
+size_t      accept_requests(int sfd, Request **requests, size_t max, int flags);
+Request *   create_request(int fd);
+const char *request_host(Request *request);
+const char *request_port(Request *request);
+bool        request_headers_complete(Request *request);
+const char *request_header(const Request *request, HeaderName name);
+HeaderName  header_lookup(const char *name, size_t length);
 void	    free_request(Request *request);
+void        reset_request(Request *request);
+bool        wait_request(Request *request, int timeout);
 int	    parse_request(Request *request);
 
+/* HTTP Response (status line and headers assembled in place) */
+
+#define RESPONSE_HEADER_SIZE    (16 << 10)
+
+typedef struct {
+    char    data[RESPONSE_HEADER_SIZE]; /*< Status line and header lines */
+    size_t  length;                     /*< Length of data */
+} Response;
+
+void        response_status(Response *response, const char *status);
+void        response_header(Response *response, const char *name, const char *value);
+void        response_length(Response *response, off_t length);
+void        response_lines(Response *response, const char *lines);
+void        response_finish(Response *response, bool keep_alive);
+bool        response_send(Request *request, const Response *response, const void *body, size_t length);
+
+/* Script Worker Pool */
+
+typedef struct script_worker ScriptWorker;
+struct script_worker {
+    struct script_pool *pool;           /*< Pool of script */
+    pid_t       pid;                    /*< Process id of worker (0 if slot is empty) */
+    int         fd;                     /*< Unix socket connected to worker */
+    size_t      requests;               /*< Number of requests served */
+    bool        busy;                   /*< Whether worker is serving a request */
+};
+
+bool        scriptpool_handles(const char *path);
+ScriptWorker *scriptpool_acquire(const char *path);
+void        scriptpool_release(ScriptWorker *worker, bool reusable);
+ssize_t     scriptpool_request(ScriptWorker *worker, char **envp, int timeout);
+
 /* HTTP Request Handlers */
 
 typedef enum {
     HTTP_STATUS_OK = 0,			/* 200 OK */
+    HTTP_STATUS_PARTIAL_CONTENT,	/* 206 Partial Content */
+    HTTP_STATUS_NOT_MODIFIED,		/* 304 Not Modified */
     HTTP_STATUS_BAD_REQUEST,		/* 400 Bad Request */
     HTTP_STATUS_NOT_FOUND,		/* 404 Not Found */
+    HTTP_STATUS_RANGE_NOT_SATISFIABLE,	/* 416 Range Not Satisfiable */
     HTTP_STATUS_INTERNAL_SERVER_ERROR,	/* 500 Internal Server Error */
+    HTTP_STATUS_SERVICE_UNAVAILABLE,	/* 503 Service Unavailable */
+    HTTP_STATUS_GATEWAY_TIMEOUT,	/* 504 Gateway Timeout */
+    HTTP_STATUS_COUNT,
 } Status;
 
+typedef enum {
+    HANDLER_BROWSE = 0,                 /* Directory listing */
+    HANDLER_FILE,                       /* Regular file */
+    HANDLER_CGI,                        /* CGI script (spawned or persistent worker) */
+    HANDLER_ERROR,                      /* Error page */
+    HANDLER_STATUS,                     /* Metrics endpoint */
+    HANDLER_COUNT,
+} Handler;
+
 Status      handle_request(Request *request);
+Status      resume_request(Request *request);
+size_t      handle_connection(Request *request);
+
+/* Helper Threads (blocking handlers of server loops) */
+
+int         offload_init(void);
+bool        offload_request(Request *request, void *context);
+void *      offload_finished(void);
+
+/* Metrics */
+
+void        metrics_init(void);
+void        metrics_connection(int delta);
+void        metrics_request(Status status, Handler handler, off_t sent, const struct timespec *start);
+void        metrics_cgi(const struct timespec *start);
+char *      metrics_render(bool json, size_t *length);
+
+/* Tracing (phases of sampled requests, compiled out with -DNTRACE) */
+
+typedef enum {
+    TRACE_REQUEST = 0,                  /* Whole request */
+    TRACE_QUEUE,                        /* Connection accepted until first request begins */
+    TRACE_PARSE,                        /* Reading and parsing request */
+    TRACE_PATH,                         /* Resolving request path */
+    TRACE_LOOKUP,                       /* Looking up (or loading) file metadata */
+    TRACE_MIMETYPE,                     /* Determining mimetype */
+    TRACE_HANDLER,                      /* Running handler */
+    TRACE_PEER,                         /* Formatting client address */
+    TRACE_SEND,                         /* Sending response */
+    TRACE_LOG,                          /* Recording access log line and metrics */
+    TRACE_PHASES,
+} TracePhase;
+
+extern char  *TracePath;                /**< Path to trace file (NULL = disabled) */
+extern size_t TraceSampleRate;          /**< Trace one in this many requests per thread (0 = disabled) */
+extern __thread bool TraceActive;       /**< Whether current request of thread is traced */
+
+void        trace_init(void);
+uint64_t    trace_clock(void);
+void        trace_begin(Request *request);
+void        trace_span(TracePhase phase, uint64_t start);
+void        trace_finish(Request *request, Status status);
+
+#ifdef NTRACE
+#define trace_start()       0
+#define trace_end(P, T)     ((void)(T))
+#else
+#define trace_start()       (TraceActive ? trace_clock() : 0)
+#define trace_end(P, T)     do { if (TraceActive) trace_span((P), (T)); } while (0)
+#endif
+
+/* Access Log and Flushing */
+
+bool        log_open(LogLevel level, const char *path);
+void        log_access(Request *request, Status status);
+void        log_flush(void);
+uint64_t    log_dropped(void);
 
 /* HTTP Server */
 
 int         single_server(int sfd);
 int         forking_server(int sfd);
+int         event_server(int sfd);
+int         prefork_server(int sfd);
+int         threaded_server(int sfd);
+int         uring_server(int sfd);
+
+/* Mime-Types */
+
+bool        mimetypes_load(const char *path);
+const char *mimetypes_lookup(const char *extension);
+bool        mimetypes_refresh(void);
+void        mimetypes_stale(int signum);
+
+/* Scanning */
+
+char *      scan_delimiters(const char *start, const char *end, const char *set);
 
 /* Socket */
 
 int	    socket_listen(const char *port);
+int	    socket_cork(int fd, bool on);
+ssize_t     socket_sendfile(int sfd, int fd, off_t *offset, size_t count);
+int         socket_writev(int fd, struct iovec *iov, int iovcnt);
 
 /* Utilities */
 
 #define chomp(s)    (s)[strlen(s) - 1] = '\0'
 #define streq(a, b) (strcmp((a), (b)) == 0)
 
-char *	    determine_mimetype(const char *path);
+const char *determine_mimetype(const char *path);
 char *	    determine_request_path(const char *uri);
+int         open_request_path(const char *path, int flags);
+size_t      format_http_date(time_t time, char *buffer, size_t size);
+time_t      parse_http_date(const char *date);
 const char *http_status_string(Status status);
+int         set_nonblocking(int fd);
 char *	    skip_nonwhitespace(char *s);
 char *	    skip_whitespace(char *s);
 
@@ -0,0 +1,1178 @@
+/* bench.c: HTTP Load Generator */
+
+#include "server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <strings.h>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Constants */
+
+#define BENCH_MAX_DEPTH         64      /* Outstanding requests per connection */
+#define BENCH_MAX_TARGETS       1024    /* Paths in request mix */
+#define BENCH_HEADER_SIZE       8192    /* Largest response header block */
+#define BENCH_READ_SIZE         (64 << 10)
+#define BENCH_MAX_EVENTS        256
+#define BENCH_CHECK_INTERVAL    100000000ull /* Nanoseconds between timeout checks */
+#define BENCH_SUB_BITS          5       /* 32 linear sub-buckets per power of two */
+#define BENCH_BUCKETS           ((64 - BENCH_SUB_BITS + 1) << BENCH_SUB_BITS)
+
+/* Latency Histogram (log-linear, as HdrHistogram, in nanoseconds) */
+
+typedef struct {
+    uint64_t    buckets[BENCH_BUCKETS];
+    uint64_t    count;                  /*< Number of recorded values */
+    uint64_t    max;                    /*< Largest recorded value */
+} Histogram;
+
+/* Errors */
+
+typedef enum {
+    ERROR_CONNECT = 0,                  /* Connection failed */
+    ERROR_READ,                         /* Connection reset or closed mid-response, or malformed response */
+    ERROR_WRITE,                        /* Request could not be written */
+    ERROR_TIMEOUT,                      /* No response within Timeout */
+    ERROR_COUNT,
+} Error;
+
+static const char *ErrorNames[] = {"connect", "read", "write", "timeout"};
+
+/* Request Target (one per path in request mix) */
+
+typedef struct {
+    char       *request;                /*< Rendered request */
+    size_t      length;                 /*< Length of request */
+    uint64_t    weight;                 /*< Cumulative weight through this target */
+} Target;
+
+/* Response Parser States */
+
+typedef enum {
+    PARSE_HEADERS = 0,                  /* Reading header block */
+    PARSE_BODY,                         /* Reading remaining body bytes */
+    PARSE_UNTIL_CLOSE,                  /* Reading body until connection closes */
+    PARSE_CHUNK_SIZE,                   /* Reading chunk size line */
+    PARSE_CHUNK_DATA,                   /* Reading chunk data and its CRLF */
+    PARSE_TRAILERS,                     /* Reading trailer lines after last chunk */
+} ParseState;
+
+/* Connection */
+
+typedef struct {
+    int         fd;                     /*< Socket (-1 if closed) */
+    bool        connected;              /*< Whether connect completed */
+    uint64_t    generation;             /*< Number of times connection was opened */
+
+    size_t      head;                   /*< Index of oldest outstanding request */
+    size_t      count;                  /*< Number of outstanding requests */
+    size_t      target[BENCH_MAX_DEPTH];    /*< Target of each outstanding request */
+    uint64_t    intended[BENCH_MAX_DEPTH];  /*< When each request was due (latency starts here) */
+    uint64_t    sent[BENCH_MAX_DEPTH];      /*< When each request was queued (timeouts start here) */
+
+    char       *output;                 /*< Requests not yet written */
+    size_t      output_length;          /*< Length of output */
+    size_t      output_offset;          /*< Bytes of output already written */
+
+    ParseState  state;                  /*< State of response parser */
+    char        line[BENCH_HEADER_SIZE];/*< Header block or chunk line being read */
+    size_t      line_length;            /*< Length of line */
+    uint64_t    remaining;              /*< Body or chunk bytes left to read */
+    int         status;                 /*< Status code of response */
+    bool        close;                  /*< Whether server closes after response */
+} Connection;
+
+/* Worker (one thread with its own epoll loop and connections) */
+
+typedef struct {
+    pthread_t   thread;
+    int         epfd;                   /*< Epoll instance */
+    Connection *connections;
+    size_t      nconnections;
+    size_t      next;                   /*< Next connection to try (rate-limited mode) */
+    uint64_t    quota;                  /*< Requests to issue (0 = until Deadline) */
+    uint64_t    issued;                 /*< Requests issued */
+    uint64_t    finished;               /*< Requests answered or failed */
+    uint64_t    interval;               /*< Nanoseconds between requests (0 = unlimited) */
+    uint64_t    due;                    /*< When next request is due (rate-limited mode) */
+    uint64_t    random;                 /*< State of xorshift generator */
+
+    Histogram   latency;                /*< Time from due to complete response */
+    uint64_t    responses[6];           /*< Responses by status class (0 = unknown) */
+    uint64_t    errors[ERROR_COUNT];
+    uint64_t    bytes;                  /*< Bytes read */
+} Worker;
+
+/* Global Variables */
+
+char       *Host        = "localhost";
+char       *Port        = "80";
+size_t      Connections = 16;
+size_t      Threads     = 2;
+double      Duration    = 10;
+uint64_t    Requests    = 0;
+size_t      Depth       = 1;
+bool        KeepAlive   = true;
+double      Rate        = 0;
+char       *MixPath     = NULL;
+int         Timeout     = 10;
+bool        Quiet       = false;
+
+struct addrinfo *Address = NULL;
+Target      Targets[BENCH_MAX_TARGETS];
+size_t      NTargets    = 0;
+uint64_t    Start       = 0;
+uint64_t    Deadline    = UINT64_MAX;
+
+/* Internal Declarations */
+void        usage(const char *progname, int status);
+bool        parse_options(int argc, char *argv[], char **path);
+bool        parse_url(char *url, char **path);
+bool        add_target(const char *path, uint64_t weight);
+bool        load_mix(const char *path);
+void *      worker_run(void *arg);
+void        worker_issue(Worker *w, uint64_t now);
+bool        worker_done(const Worker *w, uint64_t now);
+void        worker_check(Worker *w, uint64_t now);
+void        connection_open(Worker *w, Connection *c);
+void        connection_reset(Worker *w, Connection *c, Error error);
+void        connection_queue(Worker *w, Connection *c, uint64_t intended, uint64_t now);
+void        connection_fill(Worker *w, Connection *c, uint64_t now);
+void        connection_write(Worker *w, Connection *c);
+void        connection_read(Worker *w, Connection *c);
+size_t      connection_parse(Worker *w, Connection *c, const char *data, size_t length);
+int         connection_line(Connection *c, const char *data, size_t length, size_t *consumed, const char *end);
+bool        connection_headers(Connection *c);
+void        connection_complete(Worker *w, Connection *c);
+uint64_t    now_ns(void);
+size_t      histogram_bucket(uint64_t value);
+uint64_t    histogram_upper(size_t bucket);
+void        histogram_merge(Histogram *total, const Histogram *h);
+uint64_t    histogram_quantile(const Histogram *h, double q);
+
+/**
+ * Display usage message and exit with specified status code.
+ *
+ * @param   progname    Program Name
+ * @param   status      Exit status.
+ **/
+void usage(const char *progname, int status) {
+    fprintf(stderr, "Usage: %s [hcdCmnPqRTt] URL\n", progname);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "    -h            Display help message\n");
+    fprintf(stderr, "    -c conns      Number of connections (16)\n");
+    fprintf(stderr, "    -d seconds    Duration of run (10, or until -n requests are answered)\n");
+    fprintf(stderr, "    -C            Close connection after each response (no keep-alive)\n");
+    fprintf(stderr, "    -m path       Request mix file (lines of [weight] path)\n");
+    fprintf(stderr, "    -n requests   Number of requests to issue\n");
+    fprintf(stderr, "    -P depth      Requests pipelined per connection (1)\n");
+    fprintf(stderr, "    -q            Print one summary line\n");
+    fprintf(stderr, "    -R rate       Requests per second, timed from when each was due (0 is unlimited)\n");
+    fprintf(stderr, "    -T seconds    Response timeout (10)\n");
+    fprintf(stderr, "    -t threads    Number of threads (2)\n");
+    exit(status);
+}
+
+/**
+ * Parse command-line options.
+ *
+ * @param   argc        Number of arguments.
+ * @param   argv        Array of argument strings.
+ * @param   path        Pointer to store path of URL in.
+ * @return  true if parsing was successful, false if there was an error.
+ **/
+bool parse_options(int argc, char *argv[], char **path) {
+    bool timed  = false;
+    int  argind = 1;
+
+    while (argind < argc && strlen(argv[argind]) > 1 && argv[argind][0] == '-') {
+        char *arg = argv[argind++];
+
+        if (strchr("cdmnPRTt", arg[1]) && argind >= argc) {
+            return false;
+        }
+
+        switch (arg[1]) {
+            case 'h':
+                usage(argv[0], EXIT_SUCCESS);
+                break;
+            case 'c':
+                Connections = strtoul(argv[argind++], NULL, 10);
+                break;
+            case 'd':
+                Duration = strtod(argv[argind++], NULL);
+                timed    = true;
+                break;
+            case 'C':
+                KeepAlive = false;
+                break;
+            case 'm':
+                MixPath = argv[argind++];
+                break;
+            case 'n':
+                Requests = strtoull(argv[argind++], NULL, 10);
+                break;
+            case 'P':
+                Depth = strtoul(argv[argind++], NULL, 10);
+                break;
+            case 'q':
+                Quiet = true;
+                break;
+            case 'R':
+                Rate = strtod(argv[argind++], NULL);
+                break;
+            case 'T':
+                Timeout = atoi(argv[argind++]);
+                break;
+            case 't':
+                Threads = strtoul(argv[argind++], NULL, 10);
+                break;
+            default:
+                return false;
+        }
+    }
+
+    if (argind != argc - 1 || Connections == 0 || Threads == 0 || Depth == 0 || Depth > BENCH_MAX_DEPTH) {
+        return false;
+    }
+
+    /* A request count runs until answered, unless a duration is also given */
+    if (Requests > 0 && !timed) {
+        Duration = 0;
+    }
+
+    /* Each connection carries one request if the server closes it after each */
+    if (!KeepAlive) {
+        Depth = 1;
+    }
+
+    if (Threads > Connections) {
+        Threads = Connections;
+    }
+
+    return parse_url(argv[argind], path);
+}
+
+/**
+ * Split URL into Host, Port, and path.
+ *
+ * @param   url         URL (http://host[:port][/path], scheme optional).
+ * @param   path        Pointer to store path in (borrowed from url, "/" if none).
+ * @return  Whether or not the URL could be parsed.
+ **/
+bool parse_url(char *url, char **path) {
+    char *slash, *colon;
+
+    if (strncmp(url, "http://", 7) == 0) {
+        url += 7;
+    } else if (strstr(url, "://")) {
+        return false;
+    }
+
+    *path = "/";
+    if ((slash = strchr(url, '/'))) {
+        *path = slash;
+        url   = strndup(url, slash - url);
+    }
+
+    if ((colon = strrchr(url, ':'))) {
+        *colon = '\0';
+        Port   = colon + 1;
+    }
+
+    Host = url;
+    return Host && *Host && *Port;
+}
+
+/**
+ * Render request for path and add it to the request mix.
+ *
+ * @param   path        Path of request.
+ * @param   weight      Relative frequency of request.
+ * @return  Whether or not the target was added.
+ **/
+bool add_target(const char *path, uint64_t weight) {
+    Target *t = &Targets[NTargets];
+    int     length;
+
+    if (NTargets >= BENCH_MAX_TARGETS || weight == 0 || path[0] != '/') {
+        return false;
+    }
+
+    length = asprintf(&t->request, "GET %s HTTP/1.1\r\nHost: %s:%s\r\nUser-Agent: bench\r\n%s\r\n",
+                      path, Host, Port, KeepAlive ? "" : "Connection: close\r\n");
+    if (length < 0) {
+        return false;
+    }
+
+    t->length = length;
+    t->weight = weight + (NTargets > 0 ? Targets[NTargets - 1].weight : 0);
+    NTargets++;
+    return true;
+}
+
+/**
+ * Load request mix file.
+ *
+ * @param   path        Path of mix file.
+ * @return  Whether or not every line was loaded.
+ *
+ * Each line is a request path, optionally preceded by its weight (1 if not
+ * given).  Blank lines and lines starting with # are ignored.
+ **/
+bool load_mix(const char *path) {
+    FILE *fs = fopen(path, "r");
+    char  buffer[BUFSIZ];
+    bool  loaded = true;
+
+    if (!fs) {
+        fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    while (loaded && fgets(buffer, sizeof(buffer), fs)) {
+        char    *first  = strtok(buffer, WHITESPACE);
+        char    *second = first ? strtok(NULL, WHITESPACE) : NULL;
+
+        if (!first || first[0] == '#') {
+            continue;
+        }
+
+        if (second) {
+            loaded = add_target(second, strtoull(first, NULL, 10));
+        } else {
+            loaded = add_target(first, 1);
+        }
+
+        if (!loaded) {
+            fprintf(stderr, "Invalid request mix line: %s %s\n", first, second ? second : "");
+        }
+    }
+
+    fclose(fs);
+    return loaded && NTargets > 0;
+}
+
+/**
+ * Run worker loop until its quota is answered or Deadline passes.
+ *
+ * @param   arg         Worker.
+ * @return  NULL.
+ *
+ * Without a rate, every connection keeps Depth requests outstanding, so the
+ * server is always busy.  With a rate, requests fall due at fixed intervals
+ * and go out on whichever connection has room.  Latency is measured from when
+ * each request was due rather than when it was sent, so a stalled server is
+ * charged for the requests that queued up behind the stall (correcting for
+ * coordinated omission).
+ **/
+void * worker_run(void *arg) {
+    Worker            *w      = arg;
+    struct epoll_event events[BENCH_MAX_EVENTS];
+    uint64_t           now    = now_ns();
+    uint64_t           checked = now;
+
+    w->due = now;
+
+    for (size_t i = 0; i < w->nconnections; i++) {
+        connection_open(w, &w->connections[i]);
+        if (w->interval == 0) {
+            connection_fill(w, &w->connections[i], now);
+        }
+    }
+
+    while (!worker_done(w, now)) {
+        uint64_t        wait    = BENCH_CHECK_INTERVAL;
+        struct timespec timeout;
+        int             n;
+
+        /* Wake when the next request is due (to the nanosecond) */
+        if (w->interval > 0) {
+            wait = w->due > now ? w->due - now : 0;
+            wait = wait < BENCH_CHECK_INTERVAL ? wait : BENCH_CHECK_INTERVAL;
+        }
+
+        timeout.tv_sec  = wait / 1000000000ull;
+        timeout.tv_nsec = wait % 1000000000ull;
+
+        n   = epoll_pwait2(w->epfd, events, BENCH_MAX_EVENTS, &timeout, NULL);
+        now = now_ns();
+
+        for (int i = 0; i < n; i++) {
+            Connection *c = events[i].data.ptr;
+
+            if (!c->connected && c->fd >= 0 && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+                int       error  = 0;
+                socklen_t length = sizeof(error);
+
+                getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                if (error) {
+                    connection_reset(w, c, ERROR_CONNECT);
+                    continue;
+                }
+                c->connected = true;
+            }
+
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                connection_read(w, c);
+            }
+
+            if (c->connected && c->output_offset < c->output_length) {
+                connection_write(w, c);
+            }
+        }
+
+        if (w->interval > 0) {
+            worker_issue(w, now);
+        }
+
+        if (now - checked >= BENCH_CHECK_INTERVAL) {
+            worker_check(w, now);
+            checked = now;
+        }
+    }
+
+    for (size_t i = 0; i < w->nconnections; i++) {
+        if (w->connections[i].fd >= 0) {
+            close(w->connections[i].fd);
+        }
+        free(w->connections[i].output);
+    }
+
+    return NULL;
+}
+
+/**
+ * Issue requests that have fallen due (rate-limited mode).
+ *
+ * @param   w           Worker.
+ * @param   now         Current time.
+ *
+ * Requests that are due while every connection is full stay due, and go out
+ * (still timed from when they were due) as soon as a connection has room.
+ **/
+void worker_issue(Worker *w, uint64_t now) {
+    while (w->due <= now && now < Deadline && (w->quota == 0 || w->issued < w->quota)) {
+        Connection *c = NULL;
+
+        for (size_t i = 0; i < w->nconnections && !c; i++) {
+            Connection *candidate = &w->connections[(w->next + i) % w->nconnections];
+
+            if (candidate->fd >= 0 && candidate->count < Depth) {
+                c       = candidate;
+                w->next = (w->next + i + 1) % w->nconnections;
+            }
+        }
+
+        if (!c) {
+            return;
+        }
+
+        connection_queue(w, c, w->due, now);
+        w->due += w->interval;
+
+        if (c->connected) {
+            connection_write(w, c);
+        }
+    }
+}
+
+/**
+ * Determine whether worker is done.
+ *
+ * @param   w           Worker.
+ * @param   now         Current time.
+ * @return  Whether Deadline passed or every request of the quota is finished.
+ **/
+bool worker_done(const Worker *w, uint64_t now) {
+    return now >= Deadline || (w->quota > 0 && w->finished >= w->quota);
+}
+
+/**
+ * Fail connections whose oldest outstanding request timed out, and retry
+ * connections that could not connect.
+ *
+ * @param   w           Worker.
+ * @param   now         Current time.
+ **/
+void worker_check(Worker *w, uint64_t now) {
+    for (size_t i = 0; i < w->nconnections; i++) {
+        Connection *c = &w->connections[i];
+
+        if (c->count > 0 && c->sent[c->head] + (uint64_t)Timeout * 1000000000ull <= now) {
+            connection_reset(w, c, ERROR_TIMEOUT);
+        } else if (c->fd < 0) {
+            connection_reset(w, c, ERROR_COUNT);
+        }
+    }
+}
+
+/**
+ * Open connection to server (nonblocking).
+ *
+ * @param   w           Worker.
+ * @param   c           Connection.
+ *
+ * Outstanding requests left in the output are sent once the connection
+ * completes.
+ **/
+void connection_open(Worker *w, Connection *c) {
+    struct epoll_event event = { .events = EPOLLIN | EPOLLOUT | EPOLLET, .data.ptr = c };
+    int                on    = 1;
+
+    c->connected   = false;
+    c->state       = PARSE_HEADERS;
+    c->line_length = 0;
+    c->fd          = socket(Address->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (c->fd < 0) {
+        w->errors[ERROR_CONNECT]++;
+        return;
+    }
+
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    if ((connect(c->fd, Address->ai_addr, Address->ai_addrlen) < 0 && errno != EINPROGRESS) ||
+        epoll_ctl(w->epfd, EPOLL_CTL_ADD, c->fd, &event) < 0) {
+        w->errors[ERROR_CONNECT]++;
+        close(c->fd);
+        c->fd = -1;
+    }
+}
+
+/**
+ * Close connection and open it again.
+ *
+ * @param   w           Worker.
+ * @param   c           Connection.
+ * @param   error       Error that closed connection (ERROR_COUNT if the server
+ * closed it as announced).
+ *
+ * After an announced close, outstanding requests are sent again on the new
+ * connection (keeping when they were due).  After an error, they fail.  A
+ * connection that could not connect is only retried by worker_check, so a
+ * server that refuses connections is not hammered with connects.
+ **/
+void connection_reset(Worker *w, Connection *c, Error error) {
+    uint64_t now = now_ns();
+
+    if (c->fd >= 0) {
+        close(c->fd);
+        c->fd = -1;
+    }
+
+    if (error < ERROR_COUNT) {
+        w->errors[error] += c->count ? c->count : 1;
+        w->finished      += c->count;
+        c->count          = 0;
+    }
+
+    /* Queue outstanding requests again */
+    c->output_length = c->output_offset = 0;
+    for (size_t i = 0; i < c->count; i++) {
+        const Target *t = &Targets[c->target[(c->head + i) % BENCH_MAX_DEPTH]];
+
+        memcpy(c->output + c->output_length, t->request, t->length);
+        c->output_length += t->length;
+    }
+
+    c->generation++;
+    if (error == ERROR_CONNECT || worker_done(w, now)) {
+        return;
+    }
+
+    connection_open(w, c);
+    if (c->fd >= 0 && w->interval == 0) {
+        connection_fill(w, c, now);
+    }
+}
+
+/**
+ * Queue request on connection.
+ *
+ * @param   w           Worker.
+ * @param   c           Connection (with fewer than Depth outstanding requests).
+ * @param   intended    When request was due.
+ * @param   now         Current time.
+ **/
+void connection_queue(Worker *w, Connection *c, uint64_t intended, uint64_t now) {
+    size_t        slot   = (c->head + c->count) % BENCH_MAX_DEPTH;
+    size_t        index  = 0;
+    const Target *t;
+
+    /* Pick target by weight */
+    if (NTargets > 1) {
+        size_t   low = 0, high = NTargets - 1;
+        uint64_t pick;
+
+        w->random ^= w->random << 13;
+        w->random ^= w->random >> 7;
+        w->random ^= w->random << 17;
+        pick = w->random % Targets[NTargets - 1].weight;
+
+        while (low < high) {
+            size_t middle = (low + high) / 2;
+
+            if (Targets[middle].weight > pick) {
+                high = middle;
+            } else {
+                low = middle + 1;
+            }
+        }
+        index = low;
+    }
+
+    t = &Targets[index];
+
+    /* Drop written output, then append request */
+    if (c->output_offset > 0) {
+        memmove(c->output, c->output + c->output_offset, c->output_length - c->output_offset);
+        c->output_length -= c->output_offset;
+        c->output_offset  = 0;
+    }
+
+    memcpy(c->output + c->output_length, t->request, t->length);
+    c->output_length += t->length;
+
+    c->target[slot]   = index;
+    c->intended[slot] = intended;
+    c->sent[slot]     = now;
+    c->count++;
+    w->issued++;
+}
+
+/**
+ * Queue requests until connection has Depth outstanding (unlimited mode).
+ *
+ * @param   w           Worker.
+ * @param   c           Connection.
+ * @param   now         Current time.
+ **/
+void connection_fill(Worker *w, Connection *c, uint64_t now) {
+    while (c->count < Depth && now < Deadline && (w->quota == 0 || w->issued < w->quota)) {
+        connection_queue(w, c, now, now);
+    }
+
+    if (c->connected) {
+        connection_write(w, c);
+    }
+}
+
+/**
+ * Write queued requests until done or the socket is full.
+ *
+ * @param   w           Worker.
+ * @param   c           Connection.
+ **/
+void connection_write(Worker *w, Connection *c) {
+    while (c->output_offset < c->output_length) {
+        ssize_t nwritten = send(c->fd, c->output + c->output_offset, c->output_length - c->output_offset, MSG_NOSIGNAL);
+
+        if (nwritten < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (nwritten < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+
+        if (nwritten < 0) {
+            uint64_t generation = c->generation;
+
+            /* Responses already received may announce the close that failed the write */
+            connection_read(w, c);
+            if (c->generation == generation) {
+                connection_reset(w, c, ERROR_WRITE);
+            }
+            return;
+        }
+
+        c->output_offset += nwritten;
+    }
+}
+
+/**
+ * Read and parse responses until the socket is empty.
+ *
+ * @param   w           Worker.
+ * @param   c           Connection.
+ *
+ * The connection is opened again once the server closes it.  Closing between
+ * responses is not an error (the server may close idle connections).  Bytes
+ * read after a response that closed the connection are dropped.
+ **/
+void connection_read(Worker *w, Connection *c) {
+    char     buffer[BENCH_READ_SIZE];
+    uint64_t generation = c->generation;
+    ssize_t  nread;
+
+    while (c->fd >= 0 && c->generation == generation) {
+        size_t offset = 0;
+
+        nread = recv(c->fd, buffer, sizeof(buffer), 0);
+
+        if (nread < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (nread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+
+        if (nread < 0) {
+            connection_reset(w, c, ERROR_READ);
+            return;
+        }
+
+        if (nread == 0) {
+            if (c->state == PARSE_UNTIL_CLOSE) {
+                connection_complete(w, c);
+                connection_reset(w, c, ERROR_COUNT);
+            } else if (c->state != PARSE_HEADERS || c->line_length > 0) {
+                connection_reset(w, c, ERROR_READ);
+            } else {
+                connection_reset(w, c, ERROR_COUNT);
+            }
+            return;
+        }
+
+        w->bytes += nread;
+
+        while (offset < (size_t)nread && c->generation == generation) {
+            offset += connection_parse(w, c, buffer + offset, nread - offset);
+        }
+    }
+}
+
+/**
+ * Parse response bytes.
+ *
+ * @param   w           Worker.
+ * @param   c           Connection.
+ * @param   data        Bytes read.
+ * @param   length      Number of bytes.
+ * @return  Number of bytes consumed.
+ *
+ * Bodies are skipped without being copied.  Only the header block and chunk
+ * size lines are buffered.
+ **/
+size_t connection_parse(Worker *w, Connection *c, const char *data, size_t length) {
+    size_t consumed = length;
+    int    line     = 0;
+
+    switch (c->state) {
+        case PARSE_HEADERS:
+            if ((line = connection_line(c, data, length, &consumed, "\r\n\r\n")) <= 0) {
+                break;
+            }
+
+            if (!connection_headers(c)) {
+                line = -1;
+            } else if (c->state == PARSE_HEADERS) {
+                connection_complete(w, c);
+            }
+            break;
+        case PARSE_BODY:
+        case PARSE_CHUNK_DATA:
+            consumed      = length < c->remaining ? length : c->remaining;
+            c->remaining -= consumed;
+
+            if (c->remaining == 0 && c->state == PARSE_CHUNK_DATA) {
+                c->state = PARSE_CHUNK_SIZE;
+            } else if (c->remaining == 0) {
+                connection_complete(w, c);
+            }
+            break;
+        case PARSE_UNTIL_CLOSE:
+            break;
+        case PARSE_CHUNK_SIZE:
+            if ((line = connection_line(c, data, length, &consumed, "\r\n")) <= 0) {
+                break;
+            }
+
+            c->remaining   = strtoull(c->line, NULL, 16);
+            c->line_length = 0;
+            if (c->remaining == 0) {
+                c->state = PARSE_TRAILERS;
+            } else {
+                c->remaining += 2;
+                c->state      = PARSE_CHUNK_DATA;
+            }
+            break;
+        case PARSE_TRAILERS:
+            if ((line = connection_line(c, data, length, &consumed, "\r\n")) <= 0) {
+                break;
+            }
+
+            if (c->line_length == 2) {
+                connection_complete(w, c);
+            }
+            c->line_length = 0;
+            break;
+    }
+
+    if (line < 0) {
+        connection_reset(w, c, ERROR_READ);
+    }
+
+    return consumed;
+}
+
+/**
+ * Buffer bytes of line (or header block) until its terminator.
+ *
+ * @param   c           Connection.
+ * @param   data        Bytes read.
+ * @param   length      Number of bytes.
+ * @param   consumed    Pointer to store number of bytes consumed in.
+ * @param   end         Terminator of line.
+ * @return  1 if the line is complete (NUL terminated in c->line, with
+ * c->line_length including the terminator), 0 if not yet, or -1 if it does
+ * not fit.
+ **/
+int connection_line(Connection *c, const char *data, size_t length, size_t *consumed, const char *end) {
+    size_t room   = sizeof(c->line) - 1 - c->line_length;
+    size_t n      = length < room ? length : room;
+    size_t from   = c->line_length > strlen(end) ? c->line_length - strlen(end) : 0;
+    char  *found;
+
+    memcpy(c->line + c->line_length, data, n);
+    c->line[c->line_length + n] = '\0';
+
+    if ((found = strstr(c->line + from, end))) {
+        size_t total = found - c->line + strlen(end);
+
+        *consumed      = total - c->line_length;
+        c->line_length = total;
+        c->line[total] = '\0';
+        return 1;
+    }
+
+    c->line_length += n;
+    *consumed       = n;
+    return c->line_length < sizeof(c->line) - 1 ? 0 : -1;
+}
+
+/**
+ * Parse response header block in c->line.
+ *
+ * @param   c           Connection.
+ * @return  Whether the header block was valid.
+ *
+ * This determines how the body is framed: by Content-Length, chunked, or by
+ * the server closing the connection.
+ **/
+bool connection_headers(Connection *c) {
+    bool     chunked = false;
+    bool     sized   = false;
+    int      minor   = 1;
+    char    *line;
+
+    if (sscanf(c->line, "HTTP/1.%d %d", &minor, &c->status) != 2) {
+        return false;
+    }
+
+    c->close     = minor == 0;
+    c->remaining = 0;
+
+    for (line = strstr(c->line, "\r\n"); line && line[2] != '\r'; line = strstr(line + 2, "\r\n")) {
+        char *name = line + 2;
+
+        if (strncasecmp(name, "Content-Length:", 15) == 0) {
+            c->remaining = strtoull(name + 15, NULL, 10);
+            sized        = true;
+        } else if (strncasecmp(name, "Transfer-Encoding:", 18) == 0) {
+            chunked = strncasecmp(name + 18 + strspn(name + 18, " \t"), "chunked", 7) == 0;
+        } else if (strncasecmp(name, "Connection:", 11) == 0) {
+            char *value = name + 11 + strspn(name + 11, " \t");
+
+            c->close = strncasecmp(value, "close", 5) == 0 ||
+                       (c->close && strncasecmp(value, "keep-alive", 10) != 0);
+        }
+    }
+
+    c->line_length = 0;
+
+    if (c->status == 304 || c->status == 204 || (sized && c->remaining == 0 && !chunked)) {
+        c->state = PARSE_HEADERS;
+        return true;
+    }
+
+    if (chunked) {
+        c->state = PARSE_CHUNK_SIZE;
+    } else if (sized) {
+        c->state = PARSE_BODY;
+    } else {
+        c->state = PARSE_UNTIL_CLOSE;
+        c->close = true;
+    }
+
+    return true;
+}
+
+/**
+ * Record completed response and move on to the next.
+ *
+ * @param   w           Worker.
+ * @param   c           Connection.
+ *
+ * Responses that arrive after Deadline are not counted.
+ **/
+void connection_complete(Worker *w, Connection *c) {
+    uint64_t now   = now_ns();
+    bool     close = (c->close || !KeepAlive) && c->state != PARSE_UNTIL_CLOSE;
+
+    c->state       = PARSE_HEADERS;
+    c->line_length = 0;
+
+    if (c->count == 0) {
+        return;
+    }
+
+    if (now < Deadline) {
+        uint64_t latency = now - c->intended[c->head];
+
+        w->latency.buckets[histogram_bucket(latency)]++;
+        w->latency.count++;
+        w->latency.max = latency > w->latency.max ? latency : w->latency.max;
+        w->responses[c->status >= 100 && c->status < 600 ? c->status / 100 : 0]++;
+    }
+
+    c->head = (c->head + 1) % BENCH_MAX_DEPTH;
+    c->count--;
+    w->finished++;
+
+    if (close) {
+        connection_reset(w, c, ERROR_COUNT);
+    } else if (w->interval == 0) {
+        connection_fill(w, c, now);
+    }
+}
+
+/**
+ * Read monotonic clock.
+ *
+ * @return  Nanoseconds.
+ **/
+uint64_t now_ns(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/**
+ * Determine histogram bucket of value.
+ *
+ * @param   value       Value.
+ * @return  Index of bucket (values below 2^BENCH_SUB_BITS are exact, larger
+ * values share buckets within 1/32 of their size).
+ **/
+size_t histogram_bucket(uint64_t value) {
+    int shift;
+
+    if (value < (1u << BENCH_SUB_BITS)) {
+        return value;
+    }
+
+    shift = 63 - __builtin_clzll(value) - BENCH_SUB_BITS;
+    return ((size_t)(shift + 1) << BENCH_SUB_BITS) + ((value >> shift) & ((1u << BENCH_SUB_BITS) - 1));
+}
+
+/**
+ * Determine largest value of histogram bucket.
+ *
+ * @param   bucket      Index of bucket.
+ * @return  Largest value counted in bucket.
+ **/
+uint64_t histogram_upper(size_t bucket) {
+    int      shift    = (bucket >> BENCH_SUB_BITS) - 1;
+    uint64_t mantissa = (bucket & ((1u << BENCH_SUB_BITS) - 1)) | (1u << BENCH_SUB_BITS);
+
+    if (bucket < (1u << BENCH_SUB_BITS)) {
+        return bucket;
+    }
+
+    return ((mantissa + 1) << shift) - 1;
+}
+
+/**
+ * Add histogram to total.
+ *
+ * @param   total       Histogram to add to.
+ * @param   h           Histogram to add.
+ **/
+void histogram_merge(Histogram *total, const Histogram *h) {
+    for (size_t i = 0; i < BENCH_BUCKETS; i++) {
+        total->buckets[i] += h->buckets[i];
+    }
+
+    total->count += h->count;
+    total->max    = h->max > total->max ? h->max : total->max;
+}
+
+/**
+ * Estimate quantile of histogram.
+ *
+ * @param   h           Histogram.
+ * @param   q           Quantile (ie. 0.99).
+ * @return  Upper bound of bucket holding quantile (at most the largest value).
+ **/
+uint64_t histogram_quantile(const Histogram *h, double q) {
+    uint64_t rank = (uint64_t)(q * h->count + 0.999999);
+    uint64_t seen = 0;
+
+    rank = rank > 0 ? rank : 1;
+
+    for (size_t i = 0; i < BENCH_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint64_t upper = histogram_upper(i);
+
+            return upper < h->max ? upper : h->max;
+        }
+    }
+
+    return h->max;
+}
+
+/**
+ * Parses command line options, runs workers, and reports results.
+ **/
+int main(int argc, char *argv[]) {
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    Worker         *workers;
+    Histogram      *latency;
+    uint64_t        responses[6] = {0};
+    uint64_t        errors[ERROR_COUNT] = {0};
+    uint64_t        bytes = 0, failures = 0, finished;
+    double          elapsed;
+    char           *path;
+    int             status;
+
+    /* Parse command line options */
+    if (!parse_options(argc, argv, &path)) {
+        usage(argv[0], EXIT_FAILURE);
+    }
+
+    if ((status = getaddrinfo(Host, Port, &hints, &Address)) != 0) {
+        fprintf(stderr, "Unable to look up %s:%s: %s\n", Host, Port, gai_strerror(status));
+        return EXIT_FAILURE;
+    }
+
+    /* Render request mix */
+    if (MixPath ? !load_mix(MixPath) : !add_target(path, 1)) {
+        return EXIT_FAILURE;
+    }
+
+    /* Start workers, splitting connections, requests, and rate evenly */
+    workers = calloc(Threads, sizeof(Worker));
+    latency = calloc(1, sizeof(Histogram));
+    if (!workers || !latency) {
+        fprintf(stderr, "Unable to allocate workers: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    Start = now_ns();
+    if (Duration > 0) {
+        Deadline = Start + (uint64_t)(Duration * 1e9);
+    }
+
+    for (size_t i = 0; i < Threads; i++) {
+        Worker *w      = &workers[i];
+        size_t  length = 0;
+
+        for (size_t t = 0; t < NTargets; t++) {
+            length = Targets[t].length > length ? Targets[t].length : length;
+        }
+
+        w->nconnections = Connections / Threads + (i < Connections % Threads);
+        w->connections  = calloc(w->nconnections, sizeof(Connection));
+        w->quota        = Requests / Threads + (i < Requests % Threads);
+        w->interval     = Rate > 0 ? (uint64_t)(1e9 * Threads / Rate) : 0;
+        w->random       = 88172645463325252ull + i;
+        w->epfd         = epoll_create1(EPOLL_CLOEXEC);
+
+        if (Requests > 0 && w->quota == 0) {
+            w->quota = 1;
+        }
+
+        for (size_t c = 0; w->connections && c < w->nconnections; c++) {
+            w->connections[c].fd     = -1;
+            w->connections[c].output = malloc(Depth * length);
+            if (!w->connections[c].output) {
+                w->connections = NULL;
+            }
+        }
+
+        if (!w->connections || w->epfd < 0) {
+            fprintf(stderr, "Unable to allocate connections: %s\n", strerror(errno));
+            return EXIT_FAILURE;
+        }
+
+        if ((errno = pthread_create(&w->thread, NULL, worker_run, w)) != 0) {
+            fprintf(stderr, "Unable to create thread: %s\n", strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (size_t i = 0; i < Threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+
+        histogram_merge(latency, &workers[i].latency);
+        for (size_t s = 0; s < 6; s++) {
+            responses[s] += workers[i].responses[s];
+        }
+        for (size_t e = 0; e < ERROR_COUNT; e++) {
+            errors[e] += workers[i].errors[e];
+            failures  += workers[i].errors[e];
+        }
+        bytes += workers[i].bytes;
+        close(workers[i].epfd);
+    }
+
+    elapsed  = (double)((Deadline < now_ns() ? Deadline : now_ns()) - Start) / 1e9;
+    finished = latency->count;
+
+    /* Report results */
+    if (Quiet) {
+        printf("%10.1f req/s  p50 %8.3fms  p99 %8.3fms  p99.9 %8.3fms  non-2xx %llu  errors %llu\n",
+               finished / elapsed, histogram_quantile(latency, 0.5) / 1e6, histogram_quantile(latency, 0.99) / 1e6,
+               histogram_quantile(latency, 0.999) / 1e6, (unsigned long long)(finished - responses[2]),
+               (unsigned long long)failures);
+        return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    printf("%zu threads, %zu connections, depth %zu, %s, ", Threads, Connections, Depth,
+           KeepAlive ? "keep-alive" : "close after each response");
+    if (Rate > 0) {
+        printf("%.1f requests/s\n", Rate);
+    } else {
+        printf("unlimited rate\n");
+    }
+    printf("Requests    %llu in %.2fs (%.1f/s), %.2f MB/s read\n", (unsigned long long)finished, elapsed,
+           finished / elapsed, bytes / elapsed / 1e6);
+    printf("Latency     p50 %.3fms  p90 %.3fms  p99 %.3fms  p99.9 %.3fms  max %.3fms\n",
+           histogram_quantile(latency, 0.5) / 1e6, histogram_quantile(latency, 0.9) / 1e6,
+           histogram_quantile(latency, 0.99) / 1e6, histogram_quantile(latency, 0.999) / 1e6, latency->max / 1e6);
+    printf("Responses   1xx %llu  2xx %llu  3xx %llu  4xx %llu  5xx %llu  other %llu\n",
+           (unsigned long long)responses[1], (unsigned long long)responses[2], (unsigned long long)responses[3],
+           (unsigned long long)responses[4], (unsigned long long)responses[5], (unsigned long long)responses[0]);
+    printf("Errors     ");
+    for (size_t e = 0; e < ERROR_COUNT; e++) {
+        printf(" %s %llu ", ErrorNames[e], (unsigned long long)errors[e]);
+    }
+    printf("\n");
+
+    return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
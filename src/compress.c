@@ -0,0 +1,379 @@
+/* compress.c: Content-Encoding Negotiation and Compressed Response Cache */
+
+#include "server.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <strings.h>
+
+#include <unistd.h>
+#include <zlib.h>
+
+/* Constants */
+
+#define COMPCACHE_BUCKETS       256     /* Power of two */
+#define COMPRESS_LEVEL          6
+
+/* Cache (single least recently used list) */
+
+static struct {
+    pthread_mutex_t     lock;           /*< Protects everything below */
+    CompressedResponse *buckets[COMPCACHE_BUCKETS];
+    CompressedResponse *newest;         /*< Most recently used response */
+    CompressedResponse *oldest;         /*< Least recently used response */
+    size_t              bytes;          /*< Bytes used by cache */
+} CompressCache = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/* Internal Declarations */
+CompressedResponse * compcache_find(const char *path, uint32_t hash, Encoding encoding);
+void                 compcache_push(CompressedResponse *c);
+void                 compcache_unlink(CompressedResponse *c);
+void                 compcache_remove(CompressedResponse *c);
+void                 compcache_free(CompressedResponse *c);
+size_t               compcache_cost(const CompressedResponse *c);
+
+/**
+ * Parse Accept-Encoding header.
+ *
+ * @param   value       Value of Accept-Encoding header (or NULL).
+ * @return  Bitmask of acceptable encodings we can produce.
+ *
+ * Codings are comma separated and may carry a quality value, where q=0 means
+ * the coding is not acceptable.  The wildcard accepts every coding we know.
+ **/
+unsigned encoding_accepted(const char *value) {
+    unsigned accepted = ENCODING_IDENTITY;
+
+    while (value && *value) {
+        const char *end;
+        const char *params;
+        size_t      length;
+        unsigned    encoding = ENCODING_IDENTITY;
+
+        while (*value == ' ' || *value == '\t' || *value == ',') value++;
+
+        end    = value + strcspn(value, ",");
+        params = value + strcspn(value, ";, \t");
+        length = params - value;
+
+        if ((length == 4 && strncasecmp(value, "gzip", 4) == 0) ||
+            (length == 6 && strncasecmp(value, "x-gzip", 6) == 0)) {
+            encoding = ENCODING_GZIP;
+        } else if (length == 2 && strncasecmp(value, "br", 2) == 0) {
+            encoding = ENCODING_BROTLI;
+        } else if (length == 1 && *value == '*') {
+            encoding = ENCODING_GZIP | ENCODING_BROTLI;
+        }
+
+        /* Skip codings with a zero quality value */
+        const char *q = strstr(params, "q=");
+
+        if (encoding && !(q && q < end && strtod(q + 2, NULL) == 0)) {
+            accepted |= encoding;
+        }
+
+        value = end;
+    }
+
+    return accepted;
+}
+
+/**
+ * Determine whether responses of mime-type are worth compressing.
+ *
+ * @param   mimetype    Mime-type of response (or NULL).
+ * @return  Whether or not mimetype is text-like.
+ **/
+bool encoding_compressible(const char *mimetype) {
+    if (!mimetype) {
+        return false;
+    }
+
+    return strncmp(mimetype, "text/", 5) == 0 || strstr(mimetype, "json") ||
+           strstr(mimetype, "xml") || strstr(mimetype, "javascript");
+}
+
+/**
+ * Return HTTP content-coding name of encoding.
+ *
+ * @param   encoding    Single encoding.
+ * @return  Name of encoding (ie. "gzip").
+ **/
+const char * encoding_name(Encoding encoding) {
+    switch (encoding) {
+        case ENCODING_GZIP:     return "gzip";
+        case ENCODING_BROTLI:   return "br";
+        default:                return "identity";
+    }
+}
+
+/**
+ * Compress buffer with gzip.
+ *
+ * @param   data        Data to compress.
+ * @param   length      Length of data.
+ * @param   compressed  Pointer to store length of compressed data in.
+ * @return  Allocated compressed data that must be free'd (or NULL on failure).
+ **/
+char * gzip_compress(const char *data, size_t length, size_t *compressed) {
+    z_stream z = {0};
+    char    *output;
+
+    if (deflateInit2(&z, COMPRESS_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return NULL;
+    }
+
+    /* Bound (plus gzip header and trailer) always fits in one pass */
+    size_t bound = deflateBound(&z, length) + 32;
+
+    if (!(output = malloc(bound))) {
+        deflateEnd(&z);
+        return NULL;
+    }
+
+    z.next_in   = (Bytef *)data;
+    z.avail_in  = length;
+    z.next_out  = (Bytef *)output;
+    z.avail_out = bound;
+
+    if (deflate(&z, Z_FINISH) != Z_STREAM_END) {
+        debug("Unable to deflate: %s", z.msg ? z.msg : "output buffer too small");
+        deflateEnd(&z);
+        free(output);
+        return NULL;
+    }
+
+    *compressed = z.total_out;
+    deflateEnd(&z);
+    return output;
+}
+
+/**
+ * Look up compressed body of file, compressing it on a miss.
+ *
+ * @param   f           Cached metadata of file.
+ * @param   encoding    Encoding to compress with (only ENCODING_GZIP).
+ * @return  Referenced response that must be released with compcache_release
+ * (or NULL if the file is too large or could not be compressed).
+ *
+ * Responses are keyed by path, modification time, and encoding, so each
+ * version of a file is compressed once.  Stale responses are dropped, and the
+ * least recently used responses are evicted to stay within
+ * CompressCacheBudget.
+ **/
+CompressedResponse * compcache_lookup(const FileEntry *f, Encoding encoding) {
+    CompressedResponse *c, *existing;
+    char               *data;
+    off_t               offset = 0;
+
+    if (CompressCacheBudget == 0 || encoding != ENCODING_GZIP || f->fd < 0 ||
+        (size_t)f->size > CompressMaxObject) {
+        return NULL;
+    }
+
+    /* Check cache */
+    pthread_mutex_lock(&CompressCache.lock);
+
+    c = compcache_find(f->path, f->hash, encoding);
+
+    if (c && (c->size != f->size || c->mtime.tv_sec != f->mtime.tv_sec || c->mtime.tv_nsec != f->mtime.tv_nsec)) {
+        compcache_remove(c);
+        c = NULL;
+    }
+
+    if (c) {
+        compcache_unlink(c);
+        compcache_push(c);
+        c->references++;
+        pthread_mutex_unlock(&CompressCache.lock);
+        return c;
+    }
+
+    pthread_mutex_unlock(&CompressCache.lock);
+
+    /* Read and compress file */
+    if (!(data = malloc(f->size + 1))) {
+        return NULL;
+    }
+
+    while (offset < f->size) {
+        ssize_t nread = pread(f->fd, data + offset, f->size - offset, offset);
+
+        if (nread < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (nread <= 0) {
+            debug("Unable to read %s: %s", f->path, nread < 0 ? strerror(errno) : "file truncated");
+            free(data);
+            return NULL;
+        }
+
+        offset += nread;
+    }
+
+    if (!(c = calloc(1, sizeof(CompressedResponse)))) {
+        free(data);
+        return NULL;
+    }
+
+    c->path       = strdup(f->path);
+    c->hash       = f->hash;
+    c->encoding   = encoding;
+    c->size       = f->size;
+    c->mtime      = f->mtime;
+    c->data       = gzip_compress(data, f->size, &c->length);
+    c->references = 2;                  /* Cache and caller */
+    free(data);
+
+    if (!c->path || !c->data) {
+        compcache_free(c);
+        return NULL;
+    }
+
+    /* Insert unless another request beat us to it, then evict */
+    pthread_mutex_lock(&CompressCache.lock);
+
+    if ((existing = compcache_find(c->path, c->hash, encoding))) {
+        compcache_remove(existing);
+    }
+
+    c->next = CompressCache.buckets[c->hash & (COMPCACHE_BUCKETS - 1)];
+    CompressCache.buckets[c->hash & (COMPCACHE_BUCKETS - 1)] = c;
+    compcache_push(c);
+
+    while (CompressCache.bytes > CompressCacheBudget && CompressCache.oldest != c) {
+        debug("Evicting %s from compressed response cache", CompressCache.oldest->path);
+        compcache_remove(CompressCache.oldest);
+    }
+
+    pthread_mutex_unlock(&CompressCache.lock);
+    return c;
+}
+
+/**
+ * Release reference to compressed response, freeing it once it is no longer used.
+ *
+ * @param   c           Response returned by compcache_lookup.
+ **/
+void compcache_release(CompressedResponse *c) {
+    size_t references;
+
+    if (!c) {
+        return;
+    }
+
+    pthread_mutex_lock(&CompressCache.lock);
+    references = --c->references;
+    pthread_mutex_unlock(&CompressCache.lock);
+
+    if (references == 0) {
+        compcache_free(c);
+    }
+}
+
+/**
+ * Find cached response for path and encoding (lock must be held).
+ *
+ * @param   path        Resolved path of file.
+ * @param   hash        Hash of path.
+ * @param   encoding    Encoding of response.
+ * @return  Cached response (or NULL if not cached).
+ **/
+CompressedResponse * compcache_find(const char *path, uint32_t hash, Encoding encoding) {
+    for (CompressedResponse *c = CompressCache.buckets[hash & (COMPCACHE_BUCKETS - 1)]; c; c = c->next) {
+        if (c->hash == hash && c->encoding == encoding && streq(c->path, path)) {
+            return c;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Link response as most recently used (lock must be held).
+ *
+ * @param   c           Response.
+ **/
+void compcache_push(CompressedResponse *c) {
+    c->newer = NULL;
+    c->older = CompressCache.newest;
+
+    if (CompressCache.newest) {
+        CompressCache.newest->newer = c;
+    } else {
+        CompressCache.oldest = c;
+    }
+
+    CompressCache.newest = c;
+    CompressCache.bytes += compcache_cost(c);
+}
+
+/**
+ * Unlink response from least recently used list (lock must be held).
+ *
+ * @param   c           Response.
+ **/
+void compcache_unlink(CompressedResponse *c) {
+    if (c->newer) {
+        c->newer->older = c->older;
+    } else {
+        CompressCache.newest = c->older;
+    }
+
+    if (c->older) {
+        c->older->newer = c->newer;
+    } else {
+        CompressCache.oldest = c->newer;
+    }
+
+    c->newer = c->older = NULL;
+    CompressCache.bytes -= compcache_cost(c);
+}
+
+/**
+ * Remove response from cache (lock must be held).
+ *
+ * @param   c           Response.
+ *
+ * The cache's reference is dropped here, but the response itself is only
+ * free'd once requests still sending it have released it.
+ **/
+void compcache_remove(CompressedResponse *c) {
+    CompressedResponse **p = &CompressCache.buckets[c->hash & (COMPCACHE_BUCKETS - 1)];
+
+    while (*p != c) {
+        p = &(*p)->next;
+    }
+    *p = c->next;
+
+    compcache_unlink(c);
+
+    if (--c->references == 0) {
+        compcache_free(c);
+    }
+}
+
+/**
+ * Free response.
+ *
+ * @param   c           Response.
+ **/
+void compcache_free(CompressedResponse *c) {
+    free(c->path);
+    free(c->data);
+    free(c);
+}
+
+/**
+ * Determine number of bytes charged to budget for response.
+ *
+ * @param   c           Response.
+ * @return  Bytes used by response.
+ **/
+size_t compcache_cost(const CompressedResponse *c) {
+    return sizeof(CompressedResponse) + c->length;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
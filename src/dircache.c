@@ -0,0 +1,402 @@
+/* dircache.c: Rendered Directory Listing Cache */
+
+#include "server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* Constants */
+
+#define DIRCACHE_BUCKETS        64      /* Power of two */
+#define DIRCACHE_MAX_LISTINGS   64
+#define DIRCACHE_BATCH          (64 << 10)
+
+/* Directory Entry (as returned by getdents64) */
+
+typedef struct {
+    uint64_t        d_ino;              /*< Inode number */
+    int64_t         d_off;              /*< Offset of next entry */
+    unsigned short  d_reclen;           /*< Length of this record */
+    unsigned char   d_type;             /*< File type */
+    char            d_name[];           /*< NUL terminated name */
+} LinuxDirent;
+
+/* Cache (single least recently used list) */
+
+static struct {
+    pthread_mutex_t lock;               /*< Protects everything below */
+    DirListing     *buckets[DIRCACHE_BUCKETS];
+    DirListing     *newest;             /*< Most recently used listing */
+    DirListing     *oldest;             /*< Least recently used listing */
+    size_t          size;               /*< Number of cached listings */
+} DirCache = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/* Internal Declarations */
+DirListing * dircache_render(const FileEntry *dir, const char *uri, uint32_t hash);
+char **      dircache_read(const char *path, char **names, size_t *count);
+int          dircache_compare(const void *a, const void *b);
+DirListing * dircache_find(const char *uri, uint32_t hash);
+void         dircache_push(DirListing *l);
+void         dircache_unlink(DirListing *l);
+void         dircache_remove(DirListing *l);
+void         dircache_free(DirListing *l);
+uint32_t     dircache_hash(const char *uri);
+
+/**
+ * Look up rendered listing of directory, rendering it on a miss.
+ *
+ * @param   dir         Cached metadata of directory.
+ * @param   uri         Request URI of directory (links are relative to it).
+ * @return  Referenced listing that must be released with dircache_release (or
+ * NULL if the directory could not be read).
+ *
+ * Listings are keyed by URI and only used while the directory still has the
+ * entity tag it had when it was listed.  Since the file cache drops a
+ * directory's metadata as soon as inotify reports a change in it (or once
+ * FileCacheTTL expires), a listing is rendered again only after the directory
+ * actually changed, and requests in between are served without reading or
+ * sorting the directory.
+ **/
+DirListing * dircache_lookup(const FileEntry *dir, const char *uri) {
+    uint32_t    hash = dircache_hash(uri);
+    DirListing *l, *existing;
+
+    /* Check cache */
+    pthread_mutex_lock(&DirCache.lock);
+
+    l = dircache_find(uri, hash);
+
+    if (l && !streq(l->validator, dir->etag)) {
+        dircache_remove(l);
+        l = NULL;
+    }
+
+    if (l) {
+        dircache_unlink(l);
+        dircache_push(l);
+        l->references++;
+        pthread_mutex_unlock(&DirCache.lock);
+        return l;
+    }
+
+    pthread_mutex_unlock(&DirCache.lock);
+
+    /* Render listing */
+    if (!(l = dircache_render(dir, uri, hash))) {
+        return NULL;
+    }
+
+    /* Insert unless another request beat us to it, then evict */
+    pthread_mutex_lock(&DirCache.lock);
+
+    if ((existing = dircache_find(uri, hash))) {
+        dircache_remove(existing);
+    }
+
+    l->next = DirCache.buckets[hash & (DIRCACHE_BUCKETS - 1)];
+    DirCache.buckets[hash & (DIRCACHE_BUCKETS - 1)] = l;
+    dircache_push(l);
+
+    if (DirCache.size > DIRCACHE_MAX_LISTINGS) {
+        dircache_remove(DirCache.oldest);
+    }
+
+    pthread_mutex_unlock(&DirCache.lock);
+    return l;
+}
+
+/**
+ * Release reference to listing, freeing it once it is no longer used.
+ *
+ * @param   l           Listing returned by dircache_lookup.
+ **/
+void dircache_release(DirListing *l) {
+    size_t references;
+
+    if (!l) {
+        return;
+    }
+
+    pthread_mutex_lock(&DirCache.lock);
+    references = --l->references;
+    pthread_mutex_unlock(&DirCache.lock);
+
+    if (references == 0) {
+        dircache_free(l);
+    }
+}
+
+/**
+ * Render listing of directory.
+ *
+ * @param   dir         Cached metadata of directory.
+ * @param   uri         Request URI of directory.
+ * @param   hash        Hash of URI.
+ * @return  Allocated listing with references for the cache and the caller (or
+ * NULL on failure).
+ *
+ * The listing is an HTML list of the directory's entries (except ".") in
+ * collation order, tagged with a hash of its contents (FNV-1a).  A gzipped
+ * copy is kept alongside unless compression is disabled.
+ **/
+DirListing * dircache_render(const FileEntry *dir, const char *uri, uint32_t hash) {
+    DirListing *l;
+    FILE       *fs;
+    char       *names;
+    char      **entries;
+    size_t      count;
+    const char *slash = uri[strlen(uri) - 1] != '/' ? "/" : "";
+
+    if (!(entries = dircache_read(dir->path, &names, &count))) {
+        return NULL;
+    }
+
+    if (!(l = calloc(1, sizeof(DirListing))) || !(l->uri = strdup(uri)) ||
+        !(fs = open_memstream(&l->body, &l->length))) {
+        if (l) {
+            free(l->uri);
+        }
+        free(l);
+        free(entries);
+        free(names);
+        return NULL;
+    }
+
+    /* Emit HTML list item for each entry in directory */
+    fputs("<ul>\n", fs);
+    for (size_t i = 0; i < count; i++) {
+        fprintf(fs, "<li><a href=\"%s%s%s\">%s</a></li>\n", uri, slash, entries[i], entries[i]);
+    }
+    fputs("</ul>\n", fs);
+    fclose(fs);
+
+    free(entries);
+    free(names);
+
+    /* Tag listing with hash of its contents (FNV-1a) */
+    l->checksum = 14695981039346656037ull;
+    for (size_t i = 0; i < l->length; i++) {
+        l->checksum = (l->checksum ^ (unsigned char)l->body[i]) * 1099511628211ull;
+    }
+
+    if (CompressCacheBudget > 0) {
+        l->gzip = gzip_compress(l->body, l->length, &l->gzip_length);
+    }
+
+    l->hash       = hash;
+    l->references = 2;                  /* Cache and caller */
+    snprintf(l->validator, sizeof(l->validator), "%s", dir->etag);
+    return l;
+}
+
+/**
+ * Read and sort names of entries in directory.
+ *
+ * @param   path        Request path of directory (opened beneath the root).
+ * @param   names       Pointer to store allocated buffer of NUL terminated names in.
+ * @param   count       Pointer to store number of names in.
+ * @return  Allocated array of sorted pointers into names (or NULL on failure).
+ *
+ * Entries are read with getdents64(2) in batches of DIRCACHE_BATCH bytes, and
+ * the names are packed into one growing buffer, so large directories cost one
+ * system call per batch and no allocation per entry.
+ **/
+char ** dircache_read(const char *path, char **names, size_t *count) {
+    char   *batch   = malloc(DIRCACHE_BATCH);
+    char   *buffer  = NULL;
+    size_t  used    = 0;
+    size_t  size    = 0;
+    size_t  n       = 0;
+    char  **entries = NULL;
+    long    nread;
+    int     fd;
+
+    if (!batch || (fd = open_request_path(path, O_RDONLY | O_DIRECTORY)) < 0) {
+        free(batch);
+        return NULL;
+    }
+
+    while ((nread = syscall(SYS_getdents64, fd, batch, DIRCACHE_BATCH)) > 0) {
+        for (long offset = 0; offset < nread; ) {
+            LinuxDirent *d      = (LinuxDirent *)(batch + offset);
+            size_t       length = strlen(d->d_name) + 1;
+
+            offset += d->d_reclen;
+
+            if (streq(d->d_name, ".")) {
+                continue;
+            }
+
+            if (used + length > size) {
+                char *grown = realloc(buffer, size = 2 * size + DIRCACHE_BATCH);
+
+                if (!grown) {
+                    nread = -1;
+                    break;
+                }
+                buffer = grown;
+            }
+
+            memcpy(buffer + used, d->d_name, length);
+            used += length;
+            n++;
+        }
+
+        if (nread < 0) {
+            break;
+        }
+    }
+
+    close(fd);
+    free(batch);
+
+    if (nread < 0) {
+        debug("Unable to read directory %s: %s", path, strerror(errno));
+        free(buffer);
+        return NULL;
+    }
+
+    /* Point at each name (only once the buffer is done moving), then sort */
+    if (!(entries = malloc((n + 1) * sizeof(char *)))) {
+        free(buffer);
+        return NULL;
+    }
+
+    for (size_t i = 0, offset = 0; i < n; i++) {
+        entries[i] = buffer + offset;
+        offset    += strlen(entries[i]) + 1;
+    }
+
+    qsort(entries, n, sizeof(char *), dircache_compare);
+
+    *names = buffer;
+    *count = n;
+    return entries;
+}
+
+/**
+ * Compare names of directory entries (as alphasort does).
+ *
+ * @param   a           Pointer to first name.
+ * @param   b           Pointer to second name.
+ * @return  Collation order of names.
+ **/
+int dircache_compare(const void *a, const void *b) {
+    return strcoll(*(char * const *)a, *(char * const *)b);
+}
+
+/**
+ * Find cached listing for URI (lock must be held).
+ *
+ * @param   uri         Request URI of directory.
+ * @param   hash        Hash of URI.
+ * @return  Cached listing (or NULL if not cached).
+ **/
+DirListing * dircache_find(const char *uri, uint32_t hash) {
+    for (DirListing *l = DirCache.buckets[hash & (DIRCACHE_BUCKETS - 1)]; l; l = l->next) {
+        if (l->hash == hash && streq(l->uri, uri)) {
+            return l;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Link listing as most recently used (lock must be held).
+ *
+ * @param   l           Listing.
+ **/
+void dircache_push(DirListing *l) {
+    l->newer = NULL;
+    l->older = DirCache.newest;
+
+    if (DirCache.newest) {
+        DirCache.newest->newer = l;
+    } else {
+        DirCache.oldest = l;
+    }
+
+    DirCache.newest = l;
+    DirCache.size++;
+}
+
+/**
+ * Unlink listing from least recently used list (lock must be held).
+ *
+ * @param   l           Listing.
+ **/
+void dircache_unlink(DirListing *l) {
+    if (l->newer) {
+        l->newer->older = l->older;
+    } else {
+        DirCache.newest = l->older;
+    }
+
+    if (l->older) {
+        l->older->newer = l->newer;
+    } else {
+        DirCache.oldest = l->newer;
+    }
+
+    l->newer = l->older = NULL;
+    DirCache.size--;
+}
+
+/**
+ * Remove listing from cache (lock must be held).
+ *
+ * @param   l           Listing.
+ *
+ * The cache's reference is dropped here, but the listing itself is only
+ * free'd once requests still sending it have released it.
+ **/
+void dircache_remove(DirListing *l) {
+    DirListing **p = &DirCache.buckets[l->hash & (DIRCACHE_BUCKETS - 1)];
+
+    while (*p != l) {
+        p = &(*p)->next;
+    }
+    *p = l->next;
+
+    dircache_unlink(l);
+
+    if (--l->references == 0) {
+        dircache_free(l);
+    }
+}
+
+/**
+ * Free listing.
+ *
+ * @param   l           Listing.
+ **/
+void dircache_free(DirListing *l) {
+    free(l->uri);
+    free(l->body);
+    free(l->gzip);
+    free(l);
+}
+
+/**
+ * Hash request URI (FNV-1a).
+ *
+ * @param   uri         Request URI.
+ * @return  32-bit hash of URI.
+ **/
+uint32_t dircache_hash(const char *uri) {
+    uint32_t hash = 2166136261u;
+
+    while (*uri) {
+        hash = (hash ^ (unsigned char)*uri++) * 16777619u;
+    }
+
+    return hash;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
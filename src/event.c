@@ -0,0 +1,539 @@
+/* event.c: Event-Driven HTTP Server */
+
+#include "server.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <time.h>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* Constants */
+
+#define EVENT_MAX_EVENTS    1024
+#define EVENT_ACCEPT_BATCH  64
+
+/* Connection */
+
+typedef struct connection Connection;
+struct connection {
+    Request    *request;                /*< Client request */
+    char       *output;                 /*< Buffered response */
+    size_t      output_size;            /*< Size of buffered response */
+    size_t      output_sent;            /*< Bytes of response already sent */
+    uint32_t    events;                 /*< Events currently watched (0 if unregistered) */
+    bool        deferred;               /*< Whether request is with a helper thread */
+    bool        eof;                    /*< Whether client has finished sending */
+    time_t      deadline;               /*< Time at which idle connection is closed */
+    Connection *prev;                   /*< Previous connection in idle list */
+    Connection *next;                   /*< Next connection in idle list */
+};
+
+/* Idle list ordered by deadline (oldest activity first) */
+static Connection *Oldest = NULL;
+static Connection *Newest = NULL;
+
+/* Marks the eventfd of helper threads in epoll */
+static char Helpers;
+
+/* Internal Declarations */
+void event_accept(int efd, int sfd);
+bool event_read(int efd, Connection *c);
+bool event_respond(int efd, Connection *c);
+bool event_defer(int efd, Connection *c);
+void event_resume(int efd, int hfd);
+bool event_write(int efd, Connection *c);
+bool event_watch(int efd, Connection *c, uint32_t events);
+void event_touch(Connection *c);
+void event_unlink(Connection *c);
+void event_close(int efd, Connection *c);
+
+/**
+ * Multiplex HTTP requests on a single thread with epoll.
+ *
+ * @param   sfd         Server socket file descriptor.
+ * @return  Exit status of server (EXIT_SUCCESS or EXIT_FAILURE).
+ *
+ * Each client socket is made nonblocking and registered with epoll.  Request
+ * data is buffered until a complete header block has arrived, at which point
+ * the request is handled into an in-memory response that is drained back to
+ * the client as the socket becomes writable.  This way one slow client does
+ * not stall every other client.
+ *
+ * CGI requests would block the loop, so they are handed to helper threads
+ * (see offload_init), and their connections leave epoll until the response
+ * has been rendered.
+ *
+ * Persistent connections go back to waiting for requests after each response,
+ * and any connection without activity for KeepAliveTimeout seconds is closed.
+ **/
+int event_server(int sfd) {
+    struct epoll_event events[EVENT_MAX_EVENTS];
+    struct epoll_event event = {
+        .events   = EPOLLIN,
+        .data.ptr = NULL,               /* NULL marks the server socket */
+    };
+    struct epoll_event helpers = {
+        .events   = EPOLLIN,
+        .data.ptr = &Helpers,
+    };
+
+    filecache_init();
+
+    /* Start helper threads */
+    int hfd = offload_init();
+
+    if (hfd < 0) {
+        log("Unable to start helper threads: %s", strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    /* Create epoll instance */
+    int efd = epoll_create1(EPOLL_CLOEXEC);
+
+    /* Check for failure */
+    if (efd < 0) {
+        log("Unable to epoll_create1: %s", strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    /* Register server socket and helper eventfd */
+    if (set_nonblocking(sfd) < 0 || epoll_ctl(efd, EPOLL_CTL_ADD, sfd, &event) < 0 ||
+        epoll_ctl(efd, EPOLL_CTL_ADD, hfd, &helpers) < 0) {
+        log("Unable to register server socket: %s", strerror(errno));
+        close(efd);
+        return EXIT_FAILURE;
+    }
+
+    /* Dispatch events, waking up every second to close idle connections */
+    while (true) {
+        int n = epoll_wait(efd, events, EVENT_MAX_EVENTS, KeepAliveTimeout > 0 ? 1000 : -1);
+
+        /* Check for failure */
+        if (n < 0) {
+            if (errno != EINTR) {
+                log("Unable to epoll_wait: %s", strerror(errno));
+            }
+            continue;
+        }
+
+        for (int i = 0; i < n; i++) {
+            Connection *c = events[i].data.ptr;
+            bool active   = true;
+
+            if (!c) {
+                event_accept(efd, sfd);
+                continue;
+            }
+
+            if (c == (Connection *)&Helpers) {
+                event_resume(efd, hfd);
+                continue;
+            }
+
+            event_touch(c);
+
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                active = false;
+            } else if (events[i].events & EPOLLIN) {
+                active = event_read(efd, c);
+            } else if (events[i].events & EPOLLOUT) {
+                active = event_write(efd, c);
+            }
+
+            if (!active) {
+                event_close(efd, c);
+            }
+        }
+
+        /* Close idle connections */
+        time_t now = time(NULL);
+
+        while (KeepAliveTimeout > 0 && Oldest && Oldest->deadline <= now) {
+            debug("Closing idle connection from %s:%s", request_host(Oldest->request), request_port(Oldest->request));
+            event_close(efd, Oldest);
+        }
+    }
+
+    /* Close epoll instance */
+    close(efd);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Accept all pending clients and register them with epoll.
+ *
+ * @param   efd         Epoll file descriptor.
+ * @param   sfd         Server socket file descriptor.
+ *
+ * Clients are accepted EVENT_ACCEPT_BATCH at a time with nonblocking sockets.
+ * When the listener defers accepts until request data arrives (DeferAccept),
+ * that data is read right away instead of waiting for another epoll_wait.
+ **/
+void event_accept(int efd, int sfd) {
+    Request *requests[EVENT_ACCEPT_BATCH];
+    size_t   n;
+
+    do {
+        /* Accept batch of requests (EAGAIN means no more pending clients) */
+        n = accept_requests(sfd, requests, EVENT_ACCEPT_BATCH, SOCK_NONBLOCK);
+
+        if (n == 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            log("Unable to accept request: %s", strerror(errno));
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            Request *request = requests[i];
+
+            /* Allocate connection */
+            Connection *c = calloc(1, sizeof(Connection));
+
+            if (!c) {
+                log("Unable to allocate connection: %s", strerror(errno));
+                free_request(request);
+                continue;
+            }
+
+            c->request = request;
+            c->events  = EPOLLIN;
+            event_touch(c);
+            metrics_connection(1);
+
+            /* Register client socket */
+            struct epoll_event event = {
+                .events   = EPOLLIN,
+                .data.ptr = c,
+            };
+
+            if (epoll_ctl(efd, EPOLL_CTL_ADD, request->fd, &event) < 0) {
+                log("Unable to register client socket: %s", strerror(errno));
+                event_close(efd, c);
+            } else if (DeferAccept > 0 && !event_read(efd, c)) {
+                event_close(efd, c);
+            }
+        }
+    } while (n == EVENT_ACCEPT_BATCH);
+}
+
+/**
+ * Read request data from client and handle request once headers are complete.
+ *
+ * @param   efd         Epoll file descriptor.
+ * @param   c           Client connection.
+ * @return  Whether or not connection is still active.
+ *
+ * A client may shut down its side of the connection right after sending its
+ * requests, so requests already buffered when it does are still answered
+ * before the connection is closed (see event_write).
+ **/
+bool event_read(int efd, Connection *c) {
+    Request *r = c->request;
+
+    /* Read all available data */
+    while (r->length < sizeof(r->buffer)) {
+        ssize_t nread = read(r->fd, r->buffer + r->length, sizeof(r->buffer) - r->length);
+
+        if (nread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+
+        if (nread == 0 && r->length > 0) {
+            c->eof = true;
+            break;
+        }
+
+        if (nread <= 0) {
+            return false;
+        }
+
+        r->length += nread;
+    }
+
+    /* Wait for complete header block unless buffer is full or client is done */
+    if (!c->eof && !request_headers_complete(r)) {
+        return true;
+    }
+
+    if (!event_respond(efd, c)) {
+        return false;
+    }
+
+    return c->deferred || event_write(efd, c);
+}
+
+/**
+ * Handle buffered request into an in-memory response.
+ *
+ * @param   efd         Epoll file descriptor.
+ * @param   c           Client connection.
+ * @return  Whether or not a response was produced (or the request was handed
+ *          to a helper thread, which sets c->deferred).
+ *
+ * The socket stream only owns the client fd, so it is swapped out for a memory
+ * stream while handle_request renders the response.  File bodies are deferred
+ * so that event_write can sendfile them without buffering.
+ **/
+bool event_respond(int efd, Connection *c) {
+    Request *r      = c->request;
+    FILE    *stream = r->stream;
+
+    r->stream = open_memstream(&c->output, &c->output_size);
+    if (!r->stream) {
+        log("Unable to open_memstream: %s", strerror(errno));
+        r->stream = stream;
+        return false;
+    }
+
+    r->defer_body = true;
+    handle_request(r);
+
+    /* Hand blocking handler to a helper thread (or run it here if that fails) */
+    if (r->deferred && event_defer(efd, c)) {
+        return true;
+    }
+
+    if (r->deferred) {
+        resume_request(r);
+    }
+
+    fclose(r->stream);
+    r->stream = stream;
+    return true;
+}
+
+/**
+ * Hand deferred request to a helper thread.
+ *
+ * @param   efd         Epoll file descriptor.
+ * @param   c           Client connection.
+ * @return  Whether or not the request was handed off.
+ *
+ * The client socket leaves epoll and the connection leaves the idle list, so
+ * nothing touches the request until event_resume gets it back.
+ **/
+bool event_defer(int efd, Connection *c) {
+    Request *r = c->request;
+
+    if (epoll_ctl(efd, EPOLL_CTL_DEL, r->fd, NULL) < 0) {
+        log("Unable to unregister client socket: %s", strerror(errno));
+        return false;
+    }
+
+    c->events = 0;
+
+    if (!offload_request(r, c)) {
+        log("Unable to queue request for helper thread: %s", strerror(errno));
+        return false;
+    }
+
+    c->deferred = true;
+    event_unlink(c);
+    return true;
+}
+
+/**
+ * Resume connections whose requests helper threads have finished.
+ *
+ * @param   efd         Epoll file descriptor.
+ * @param   hfd         Helper eventfd.
+ *
+ * Each rendered response is written like any other, which registers the
+ * client socket with epoll again.
+ **/
+void event_resume(int efd, int hfd) {
+    uint64_t    count;
+    Connection *c;
+
+    if (read(hfd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        log("Unable to read helper eventfd: %s", strerror(errno));
+    }
+
+    while ((c = offload_finished())) {
+        Request *r = c->request;
+
+        fclose(r->stream);
+        r->stream   = NULL;
+        c->deferred = false;
+        event_touch(c);
+
+        if (!event_write(efd, c)) {
+            event_close(efd, c);
+        }
+    }
+}
+
+/**
+ * Write buffered response and any deferred file body to client.
+ *
+ * @param   efd         Epoll file descriptor.
+ * @param   c           Client connection.
+ * @return  Whether or not connection is still active.
+ *
+ * Once a response on a persistent connection has been sent, the request is
+ * reset and any pipelined request already in the buffer is handled right away;
+ * otherwise the connection goes back to waiting for the next request, or is
+ * closed if the client has finished sending.
+ **/
+bool event_write(int efd, Connection *c) {
+    Request *r = c->request;
+
+    while (true) {
+        /* Send headers, hinting that a file body follows */
+        while (c->output_sent < c->output_size) {
+            int     flags    = MSG_NOSIGNAL | (r->body_fd >= 0 ? MSG_MORE : 0);
+            ssize_t nwritten = send(r->fd, c->output + c->output_sent,
+                                    c->output_size - c->output_sent, flags);
+
+            if (nwritten < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return event_watch(efd, c, EPOLLOUT);
+            }
+
+            if (nwritten < 0) {
+                debug("Unable to send: %s", strerror(errno));
+                return false;
+            }
+
+            c->output_sent += nwritten;
+        }
+
+        /* Send file body straight from the page cache */
+        while (r->body_fd >= 0 && r->body_offset < r->body_length) {
+            ssize_t nwritten = socket_sendfile(r->fd, r->body_fd, &r->body_offset,
+                                               r->body_length - r->body_offset);
+
+            if (nwritten < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return event_watch(efd, c, EPOLLOUT);
+            }
+
+            if (nwritten <= 0) {
+                debug("Unable to sendfile: %s", strerror(errno));
+                return false;
+            }
+        }
+
+        /* Response complete */
+        if (!r->keep_alive) {
+            return false;
+        }
+
+        free(c->output);
+        c->output      = NULL;
+        c->output_size = 0;
+        c->output_sent = 0;
+        reset_request(r);
+
+        if (c->eof && r->length == 0) {
+            return false;
+        }
+
+        if (!c->eof && !request_headers_complete(r)) {
+            return event_watch(efd, c, EPOLLIN);
+        }
+
+        if (!event_respond(efd, c)) {
+            return false;
+        }
+
+        if (c->deferred) {
+            return true;
+        }
+    }
+}
+
+/**
+ * Change events watched on client socket.
+ *
+ * @param   efd         Epoll file descriptor.
+ * @param   c           Client connection.
+ * @param   events      Events to watch (EPOLLIN or EPOLLOUT).
+ * @return  Whether or not the events could be watched.
+ *
+ * Sockets that left epoll while their request was deferred are added back.
+ **/
+bool event_watch(int efd, Connection *c, uint32_t events) {
+    struct epoll_event event = {
+        .events   = events,
+        .data.ptr = c,
+    };
+
+    if (c->events == events) {
+        return true;
+    }
+
+    if (epoll_ctl(efd, c->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, c->request->fd, &event) < 0) {
+        log("Unable to modify client socket: %s", strerror(errno));
+        return false;
+    }
+
+    c->events = events;
+    return true;
+}
+
+/**
+ * Record activity on connection by moving it to the end of the idle list.
+ *
+ * @param   c           Client connection.
+ **/
+void event_touch(Connection *c) {
+    event_unlink(c);
+
+    c->deadline = time(NULL) + KeepAliveTimeout;
+    c->prev     = Newest;
+    c->next     = NULL;
+
+    if (Newest) {
+        Newest->next = c;
+    } else {
+        Oldest = c;
+    }
+    Newest = c;
+}
+
+/**
+ * Remove connection from idle list.
+ *
+ * @param   c           Client connection.
+ **/
+void event_unlink(Connection *c) {
+    if (c->prev) {
+        c->prev->next = c->next;
+    } else if (Oldest == c) {
+        Oldest = c->next;
+    }
+
+    if (c->next) {
+        c->next->prev = c->prev;
+    } else if (Newest == c) {
+        Newest = c->prev;
+    }
+
+    c->prev = c->next = NULL;
+}
+
+/**
+ * Close client connection.
+ *
+ * @param   efd         Epoll file descriptor.
+ * @param   c           Client connection.
+ *
+ * The client socket is removed from the epoll instance first, since closing
+ * it does not remove it while a script being spawned by a helper thread still
+ * holds a copy of it.
+ **/
+void event_close(int efd, Connection *c) {
+    if (c->events) {
+        epoll_ctl(efd, EPOLL_CTL_DEL, c->request->fd, NULL);
+    }
+
+    metrics_connection(-1);
+    event_unlink(c);
+    free_request(c->request);
+    free(c->output);
+    free(c);
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
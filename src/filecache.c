@@ -0,0 +1,548 @@
+/* filecache.c: File Metadata Cache */
+
+#include "server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Constants */
+
+#define FILECACHE_BUCKETS       512     /* Power of two */
+#define FILECACHE_MAX_ENTRIES   256
+#define FILECACHE_MAX_WATCHES   256
+#define FILECACHE_WATCH_MASK    (IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MODIFY | \
+                                 IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+/* Watched Directory */
+
+typedef struct {
+    int         wd;                     /*< Inotify watch descriptor */
+    char       *path;                   /*< Path of watched directory */
+} Watch;
+
+/* Cache */
+
+static struct {
+    pthread_mutex_t lock;               /*< Protects everything below */
+    bool            enabled;            /*< Whether the cache is enabled in this process */
+    FileEntry      *buckets[FILECACHE_BUCKETS];
+    FileEntry      *newest;             /*< Most recently used entry */
+    FileEntry      *oldest;             /*< Least recently used entry */
+    size_t          size;               /*< Number of cached entries */
+    uint64_t        generation;         /*< Bumped on every invalidation */
+    int             ifd;                /*< Inotify file descriptor (-1 if unavailable) */
+    Watch           watches[FILECACHE_MAX_WATCHES];
+    size_t          nwatches;
+} FileCache = { .lock = PTHREAD_MUTEX_INITIALIZER, .ifd = -1 };
+
+/* Internal Declarations */
+FileEntry * filecache_load(const char *path);
+FileEntry * filecache_find(const char *path, uint32_t hash);
+void        filecache_insert(FileEntry *e);
+void        filecache_touch(FileEntry *e);
+void        filecache_remove(FileEntry *e);
+void        filecache_free(FileEntry *e);
+void        filecache_invalidate(const char *dir, const char *name);
+void        filecache_watch(const char *path, size_t length);
+void *      filecache_watcher(void *arg);
+void        filecache_prepare(void);
+void        filecache_parent(void);
+void        filecache_child(void);
+uint32_t    filecache_hash(const char *path);
+
+/**
+ * Enable file metadata cache in the current process.
+ *
+ * Entries are invalidated by an inotify watcher thread as soon as a watched
+ * directory changes, and revalidated after FileCacheTTL seconds regardless, as
+ * a fallback for changes that inotify does not report (network filesystems,
+ * unwatched directories).  If FileCacheTTL is 0, the cache stays disabled and
+ * every lookup goes to the filesystem.
+ *
+ * The watcher thread does not survive fork, so the cache is disabled in forked
+ * children until they call this again.
+ **/
+void filecache_init(void) {
+    static bool registered = false;
+    pthread_t   thread;
+    int         status;
+
+    if (FileCacheTTL <= 0 || FileCache.enabled) {
+        return;
+    }
+
+    if (!registered) {
+        pthread_atfork(filecache_prepare, filecache_parent, filecache_child);
+        registered = true;
+    }
+
+    /* Drop anything inherited from a parent process */
+    while (FileCache.oldest) {
+        filecache_remove(FileCache.oldest);
+    }
+
+    FileCache.enabled = true;
+    FileCache.ifd     = inotify_init1(IN_CLOEXEC);
+
+    if (FileCache.ifd < 0) {
+        log("Unable to inotify_init1 (%s), relying on TTL", strerror(errno));
+        return;
+    }
+
+    filecache_watch(RootPath, strlen(RootPath));
+
+    if ((status = pthread_create(&thread, NULL, filecache_watcher, NULL)) != 0) {
+        log("Unable to create watcher thread (%s), relying on TTL", strerror(status));
+        return;
+    }
+
+    pthread_detach(thread);
+}
+
+/**
+ * Look up metadata for path, loading it from the filesystem on a miss.
+ *
+ * @param   path        Resolved path of file.
+ * @return  Referenced entry that must be released with filecache_release (or
+ * NULL on allocation failure).
+ *
+ * A path that does not exist yields a negative entry (exists is false).
+ **/
+FileEntry * filecache_lookup(const char *path) {
+    uint32_t   hash = filecache_hash(path);
+    uint64_t   generation = 0;
+    FileEntry *e;
+
+    if (FileCache.enabled) {
+        pthread_mutex_lock(&FileCache.lock);
+
+        e = filecache_find(path, hash);
+
+        if (e && e->expires > time(NULL)) {
+            e->references++;
+            filecache_touch(e);
+            pthread_mutex_unlock(&FileCache.lock);
+            return e;
+        }
+
+        if (e) {
+            filecache_remove(e);
+        }
+
+        generation = FileCache.generation;
+        pthread_mutex_unlock(&FileCache.lock);
+    }
+
+    /* Miss: load from filesystem */
+    if (!(e = filecache_load(path))) {
+        return NULL;
+    }
+
+    e->hash = hash;
+
+    if (!FileCache.enabled) {
+        return e;
+    }
+
+    /* Cache unless something was invalidated (or cached) while loading */
+    pthread_mutex_lock(&FileCache.lock);
+    if (generation == FileCache.generation && !filecache_find(path, hash)) {
+        e->references++;
+        filecache_insert(e);
+
+        if (FileCache.size > FILECACHE_MAX_ENTRIES) {
+            filecache_remove(FileCache.oldest);
+        }
+
+        filecache_watch(path, e->exists && S_ISDIR(e->mode) ? strlen(path) : (size_t)(strrchr(path, '/') - path));
+    }
+    pthread_mutex_unlock(&FileCache.lock);
+
+    return e;
+}
+
+/**
+ * Release reference to entry, freeing it once it is no longer used.
+ *
+ * @param   e           Entry returned by filecache_lookup.
+ **/
+void filecache_release(FileEntry *e) {
+    size_t references;
+
+    if (!e) {
+        return;
+    }
+
+    pthread_mutex_lock(&FileCache.lock);
+    references = --e->references;
+    pthread_mutex_unlock(&FileCache.lock);
+
+    if (references == 0) {
+        filecache_free(e);
+    }
+}
+
+/**
+ * Load metadata for path from the filesystem.
+ *
+ * @param   path        Request path of file (see determine_request_path).
+ * @return  Allocated entry with one reference (or NULL on allocation failure).
+ *
+ * The path is resolved beneath the root (see open_request_path), and its
+ * metadata is taken from the resolved descriptor, so an entry never describes
+ * anything outside the root.  Paths that do not resolve yield negative
+ * entries.
+ *
+ * Regular files that are not executable are opened for reading, so the
+ * descriptor can be shared by every request for the file.  It is only ever
+ * used with explicit offsets, never with the file position.
+ **/
+FileEntry * filecache_load(const char *path) {
+    FileEntry  *e = calloc(1, sizeof(FileEntry));
+    struct stat s;
+    int         fd;
+
+    if (!e || !(e->path = strdup(path))) {
+        free(e);
+        return NULL;
+    }
+
+    e->fd         = -1;
+    e->references = 1;
+    e->expires    = time(NULL) + FileCacheTTL;
+
+    if ((fd = open_request_path(path, O_PATH)) < 0) {
+        return e;
+    }
+
+    if (fstat(fd, &s) < 0) {
+        close(fd);
+        return e;
+    }
+
+    /* Check execute permission on the resolved file (by name where faccessat2 is missing) */
+    e->exists     = true;
+    e->executable = !S_ISDIR(s.st_mode) &&
+                    (faccessat(fd, "", X_OK, AT_EMPTY_PATH) == 0 ||
+                     ((errno == EINVAL || errno == ENOSYS) && access(path, X_OK) == 0));
+    close(fd);
+
+    if (S_ISREG(s.st_mode) && !e->executable) {
+        e->fd = open_request_path(path, O_RDONLY);
+        if (e->fd >= 0) {
+            fstat(e->fd, &s);
+        }
+        e->mimetype = determine_mimetype(path);
+    }
+
+    e->mode  = s.st_mode;
+    e->size  = s.st_size;
+    e->mtime = s.st_mtim;
+
+    /* Validators change whenever the file is replaced, resized, or modified */
+    snprintf(e->etag, sizeof(e->etag), "\"%jx-%jx-%jx.%lx\"", (uintmax_t)s.st_ino,
+             (uintmax_t)s.st_size, (uintmax_t)s.st_mtim.tv_sec, s.st_mtim.tv_nsec);
+    format_http_date(s.st_mtim.tv_sec, e->modified, sizeof(e->modified));
+    return e;
+}
+
+/**
+ * Find cached entry for path (lock must be held).
+ *
+ * @param   path        Resolved path of file.
+ * @param   hash        Hash of path.
+ * @return  Cached entry (or NULL if path is not cached).
+ **/
+FileEntry * filecache_find(const char *path, uint32_t hash) {
+    for (FileEntry *e = FileCache.buckets[hash & (FILECACHE_BUCKETS - 1)]; e; e = e->next) {
+        if (e->hash == hash && streq(e->path, path)) {
+            return e;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Link entry into hash bucket and front of LRU list (lock must be held).
+ *
+ * @param   e           Entry to insert.
+ **/
+void filecache_insert(FileEntry *e) {
+    FileEntry **bucket = &FileCache.buckets[e->hash & (FILECACHE_BUCKETS - 1)];
+
+    e->next = *bucket;
+    *bucket = e;
+
+    e->newer = NULL;
+    e->older = FileCache.newest;
+    if (FileCache.newest) {
+        FileCache.newest->newer = e;
+    } else {
+        FileCache.oldest = e;
+    }
+    FileCache.newest = e;
+
+    FileCache.size++;
+}
+
+/**
+ * Move entry to front of LRU list (lock must be held).
+ *
+ * @param   e           Entry that was used.
+ **/
+void filecache_touch(FileEntry *e) {
+    if (FileCache.newest == e) {
+        return;
+    }
+
+    /* Unlink (e has a newer neighbor since it is not the newest) */
+    e->newer->older = e->older;
+    if (e->older) {
+        e->older->newer = e->newer;
+    } else {
+        FileCache.oldest = e->newer;
+    }
+
+    /* Link in front */
+    e->newer = NULL;
+    e->older = FileCache.newest;
+    FileCache.newest->newer = e;
+    FileCache.newest = e;
+}
+
+/**
+ * Unlink entry from cache (lock must be held).
+ *
+ * @param   e           Entry to remove.
+ *
+ * The cache's reference is dropped here, but the entry itself is only free'd
+ * once requests still using it have released it.
+ **/
+void filecache_remove(FileEntry *e) {
+    FileEntry **p = &FileCache.buckets[e->hash & (FILECACHE_BUCKETS - 1)];
+
+    while (*p != e) {
+        p = &(*p)->next;
+    }
+    *p = e->next;
+
+    if (e->newer) {
+        e->newer->older = e->older;
+    } else {
+        FileCache.newest = e->older;
+    }
+
+    if (e->older) {
+        e->older->newer = e->newer;
+    } else {
+        FileCache.oldest = e->newer;
+    }
+
+    FileCache.size--;
+
+    if (--e->references == 0) {
+        filecache_free(e);
+    }
+}
+
+/**
+ * Free entry and close its file descriptor.
+ *
+ * @param   e           Entry without references.
+ **/
+void filecache_free(FileEntry *e) {
+    if (e->fd >= 0) {
+        close(e->fd);
+    }
+    free(e->path);
+    free(e);
+}
+
+/**
+ * Remove entries affected by a change in a directory (lock must be held).
+ *
+ * @param   dir         Path of changed directory.
+ * @param   name        Name of changed entry in directory (or NULL to flush
+ * everything).
+ *
+ * This removes the directory itself (its listing changed) and the named entry
+ * along with anything beneath it.
+ **/
+void filecache_invalidate(const char *dir, const char *name) {
+    size_t dlength = strlen(dir);
+    size_t nlength = name ? strlen(name) : 0;
+
+    for (FileEntry *e = FileCache.oldest, *newer; e; e = newer) {
+        const char *p = e->path;
+
+        newer = e->newer;
+
+        if (name) {
+            if (strncmp(p, dir, dlength) != 0 || (p[dlength] && p[dlength] != '/')) {
+                continue;
+            }
+
+            p += dlength;
+            while (*p == '/') {
+                p++;
+            }
+
+            if (*p && (strncmp(p, name, nlength) != 0 || (p[nlength] && p[nlength] != '/'))) {
+                continue;
+            }
+        }
+
+        filecache_remove(e);
+    }
+
+    FileCache.generation++;
+}
+
+/**
+ * Watch directory for changes if it is not already watched (lock must be held).
+ *
+ * @param   path        Path containing directory.
+ * @param   length      Length of directory prefix of path.
+ **/
+void filecache_watch(const char *path, size_t length) {
+    char *dir;
+    int   wd;
+
+    if (FileCache.ifd < 0 || FileCache.nwatches == FILECACHE_MAX_WATCHES) {
+        return;
+    }
+
+    while (length > 1 && path[length - 1] == '/') {
+        length--;
+    }
+
+    for (size_t i = 0; i < FileCache.nwatches; i++) {
+        if (strlen(FileCache.watches[i].path) == length && strncmp(FileCache.watches[i].path, path, length) == 0) {
+            return;
+        }
+    }
+
+    if (!(dir = strndup(path, length))) {
+        return;
+    }
+
+    if ((wd = inotify_add_watch(FileCache.ifd, dir, FILECACHE_WATCH_MASK)) < 0) {
+        free(dir);
+        return;
+    }
+
+    FileCache.watches[FileCache.nwatches].wd   = wd;
+    FileCache.watches[FileCache.nwatches].path = dir;
+    FileCache.nwatches++;
+}
+
+/**
+ * Invalidate entries as inotify reports changes.
+ *
+ * @param   arg         Unused.
+ * @return  NULL.
+ *
+ * Changes to a directory itself (or an overflowed event queue) flush the whole
+ * cache, since every path beneath it may have changed.
+ **/
+void * filecache_watcher(void *arg) {
+    char    buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t nread;
+
+    while ((nread = read(FileCache.ifd, buffer, sizeof(buffer))) > 0 || (nread < 0 && errno == EINTR)) {
+        pthread_mutex_lock(&FileCache.lock);
+
+        for (char *p = buffer; p < buffer + nread; ) {
+            struct inotify_event *event = (struct inotify_event *)p;
+            const char           *dir   = NULL;
+
+            p += sizeof(struct inotify_event) + event->len;
+
+            for (size_t i = 0; i < FileCache.nwatches; i++) {
+                if (FileCache.watches[i].wd == event->wd) {
+                    dir = FileCache.watches[i].path;
+
+                    /* Forget watch once the kernel has dropped it */
+                    if (event->mask & IN_IGNORED) {
+                        free(FileCache.watches[i].path);
+                        FileCache.watches[i] = FileCache.watches[--FileCache.nwatches];
+                        dir = NULL;
+                    }
+                    break;
+                }
+            }
+
+            if (event->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                filecache_invalidate("", NULL);
+            } else if (dir) {
+                debug("Invalidating %s/%s", dir, event->len ? event->name : "");
+                filecache_invalidate(dir, event->len ? event->name : "");
+            }
+        }
+
+        pthread_mutex_unlock(&FileCache.lock);
+    }
+
+    log("Unable to read inotify events: %s", strerror(errno));
+    return NULL;
+}
+
+/**
+ * Hold cache lock across fork so children inherit it unlocked and consistent.
+ **/
+void filecache_prepare(void) {
+    pthread_mutex_lock(&FileCache.lock);
+}
+
+/**
+ * Release cache lock in parent after fork.
+ **/
+void filecache_parent(void) {
+    pthread_mutex_unlock(&FileCache.lock);
+}
+
+/**
+ * Disable cache in child after fork, since the watcher thread stayed behind.
+ **/
+void filecache_child(void) {
+    pthread_mutex_unlock(&FileCache.lock);
+
+    if (FileCache.ifd >= 0) {
+        close(FileCache.ifd);
+    }
+
+    for (size_t i = 0; i < FileCache.nwatches; i++) {
+        free(FileCache.watches[i].path);
+    }
+
+    FileCache.enabled  = false;
+    FileCache.ifd      = -1;
+    FileCache.nwatches = 0;
+}
+
+/**
+ * Hash path (FNV-1a).
+ *
+ * @param   path        Path to hash.
+ * @return  Hash of path.
+ **/
+uint32_t filecache_hash(const char *path) {
+    uint32_t hash = 2166136261u;
+
+    for (const unsigned char *c = (const unsigned char *)path; *c; c++) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+
+    return hash;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
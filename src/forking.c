@@ -29,6 +29,9 @@ int forking_server(int sfd) {
             continue;
         }
 
+        /* Reload mime-types before forking so children inherit them */
+        mimetypes_refresh();
+
 	/* Ignore children */
         signal(SIGCHLD, SIG_IGN);
 
@@ -37,7 +40,7 @@ int forking_server(int sfd) {
 
         if (pid == 0) {                         /* Child */
             log("Handle child connection");
-            handle_request(request);
+            handle_connection(request);
             free_request(request);
             exit(EXIT_SUCCESS);
         } else {                                /* Parent */
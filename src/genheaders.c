@@ -0,0 +1,60 @@
+/* genheaders.c: Generate Perfect Hash Table for Known HTTP Headers */
+
+#include "server.h"
+
+#include <string.h>
+
+/**
+ * Search for a hash seed that maps every known header name to its own slot,
+ * and print the seed and slot table as C source for request.c.
+ **/
+int main(int argc, char *argv[]) {
+    static const char *names[] = {
+#define HEADER_STRING(name, string) string,
+        HTTP_HEADERS(HEADER_STRING)
+#undef HEADER_STRING
+    };
+    int slots[1 << HEADER_HASH_BITS];
+
+    for (uint32_t seed = 2166136261u; seed != 2166136260u; seed++) {
+        bool perfect = true;
+
+        memset(slots, -1, sizeof(slots));
+
+        for (int i = 0; perfect && i < HEADER_COUNT; i++) {
+            uint32_t hash = seed;
+
+            for (const char *c = names[i]; *c; c++) {
+                hash = header_hash_step(hash, *c);
+            }
+
+            if (slots[header_hash_slot(hash)] >= 0) {
+                perfect = false;
+            } else {
+                slots[header_hash_slot(hash)] = i;
+            }
+        }
+
+        if (!perfect) {
+            continue;
+        }
+
+        printf("/* Generated by src/genheaders.c: do not edit */\n\n");
+        printf("#define HEADER_HASH_SEED 0x%08xu\n\n", seed);
+        printf("static const uint8_t HeaderSlots[%d] = {\n", 1 << HEADER_HASH_BITS);
+        for (int i = 0; i < 1 << HEADER_HASH_BITS; i++) {
+            if (slots[i] < 0) {
+                printf("    HEADER_UNKNOWN,\n");
+            } else {
+                printf("    %d,%*s/* %s */\n", slots[i], slots[i] < 10 ? 14 : 13, "", names[slots[i]]);
+            }
+        }
+        printf("};\n");
+        return EXIT_SUCCESS;
+    }
+
+    fprintf(stderr, "No perfect hash seed for %d headers in %d slots\n", HEADER_COUNT, 1 << HEADER_HASH_BITS);
+    return EXIT_FAILURE;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -2,19 +2,77 @@
 
 #include "server.h"
 
+#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdint.h>
 #include <string.h>
+#include <strings.h>
 
-#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+/* Constants */
+#define CGI_MAX_VARIABLES   32
+#define CGI_ARENA_SIZE      8192
+#define CGI_SCRIPT_FD       3                   /* Descriptor of script in child */
+#define CGI_SCRIPT_PATH     "/proc/self/fd/3"   /* Path of script in child */
+#define RANGE_MAX_RANGES    16
+
+/* CGI Environment (variables are carved out of the arena) */
+typedef struct {
+    char   *envp[CGI_MAX_VARIABLES];    /*< NULL terminated NAME=VALUE strings */
+    size_t  envc;                       /*< Number of variables */
+    char    arena[CGI_ARENA_SIZE];      /*< Storage for variables */
+    size_t  used;                       /*< Bytes of arena used */
+} CgiEnvironment;
+
+/* Byte Range (inclusive) */
+typedef struct {
+    off_t   first;                      /*< Offset of first byte */
+    off_t   last;                       /*< Offset of last byte */
+} ByteRange;
+
 /* Internal Declarations */
+Status dispatch_request(Request *request, Handler *handler);
+Status finish_request(Request *request, Handler handler, Status result);
 Status handle_browse_request(Request *request);
 Status handle_file_request(Request *request);
+Status handle_range_request(Request *request, const ByteRange *ranges, size_t nranges);
+bool   handle_encoded_request(Request *request, unsigned accepted, Status *status);
 Status handle_cgi_request(Request *request);
+Status handle_worker_request(Request *request, char **envp, const struct timespec *deadline);
+Status handle_status_request(Request *request);
 Status handle_error(Request *request, Status status);
+Status handle_not_modified(Request *request, off_t length, const char *validators);
+bool   request_not_modified(const Request *r, const char *etag, time_t modified);
+bool   request_range_current(const Request *r, const FileEntry *f);
+bool   etag_matches(const char *list, const char *etag, bool weak);
+int    file_headers(const FileEntry *f, char *buffer, size_t size);
+bool   write_headers(Request *r, const char *status, const char *mimetype, off_t length, const char *extra);
+void   write_response(Request *r, const char *status, const char *mimetype, const char *body, size_t length, const char *extra);
+void   write_status(Response *p, const char *status, const char *mimetype, off_t length, bool chunked);
+void   write_cached_response(Request *r, const CachedResponse *c);
+void   write_body(Request *r, bool chunked, const char *data, size_t length);
+void   send_file_body(Request *r, int fd, off_t offset, off_t end);
+ssize_t parse_ranges(const char *value, off_t size, ByteRange *ranges, size_t max);
+void   add_cgi_variable(CgiEnvironment *env, const char *name, const char *value);
+ssize_t read_cgi_output(int fd, char *buffer, size_t size, off_t *remaining, const struct timespec *deadline);
+bool   splice_cgi_body(Request *r, int fd, bool chunked, const struct timespec *deadline);
+void   reap_cgi(pid_t pid, const struct timespec *deadline);
+int    poll_cgi(int fd, const struct timespec *deadline);
+int    cgi_timeout(const struct timespec *deadline);
+Status relay_cgi_response(Request *r, int fd, off_t *remaining, const struct timespec *deadline);
 
 /**
  * Handle HTTP Request.
@@ -22,91 +80,224 @@ Status handle_error(Request *request, Status status);
  * @param   r           HTTP Request structure
  * @return  Status of the HTTP request.
  *
+ * This dispatches the request (see dispatch_request), then records it in the
+ * access log and the metrics.  Sampled requests are traced phase by phase
+ * (see trace_begin).
+ *
+ * If dispatch_request left the handler for a helper thread (r->deferred), the
+ * request is recorded by resume_request instead.
+ **/
+Status  handle_request(Request *r) {
+    Handler handler = HANDLER_ERROR;
+    Status  result;
+
+    clock_gettime(CLOCK_MONOTONIC, &r->started);
+    trace_begin(r);
+
+    result = dispatch_request(r, &handler);
+
+    /* Traces are kept per thread, so deferred requests are not traced further */
+    if (r->deferred) {
+        TraceActive = false;
+        return result;
+    }
+
+    return finish_request(r, handler, result);
+}
+
+/**
+ * Resume deferred request on a helper thread.
+ *
+ * @param   r           HTTP Request structure (with r->deferred set).
+ * @return  Status of the HTTP request.
+ *
+ * This runs the CGI handler that dispatch_request left for a helper thread
+ * (see offload_request) and then records the request.  The response goes to
+ * the same in-memory stream as any other response of the server loop, which
+ * sends it once the request is handed back.
+ **/
+Status  resume_request(Request *r) {
+    r->deferred = false;
+    return finish_request(r, HANDLER_CGI, handle_cgi_request(r));
+}
+
+/**
+ * Record handled request in the access log and the metrics.
+ *
+ * @param   r           HTTP Request structure
+ * @param   handler     Handler that served the request.
+ * @param   result      Status of the HTTP request.
+ * @return  Status of the HTTP request.
+ **/
+Status  finish_request(Request *r, Handler handler, Status result) {
+    uint64_t traced = trace_start();
+
+    log("HTTP REQUEST STATUS: %s", http_status_string(result));
+    log_access(r, result);
+    metrics_request(result, handler, r->content_length, &r->started);
+    trace_end(TRACE_LOG, traced);
+
+    trace_finish(r, result);
+    return result;
+}
+
+/**
+ * Dispatch HTTP Request to its handler.
+ *
+ * @param   r           HTTP Request structure
+ * @param   handler     Pointer to store Handler that served the request in.
+ * @return  Status of the HTTP request.
+ *
  * This parses a request, determines the request path, determines the request
- * type, and then dispatches to the appropriate handler type.
+ * type, and then dispatches to the appropriate handler type.  Server loops
+ * (r->defer_body) must not block on CGI scripts, so their CGI requests are
+ * only marked r->deferred, for the loop to hand to a helper thread.
  *
  * On error, handle_error should be used with an appropriate HTTP status code.
  **/
-Status  handle_request(Request *r) {
-    Status result;
+Status  dispatch_request(Request *r, Handler *handler) {
+    uint64_t traced = trace_start();
+    int      parsed = parse_request(r);
+    Status   result;
+
+    trace_end(TRACE_PARSE, traced);
 
     /* Parse request */
-    if (parse_request(r) != 0) {
-        result = handle_error(r, HTTP_STATUS_BAD_REQUEST);
-        return result;
+    if (parsed != 0) {
+        return handle_error(r, HTTP_STATUS_BAD_REQUEST);
+    }
+
+    /* Serve metrics */
+    if (*StatusPath && streq(r->uri, StatusPath)) {
+        *handler = HANDLER_STATUS;
+        return handle_status_request(r);
     }
 
     /* Determine request path */
+    traced  = trace_start();
     r->path = determine_request_path(r->uri);
+    trace_end(TRACE_PATH, traced);
     debug("HTTP REQUEST PATH: %s", r->path);
 
     /* Dispatch to appropriate request handler type based on file type */
-    struct stat s;
-
-    if (stat(r->path, &s) == 0) {
-        if (S_ISDIR(s.st_mode)) {
-            result = handle_browse_request(r);
-        } else if (access(r->path, X_OK) == 0) {
-            result = handle_cgi_request(r);
-        } else if (S_ISREG(s.st_mode)) {
-            result = handle_file_request(r);
-        } else {
-            result = handle_error(r, HTTP_STATUS_BAD_REQUEST);
-        }
+    traced  = trace_start();
+    r->file = r->path ? filecache_lookup(r->path) : NULL;
+    trace_end(TRACE_LOOKUP, traced);
+
+    traced = trace_start();
+    if (r->file && r->file->exists && S_ISDIR(r->file->mode)) {
+        *handler = HANDLER_BROWSE;
+        result   = handle_browse_request(r);
+    } else if (r->file && r->file->exists && r->file->executable && r->defer_body) {
+        *handler    = HANDLER_CGI;
+        r->deferred = true;
+        result      = HTTP_STATUS_OK;
+    } else if (r->file && r->file->exists && r->file->executable) {
+        *handler = HANDLER_CGI;
+        result   = handle_cgi_request(r);
+    } else if (r->file && r->file->exists && S_ISREG(r->file->mode)) {
+        *handler = HANDLER_FILE;
+        result   = handle_file_request(r);
+    } else if (r->file && r->file->exists) {
+        result   = handle_error(r, HTTP_STATUS_BAD_REQUEST);
     } else if (streq(r->uri, "/favicon.ico")) {
-        result = HTTP_STATUS_OK;
+        *handler = HANDLER_FILE;
+        write_response(r, http_status_string(HTTP_STATUS_OK), NULL, NULL, 0, NULL);
+        result   = HTTP_STATUS_OK;
     } else {
-        result = handle_error(r, HTTP_STATUS_NOT_FOUND);
+        result   = handle_error(r, HTTP_STATUS_NOT_FOUND);
     }
-
-    log("HTTP REQUEST STATUS: %s", http_status_string(result));
+    trace_end(TRACE_HANDLER, traced);
 
     return result;
 }
 
+/**
+ * Handle all HTTP Requests on a client connection.
+ *
+ * @param   r           HTTP Request structure
+ * @return  Number of requests handled.
+ *
+ * This is used by the blocking server modes.  After each response is flushed,
+ * the request is reset and, if the connection persists, the next (possibly
+ * pipelined) request is handled once it arrives.  Reads on the socket time out
+ * after KeepAliveTimeout seconds so an idle or stalled client cannot hold the
+ * connection forever.
+ **/
+size_t  handle_connection(Request *r) {
+    struct timeval timeout = { .tv_sec = KeepAliveTimeout };
+    size_t handled = 0;
+
+    if (KeepAliveTimeout > 0) {
+        setsockopt(r->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    metrics_connection(1);
+
+    do {
+        handle_request(r);
+        fflush(r->stream);
+        handled++;
+
+        if (!r->keep_alive) {
+            break;
+        }
+
+        reset_request(r);
+    } while (wait_request(r, KeepAliveTimeout * 1000));
+
+    metrics_connection(-1);
+    return handled;
+}
+
 /**
  * Handle browse request.
  *
  * @param   r           HTTP Request structure.
  * @return  Status of the HTTP browse request.
  *
- * This lists the contents of a directory in HTML.
+ * This lists the contents of a directory in HTML, gzipped if the client
+ * accepts it.  Rendered listings are cached until the directory changes (see
+ * dircache_lookup), so repeated requests neither read nor sort the directory,
+ * and are sent with their headers in a single write (see write_response).
+ * The listing is tagged with a hash of its contents, so clients revalidating
+ * an unchanged listing get HTTP_STATUS_NOT_MODIFIED instead.
  *
- * If the path cannot be opened or scanned as a directory, then handle error
- * with HTTP_STATUS_NOT_FOUND.
+ * If the path cannot be opened or read as a directory, then handle error with
+ * HTTP_STATUS_NOT_FOUND.
  **/
 Status  handle_browse_request(Request *r) {
     log("Handling browse request");
 
-    struct dirent **entries;
-    int n;
+    DirListing *l;
+    const char *body;
+    size_t      length;
+    char        etag[32];
+    char        extra[BUFSIZ];
+    bool        gzipped;
 
-    /* Open a directory for reading or scanning */
-    n = scandir(r->path, &entries, 0, alphasort);
-
-    /* Check for failure */
-    if (n < 0) {
+    /* Look up (or render) listing of directory */
+    if (!(l = dircache_lookup(r->file, r->uri))) {
         return handle_error(r, HTTP_STATUS_NOT_FOUND);
     }
 
-    /* Write HTTP Header with OK Status and text/html Content-Type */
-    fprintf(r->stream, "HTTP/1.0 200 OK\r\n");
-    fprintf(r->stream, "Content-Type: text/html\r\n");
-    fprintf(r->stream, "\r\n");
+    /* Send gzipped listing if client accepts gzip */
+    gzipped = l->gzip && (encoding_accepted(request_header(r, HEADER_ACCEPT_ENCODING)) & ENCODING_GZIP);
+    body    = gzipped ? l->gzip : l->body;
+    length  = gzipped ? l->gzip_length : l->length;
 
-    /* For each entry in directory, emit HTML list item */
-    fprintf(r->stream, "<ul>\n");
-    for (int i = 0; i < n; i++) {
-        if (!streq(entries[i]->d_name, ".")) {
-            fprintf(r->stream, "<li><a href=\"%s%s%s\">%s</a></li>\n", r->uri, \
-                    r->uri[strlen(r->uri)-1] != '/' ? "/" : "", entries[i]->d_name, entries[i]->d_name);
-        }
+    snprintf(etag,  sizeof(etag),  "\"%016" PRIx64 "%s\"", l->checksum, gzipped ? "-gzip" : "");
+    snprintf(extra, sizeof(extra), "%sVary: Accept-Encoding\r\nETag: %s\r\n",
+             gzipped ? "Content-Encoding: gzip\r\n" : "", etag);
 
-        free(entries[i]);
+    if (request_not_modified(r, etag, -1)) {
+        dircache_release(l);
+        return handle_not_modified(r, length, extra);
     }
-    fprintf(r->stream, "</ul>\n");
 
-    free(entries);
+    /* Write HTTP Header with OK Status and text/html Content-Type, then listing */
+    write_response(r, http_status_string(HTTP_STATUS_OK), "text/html", body, length, extra);
+    dircache_release(l);
 
     /* Return OK */
     return HTTP_STATUS_OK;
@@ -118,54 +309,284 @@ Status  handle_browse_request(Request *r) {
  * @param   r           HTTP Request structure.
  * @return  Status of the HTTP file request.
  *
- * This opens and streams the contents of the specified file to the socket.
+ * Small files are served from the response cache, which holds their headers
+ * and body in memory.  Otherwise, this sends the contents of the file opened
+ * by the file cache to the socket with sendfile(2) (see send_file_body).
+ * Every response carries the file's ETag and Last-Modified validators, and
+ * clients whose cached copy is still current get HTTP_STATUS_NOT_MODIFIED
+ * without a body.
  *
- * If the path cannot be opened for reading, then handle error with
+ * Text-like files are sent encoded when the client accepts it (see
+ * handle_encoded_request).  Requests with a satisfiable Range header are
+ * answered with only the requested bytes by handle_range_request, and those
+ * without any satisfiable range get HTTP_STATUS_RANGE_NOT_SATISFIABLE.  A
+ * Range header that is invalid or whose If-Range no longer matches the file
+ * is ignored and the whole file is sent.
+ *
+ * If the path could not be opened for reading, then handle error with
  * HTTP_STATUS_NOT_FOUND.
  **/
 Status  handle_file_request(Request *r) {
     log("Handling file request");
 
-    FILE *fs;
-    char buffer[BUFSIZ];
-    char *mimetype = NULL;
-    size_t nread;
+    FileEntry      *f = r->file;
+    CachedResponse *c;
+    ByteRange       ranges[RANGE_MAX_RANGES];
+    ssize_t         nranges = -1;
+    char            extra[BUFSIZ];
+    Status          status;
 
-    /* Open file for reading */
-    fs = fopen(r->path, "r");
+    /* Check for cached descriptor */
+    if (f->fd < 0) {
+        return handle_error(r, HTTP_STATUS_NOT_FOUND);
+    }
 
-    /* Check for failure */
-    if (!fs) {
-        goto fail;
+    /* Send text-like files encoded if possible (byte ranges always refer to the unencoded file) */
+    if (encoding_compressible(f->mimetype) && !request_header(r, HEADER_RANGE) &&
+        handle_encoded_request(r, encoding_accepted(request_header(r, HEADER_ACCEPT_ENCODING)), &status)) {
+        return status;
     }
 
-    /* Determine mimetype */
-    mimetype = determine_mimetype(r->path);
+    /* Check client's cached copy */
+    file_headers(f, extra, sizeof(extra));
 
-    /* Write HTTP Headers with OK status and determined Content-Type */
-    fprintf(r->stream, "HTTP/1.0 200 OK\r\n");
-    fprintf(r->stream, "Content-Type: %s\r\n", mimetype);
-    fprintf(r->stream, "\r\n");
+    if (request_not_modified(r, f->etag, f->mtime.tv_sec)) {
+        return handle_not_modified(r, f->size, extra);
+    }
 
-    /* Read from file and write to socket in chunks */
-    nread = fread(buffer, sizeof(char), BUFSIZ, fs);
+    /* Serve byte ranges of current file */
+    if (request_range_current(r, f)) {
+        nranges = parse_ranges(request_header(r, HEADER_RANGE), f->size, ranges, RANGE_MAX_RANGES);
+    }
 
-    while (nread > 0) {
-        fwrite(buffer, sizeof(char), nread, r->stream);
-        nread = fread(buffer, sizeof(char), BUFSIZ, fs);
+    if (nranges > 0) {
+        return handle_range_request(r, ranges, nranges);
     }
 
-    /* Close file, deallocate mimetype, return OK */
-    fclose(fs);
-    free(mimetype);
+    if (nranges == 0) {
+        snprintf(extra, sizeof(extra), "Content-Range: bytes */%jd\r\n", (intmax_t)f->size);
+        write_response(r, http_status_string(HTTP_STATUS_RANGE_NOT_SATISFIABLE), NULL, NULL, 0, extra);
+        return HTTP_STATUS_RANGE_NOT_SATISFIABLE;
+    }
 
+    /* Serve small files from memory, caching them on a miss */
+    c = respcache_lookup(f);
+
+    if (!c && ResponseCacheBudget > 0 && (size_t)f->size <= ResponseCacheMaxObject) {
+        Response p;
+
+        write_status(&p, http_status_string(HTTP_STATUS_OK), f->mimetype, f->size, false);
+        response_lines(&p, extra);
+        c = respcache_insert(f, p.data, p.length);
+    }
+
+    if (c) {
+        write_cached_response(r, c);
+        respcache_release(c);
+        return HTTP_STATUS_OK;
+    }
+
+    /* Write HTTP Headers with OK status, determined Content-Type, and size, then body */
+    write_headers(r, http_status_string(HTTP_STATUS_OK), f->mimetype, f->size, extra);
+    send_file_body(r, f->fd, 0, f->size);
     return HTTP_STATUS_OK;
+}
+
+/**
+ * Handle byte range request.
+ *
+ * @param   r           HTTP Request structure.
+ * @param   ranges      Satisfiable byte ranges (sorted and coalesced).
+ * @param   nranges     Number of byte ranges.
+ * @return  Status of the HTTP range request.
+ *
+ * A single range is sent with a Content-Range header straight from the file
+ * at its offset (see send_file_body).  Multiple ranges are sent as a
+ * multipart/byteranges body whose parts are sliced out of a read-only mmap of
+ * the file, so only the pages covering the requested bytes are ever read.  On
+ * blocking connections the response headers, part headers, and slices leave
+ * in a single writev; otherwise they are copied to the stream for the server
+ * loop to send.
+ *
+ * If the file cannot be mapped, then handle error with
+ * HTTP_STATUS_INTERNAL_SERVER_ERROR.
+ **/
+Status  handle_range_request(Request *r, const ByteRange *ranges, size_t nranges) {
+    log("Handling range request");
+
+    FileEntry   *f = r->file;
+    char         extra[BUFSIZ];
+    char         mimetype[BUFSIZ];
+    char         boundary[17];
+    char        *parts      = NULL;
+    size_t       parts_size = 0;
+    size_t       offsets[RANGE_MAX_RANGES + 1];
+    struct iovec iov[2 * RANGE_MAX_RANGES + 2];
+    Response     p;
+    off_t        length;
+    FILE        *stream;
+    char        *map;
+
+    /* Single range: Content-Range header and body at offset */
+    if (nranges == 1) {
+        int n = snprintf(extra, sizeof(extra), "Content-Range: bytes %jd-%jd/%jd\r\n",
+                         (intmax_t)ranges[0].first, (intmax_t)ranges[0].last, (intmax_t)f->size);
+        file_headers(f, extra + n, sizeof(extra) - n);
+        write_headers(r, http_status_string(HTTP_STATUS_PARTIAL_CONTENT), f->mimetype,
+                      ranges[0].last - ranges[0].first + 1, extra);
+        send_file_body(r, f->fd, ranges[0].first, ranges[0].last + 1);
+        return HTTP_STATUS_PARTIAL_CONTENT;
+    }
+
+    /* Multiple ranges: render part headers, then map file */
+    snprintf(boundary, sizeof(boundary), "%08lx%08lx", random(), random());
+
+    if (!(stream = open_memstream(&parts, &parts_size))) {
+        return handle_error(r, HTTP_STATUS_INTERNAL_SERVER_ERROR);
+    }
+
+    length = 0;
+    for (size_t i = 0; i < nranges; i++) {
+        offsets[i] = ftell(stream);
+        fprintf(stream, "\r\n--%s\r\n", boundary);
+        if (f->mimetype) {
+            fprintf(stream, "Content-Type: %s\r\n", f->mimetype);
+        }
+        fprintf(stream, "Content-Range: bytes %jd-%jd/%jd\r\n\r\n",
+                (intmax_t)ranges[i].first, (intmax_t)ranges[i].last, (intmax_t)f->size);
+        length += ranges[i].last - ranges[i].first + 1;
+    }
+    offsets[nranges] = ftell(stream);
+    fprintf(stream, "\r\n--%s--\r\n", boundary);
+    fclose(stream);
+
+    map = mmap(NULL, f->size, PROT_READ, MAP_SHARED, f->fd, 0);
+    if (map == MAP_FAILED) {
+        debug("Unable to mmap: %s", strerror(errno));
+        free(parts);
+        return handle_error(r, HTTP_STATUS_INTERNAL_SERVER_ERROR);
+    }
+
+    /* Interleave part headers with slices of the mapping (after response headers) */
+    for (size_t i = 0; i < nranges; i++) {
+        iov[2 * i + 1].iov_base = parts + offsets[i];
+        iov[2 * i + 1].iov_len  = offsets[i + 1] - offsets[i];
+        iov[2 * i + 2].iov_base = map + ranges[i].first;
+        iov[2 * i + 2].iov_len  = ranges[i].last - ranges[i].first + 1;
+    }
+    iov[2 * nranges + 1].iov_base = parts + offsets[nranges];
+    iov[2 * nranges + 1].iov_len  = parts_size - offsets[nranges];
+
+    /* Build HTTP Headers with Partial Content status, then send them with parts */
+    snprintf(mimetype, sizeof(mimetype), "multipart/byteranges; boundary=%s", boundary);
+    file_headers(f, extra, sizeof(extra));
+    write_status(&p, http_status_string(HTTP_STATUS_PARTIAL_CONTENT), mimetype, length + parts_size, false);
+    response_lines(&p, extra);
+    r->content_length = length + parts_size;
+    response_finish(&p, r->keep_alive);
+
+    iov[0].iov_base = p.data;
+    iov[0].iov_len  = p.length;
 
-fail:
-    /* Close file, free mimetype, return INTERNAL_SERVER_ERROR */
-    fclose(fs);
-    free(mimetype);
-    return HTTP_STATUS_INTERNAL_SERVER_ERROR;
+    if (r->defer_body) {
+        for (size_t i = 0; i < 2 * nranges + 2; i++) {
+            fwrite(iov[i].iov_base, 1, iov[i].iov_len, r->stream);
+        }
+    } else {
+        fflush(r->stream);
+        if (socket_writev(r->fd, iov, 2 * nranges + 2) < 0) {
+            debug("Unable to writev: %s", strerror(errno));
+            r->keep_alive = false;
+        }
+    }
+
+    munmap(map, f->size);
+    free(parts);
+    return HTTP_STATUS_PARTIAL_CONTENT;
+}
+
+/**
+ * Handle file request with a content encoding.
+ *
+ * @param   r           HTTP Request structure.
+ * @param   accepted    Bitmask of encodings accepted by client.
+ * @param   status      Pointer to store status of the HTTP request in.
+ * @return  Whether or not an encoded response was sent.
+ *
+ * A precompressed sibling (ie. index.html.br or index.html.gz) that is at
+ * least as new as the file is preferred, brotli first.  It replaces the file
+ * in r->file, so its descriptor stays open until the body has been sent.
+ * Otherwise, the file is gzipped once through the compressed response cache.
+ * Each encoded variant has its own ETag, so it is revalidated separately from
+ * the unencoded file.
+ *
+ * If no encoding is possible, nothing is sent and the file should be sent
+ * unencoded.
+ **/
+bool    handle_encoded_request(Request *r, unsigned accepted, Status *status) {
+    static const Encoding   Precompressed[] = {ENCODING_BROTLI, ENCODING_GZIP};
+    static const char      *Extensions[]    = {".br", ".gz"};
+
+    FileEntry          *f = r->file;
+    CompressedResponse *c;
+    char                path[PATH_MAX];
+    char                etag[sizeof(f->etag) + 8];
+    char                extra[BUFSIZ];
+
+    /* Send precompressed sibling */
+    for (size_t i = 0; i < sizeof(Precompressed) / sizeof(Precompressed[0]); i++) {
+        FileEntry *v;
+
+        if (!(accepted & Precompressed[i]) ||
+            snprintf(path, sizeof(path), "%s%s", f->path, Extensions[i]) >= (int)sizeof(path) ||
+            !(v = filecache_lookup(path))) {
+            continue;
+        }
+
+        if (!v->exists || v->fd < 0 || v->mtime.tv_sec < f->mtime.tv_sec ||
+            (v->mtime.tv_sec == f->mtime.tv_sec && v->mtime.tv_nsec < f->mtime.tv_nsec)) {
+            filecache_release(v);
+            continue;
+        }
+
+        log("Handling %s encoded file request", encoding_name(Precompressed[i]));
+
+        r->file = v;
+        snprintf(extra, sizeof(extra), "Content-Encoding: %s\r\nVary: Accept-Encoding\r\nETag: %s\r\nLast-Modified: %s\r\n",
+                 encoding_name(Precompressed[i]), v->etag, v->modified);
+
+        if (request_not_modified(r, v->etag, v->mtime.tv_sec)) {
+            *status = handle_not_modified(r, v->size, extra);
+        } else {
+            write_headers(r, http_status_string(HTTP_STATUS_OK), f->mimetype, v->size, extra);
+            send_file_body(r, v->fd, 0, v->size);
+            *status = HTTP_STATUS_OK;
+        }
+
+        filecache_release(f);
+        return true;
+    }
+
+    /* Send cached gzip of file */
+    if (!(accepted & ENCODING_GZIP) || !(c = compcache_lookup(f, ENCODING_GZIP))) {
+        return false;
+    }
+
+    log("Handling gzip encoded file request");
+
+    snprintf(etag,  sizeof(etag),  "%.*s-gzip\"", (int)strlen(f->etag) - 1, f->etag);
+    snprintf(extra, sizeof(extra), "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\nETag: %s\r\nLast-Modified: %s\r\n",
+             etag, f->modified);
+
+    if (request_not_modified(r, etag, f->mtime.tv_sec)) {
+        *status = handle_not_modified(r, c->length, extra);
+    } else {
+        write_response(r, http_status_string(HTTP_STATUS_OK), f->mimetype, c->data, c->length, extra);
+        *status = HTTP_STATUS_OK;
+    }
+
+    compcache_release(c);
+    return true;
 }
 
 /**
@@ -174,58 +595,192 @@ fail:
  * @param   r           HTTP Request structure.
  * @return  Status of the HTTP file request.
  *
- * This popens and streams the results of the specified executables to the
- * socket.
+ * This spawns the specified executable directly with posix_spawn(3) (no
+ * shell, and no copy of the server's address space) and relays its standard
+ * output to the socket.  The CGI environment is built per request in an
+ * arena on the stack, and the server's own environment is never modified, so
+ * variables cannot leak between requests or between threads.  Scripts served
+ * by persistent workers are handed the same environment by
+ * handle_worker_request instead.
+ *
+ * The script is opened beneath the root (see open_request_path) and executed
+ * through that descriptor, so a symlink swapped in after the request path was
+ * resolved cannot make it run anything outside the root.
+ *
+ * Scripts run in their own process group and are killed along with any
+ * children they started once they exceed CGITimeout seconds.
  *
- * If the path cannot be popened, then handle error with
+ * If the executable cannot be started, then handle error with
  * HTTP_STATUS_INTERNAL_SERVER_ERROR.
  **/
 Status  handle_cgi_request(Request *r) {
     log("Handling CGI request");
 
-    FILE *pfs;
-    char buffer[BUFSIZ];
+    CgiEnvironment             env = { .envc = 0, .used = 0 };
+    struct timespec            started;
+    struct timespec            deadline;
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t          attributes;
+    sigset_t                   defaults;
+    char                      *argv[]   = {r->path, NULL};
+    char                      *shargv[] = {"/bin/sh", CGI_SCRIPT_PATH, NULL};
+    int                        pfd[2];
+    int                        script;
+    int                        error;
+    pid_t                      pid;
+    Status                     status;
 
-    /* Export CGI environment variables from request:
+    /* Build CGI environment variables from request:
      * http://en.wikipedia.org/wiki/Common_Gateway_Interface */
-    setenv("DOCUMENT_ROOT", RootPath, 1);
-    setenv("SERVER_PORT",   Port,     1);
-    if (r->query)  setenv("QUERY_STRING",    r->query,  1);
-    if (r->host)   setenv("REMOTE_ADDR",     r->host,   1);
-    if (r->port)   setenv("REMOTE_PORT",     r->port,   1);
-    if (r->method) setenv("REQUEST_METHOD",  r->method, 1);
-    if (r->uri)    setenv("REQUEST_URI",     r->uri,    1);
-    if (r->path)   setenv("SCRIPT_FILENAME", r->path,   1);
-
-    /* Export CGI environment variables from request headers */
-    for (Header *header = r->headers; header; header = header->next) {
-        if      (streq(header->name, "Host"           )) setenv("HTTP_HOST",            header->data, 1);
-        else if (streq(header->name, "Accept"         )) setenv("HTTP_ACCEPT",          header->data, 1);
-        else if (streq(header->name, "Accept-Language")) setenv("HTTP_ACCEPT_LANGUAGE", header->data, 1);
-        else if (streq(header->name, "Accept-Encoding")) setenv("HTTP_ACCEPT_ENCODING", header->data, 1);
-        else if (streq(header->name, "Connection"     )) setenv("HTTP_CONNECTION",      header->data, 1);
-        else if (streq(header->name, "User-Agent"     )) setenv("HTTP_USER_AGENT",      header->data, 1);
-    }
-
-    /* POpen CGI Script */
-    pfs = popen(r->path, "r");
-
-    /* Check for failure */
-    if (!pfs) {
+    add_cgi_variable(&env, "PATH",            getenv("PATH"));
+    add_cgi_variable(&env, "DOCUMENT_ROOT",   RootPath);
+    add_cgi_variable(&env, "SERVER_PORT",     Port);
+    add_cgi_variable(&env, "QUERY_STRING",    r->query);
+    add_cgi_variable(&env, "REMOTE_ADDR",     request_host(r));
+    add_cgi_variable(&env, "REMOTE_PORT",     request_port(r));
+    add_cgi_variable(&env, "REQUEST_METHOD",  r->method);
+    add_cgi_variable(&env, "REQUEST_URI",     r->uri);
+    add_cgi_variable(&env, "SCRIPT_FILENAME", r->path);
+
+    /* Build CGI environment variables from request headers */
+    add_cgi_variable(&env, "HTTP_HOST",            request_header(r, HEADER_HOST));
+    add_cgi_variable(&env, "HTTP_ACCEPT",          request_header(r, HEADER_ACCEPT));
+    add_cgi_variable(&env, "HTTP_ACCEPT_LANGUAGE", request_header(r, HEADER_ACCEPT_LANGUAGE));
+    add_cgi_variable(&env, "HTTP_ACCEPT_ENCODING", request_header(r, HEADER_ACCEPT_ENCODING));
+    add_cgi_variable(&env, "HTTP_CONNECTION",      request_header(r, HEADER_CONNECTION));
+    add_cgi_variable(&env, "HTTP_USER_AGENT",      request_header(r, HEADER_USER_AGENT));
+
+    /* Start execution clock */
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    deadline         = started;
+    deadline.tv_sec += CGITimeout;
+
+    /* Hand scripts with persistent workers to their pool */
+    if (scriptpool_handles(r->path)) {
+        status = handle_worker_request(r, env.envp, &deadline);
+        metrics_cgi(&started);
+        return status;
+    }
+
+    /* Open script beneath root */
+    if ((script = open_request_path(r->path, O_PATH)) < 0) {
+        debug("Unable to open %s: %s", r->path, strerror(errno));
+        return handle_error(r, HTTP_STATUS_NOT_FOUND);
+    }
+
+    /* Create pipe for CGI output */
+    if (pipe2(pfd, O_CLOEXEC) < 0) {
+        debug("Unable to pipe: %s", strerror(errno));
+        close(script);
         return handle_error(r, HTTP_STATUS_INTERNAL_SERVER_ERROR);
     }
 
-    /* Copy data from popen to socket */
-    size_t nread = fread(buffer, sizeof(char), BUFSIZ, pfs);
+    /* Spawn CGI script through its descriptor with output on pipe, default SIGPIPE, and its own process group */
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, pfd[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, script, CGI_SCRIPT_FD);
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setsigdefault(&attributes, &defaults);
+    posix_spawnattr_setpgroup(&attributes, 0);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+
+    error = posix_spawn(&pid, CGI_SCRIPT_PATH, &actions, &attributes, argv, env.envp);
+
+    /* Executables without an interpreter line are shell scripts */
+    if (error == ENOEXEC) {
+        error = posix_spawn(&pid, shargv[0], &actions, &attributes, shargv, env.envp);
+    }
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    close(pfd[1]);
+    close(script);
 
-    while (nread > 0) {
-        fwrite(buffer, sizeof(char), nread, r->stream);
-        nread = fread(buffer, sizeof(char), BUFSIZ, pfs);
+    if (error) {
+        debug("Unable to spawn %s: %s", r->path, strerror(error));
+        close(pfd[0]);
+        return handle_error(r, HTTP_STATUS_INTERNAL_SERVER_ERROR);
     }
 
-    /* Close popen, return OK */
-    pclose(pfs);
+    /* Relay CGI response from pipe to socket, then close pipe and reap script */
+    status = relay_cgi_response(r, pfd[0], NULL, &deadline);
+
+    close(pfd[0]);
+    reap_cgi(pid, &deadline);
+    metrics_cgi(&started);
+    return status;
+}
+
+/**
+ * Handle CGI request with a persistent script worker.
+ *
+ * @param   r           HTTP Request structure.
+ * @param   envp        CGI environment (NULL terminated).
+ * @param   deadline    Time at which the script is abandoned.
+ * @return  Status of the HTTP CGI request.
+ *
+ * This sends the environment to an idle worker from the script's pool and
+ * relays the framed output it sends back, so the script's interpreter is
+ * only started once per worker rather than once per request.  Workers whose
+ * output is not relayed completely (including those that exceed the
+ * deadline) are retired rather than reused.
+ *
+ * If too many requests are already waiting for a worker, then handle error
+ * with HTTP_STATUS_SERVICE_UNAVAILABLE.  If no worker can be started or it
+ * fails, then handle error with HTTP_STATUS_INTERNAL_SERVER_ERROR.
+ **/
+Status  handle_worker_request(Request *r, char **envp, const struct timespec *deadline) {
+    log("Handling script worker request");
+
+    ScriptWorker *w = scriptpool_acquire(r->path);
+    ssize_t       length;
+    off_t         remaining;
+    Status        status;
+
+    if (!w) {
+        return handle_error(r, errno == EAGAIN ? HTTP_STATUS_SERVICE_UNAVAILABLE : HTTP_STATUS_INTERNAL_SERVER_ERROR);
+    }
+
+    if ((length = scriptpool_request(w, envp, cgi_timeout(deadline))) < 0) {
+        scriptpool_release(w, false);
+        return handle_error(r, errno == ETIMEDOUT ? HTTP_STATUS_GATEWAY_TIMEOUT : HTTP_STATUS_INTERNAL_SERVER_ERROR);
+    }
+
+    remaining = length;
+    status    = relay_cgi_response(r, w->fd, &remaining, deadline);
+    scriptpool_release(w, remaining == 0);
+    return status;
+}
+
+/**
+ * Handle metrics request.
+ *
+ * @param   r           HTTP Request structure.
+ * @return  Status of the HTTP metrics request.
+ *
+ * Metrics of every worker (see metrics_render) are rendered in Prometheus
+ * text format, or as JSON if the query string asks for format=json.
+ *
+ * If the metrics cannot be rendered, then handle error with
+ * HTTP_STATUS_INTERNAL_SERVER_ERROR.
+ **/
+Status  handle_status_request(Request *r) {
+    log("Handling status request");
+
+    bool        json = r->query && strstr(r->query, "format=json");
+    size_t      length;
+    char       *body = metrics_render(json, &length);
+    const char *mimetype = json ? "application/json" : "text/plain; version=0.0.4";
+
+    if (!body) {
+        return handle_error(r, HTTP_STATUS_INTERNAL_SERVER_ERROR);
+    }
 
+    write_response(r, http_status_string(HTTP_STATUS_OK), mimetype, body, length, "Cache-Control: no-store\r\n");
+    free(body);
     return HTTP_STATUS_OK;
 }
 
@@ -242,17 +797,774 @@ Status  handle_error(Request *r, Status status) {
     log("Handling error");
 
     const char *status_string = http_status_string(status);
+    char        body[BUFSIZ];
+    int         length = snprintf(body, sizeof(body), "<h1>%s</h1>", status_string);
 
-    /* Write HTTP Header */
-    fprintf(r->stream, "%s\r\n", status_string);
-
-    /* Write HTML Description of Error*/
-    fprintf(r->stream, "Content-Type: text/html\r\n");
-    fprintf(r->stream, "\r\n");
-    fprintf(r->stream, "<h1>%s</h1>", status_string);
+    /* Write HTTP Header and HTML Description of Error */
+    write_response(r, status_string, "text/html", body, length, NULL);
 
     /* Return specified status */
     return status;
 }
 
+/**
+ * Handle request whose cached copy is still current.
+ *
+ * @param   r           HTTP Request structure.
+ * @param   length      Content-Length the full response would have had.
+ * @param   validators  CRLF terminated ETag and Last-Modified header lines.
+ * @return  HTTP_STATUS_NOT_MODIFIED.
+ *
+ * The response never has a body, so its Content-Length describes the
+ * representation the client already has and the connection can persist.
+ **/
+Status  handle_not_modified(Request *r, off_t length, const char *validators) {
+    log("Handling not modified");
+
+    Response p;
+
+    write_status(&p, http_status_string(HTTP_STATUS_NOT_MODIFIED), NULL, length, false);
+    response_lines(&p, validators);
+    response_finish(&p, r->keep_alive);
+    response_send(r, &p, NULL, 0);
+    return HTTP_STATUS_NOT_MODIFIED;
+}
+
+/**
+ * Relay CGI script output as an HTTP response.
+ *
+ * @param   r           HTTP Request structure.
+ * @param   fd          Read end of pipe connected to script's standard output.
+ * @param   remaining   Pointer to number of bytes of output left to relay,
+ *                      updated as it is read (or NULL to relay until EOF).
+ * @param   deadline    Time at which the script is abandoned.
+ * @return  Status of the HTTP CGI request.
+ *
+ * Scripts may either begin with a full status line (HTTP/1.0 200 OK) or with
+ * CGI headers and an optional Status header.  The header block is rewritten
+ * with our own status line, framing, and Connection headers, and the rest of
+ * the output is then streamed as the body (chunked on persistent connections,
+ * since its length is not known in advance).  On blocking connections, the
+ * body is spliced straight from a pipe into the socket without passing
+ * through user space (see splice_cgi_body).  The socket is corked for the
+ * whole response, so the last chunk is not held back by Nagle's algorithm
+ * waiting on the client's delayed ACK.
+ *
+ * If the script does not produce a complete header block, then handle error
+ * with HTTP_STATUS_INTERNAL_SERVER_ERROR (or HTTP_STATUS_GATEWAY_TIMEOUT if it
+ * ran out of time).  If it runs out of time while sending the body, the body
+ * is cut short and the connection is closed.
+ **/
+Status  relay_cgi_response(Request *r, int fd, off_t *remaining, const struct timespec *deadline) {
+    char    buffer[BUFSIZ];
+    char    extra[BUFSIZ];
+    char   *status = "200 OK";
+    char   *end    = NULL;
+    size_t  length = 0;
+    size_t  used   = 0;
+    ssize_t nread;
+
+    /* Read until end of header block */
+    while (length < sizeof(buffer) - 1 && !end) {
+        nread = read_cgi_output(fd, buffer + length, sizeof(buffer) - 1 - length, remaining, deadline);
+        if (nread < 0 && errno == EINTR) {
+            continue;
+        }
+        if (nread <= 0) {
+            break;
+        }
+
+        length += nread;
+        buffer[length] = '\0';
+
+        /* Header block ends at whichever blank line comes first */
+        char *crlf = strstr(buffer, "\r\n\r\n");
+        char *lf   = strstr(buffer, "\n\n");
+
+        if (lf && (!crlf || lf < crlf)) {
+            *lf = '\0';
+            end = lf + 2;
+        } else if (crlf) {
+            *crlf = '\0';
+            end   = crlf + 4;
+        }
+    }
+
+    if (!end) {
+        debug("CGI script did not produce a complete header block");
+        return handle_error(r, nread < 0 && errno == ETIMEDOUT ? HTTP_STATUS_GATEWAY_TIMEOUT
+                                                              : HTTP_STATUS_INTERNAL_SERVER_ERROR);
+    }
+
+    /* Parse status line and headers, dropping those we generate ourselves */
+    extra[0] = '\0';
+
+    char *state;
+    for (char *line = strtok_r(buffer, "\r\n", &state); line; line = strtok_r(NULL, "\r\n", &state)) {
+        if (line == buffer && strncmp(line, "HTTP/", 5) == 0) {
+            char *code = strchr(line, ' ');
+
+            /* Bare status line (ie. HTTP/1.0) keeps the default status */
+            if (code && *(code = skip_whitespace(code))) {
+                status = code;
+            }
+        } else if (strncasecmp(line, "Status:", 7) == 0) {
+            status = skip_whitespace(line + 7);
+        } else if (strncasecmp(line, "Content-Length:",    15) != 0 &&
+                   strncasecmp(line, "Transfer-Encoding:", 18) != 0 &&
+                   strncasecmp(line, "Connection:",        11) != 0 &&
+                   strncasecmp(line, "Date:",               5) != 0 &&
+                   strncasecmp(line, "Server:",             7) != 0) {
+            int n = snprintf(extra + used, sizeof(extra) - used, "%s\r\n", line);
+            if (n > 0 && (size_t)n < sizeof(extra) - used) {
+                used += n;
+            }
+        }
+    }
+
+    /* Cork socket so the headers, body, and last chunk leave in full segments */
+    if (!r->defer_body) {
+        socket_cork(r->fd, true);
+    }
+
+    /* Write HTTP Headers with script's status, then body */
+    bool chunked  = write_headers(r, status, NULL, -1, extra);
+    bool complete = true;
+
+    write_body(r, chunked, end, buffer + length - end);
+
+    if (!remaining && !r->defer_body) {
+        complete = splice_cgi_body(r, fd, chunked, deadline);
+    } else {
+        while ((nread = read_cgi_output(fd, buffer, sizeof(buffer), remaining, deadline)) > 0 ||
+               (nread < 0 && errno == EINTR)) {
+            if (nread > 0) {
+                write_body(r, chunked, buffer, nread);
+            }
+        }
+
+        if (nread < 0) {
+            debug("Unable to read CGI output: %s", strerror(errno));
+            complete = false;
+        }
+    }
+
+    if (complete) {
+        write_body(r, chunked, NULL, 0);
+    } else {
+        r->keep_alive = false;
+    }
+
+    /* Flush last chunk and uncork */
+    if (!r->defer_body) {
+        fflush(r->stream);
+        socket_cork(r->fd, false);
+    }
+
+    return HTTP_STATUS_OK;
+}
+
+/**
+ * Write HTTP status line and headers.
+ *
+ * @param   r           HTTP Request structure.
+ * @param   status      HTTP status string (ie. "200 OK").
+ * @param   mimetype    Content-Type of body (or NULL to omit).
+ * @param   length      Content-Length of body (or -1 if unknown).
+ * @param   extra       Additional CRLF terminated header lines (or NULL).
+ * @return  Whether or not the body must be sent with chunked encoding.
+ *
+ * The headers are assembled by the response builder and copied to the stream
+ * in one piece, ahead of a body that is streamed or sent from a file.
+ *
+ * Bodies of unknown length are chunked on persistent HTTP/1.1 connections.
+ * Otherwise, the connection is marked to close after the response, since the
+ * end of the body can only be signaled by closing it.
+ **/
+bool    write_headers(Request *r, const char *status, const char *mimetype, off_t length, const char *extra) {
+    bool     chunked = length < 0 && r->keep_alive && r->http11;
+    Response p;
+
+    if (length < 0 && !chunked) {
+        r->keep_alive = false;
+    }
+
+    write_status(&p, status, mimetype, length, chunked);
+    response_lines(&p, extra);
+    response_finish(&p, r->keep_alive);
+    fwrite(p.data, sizeof(char), p.length, r->stream);
+    r->content_length = length > 0 ? length : 0;
+
+    return chunked;
+}
+
+/**
+ * Write complete HTTP response with body in memory.
+ *
+ * @param   r           HTTP Request structure.
+ * @param   status      HTTP status string (ie. "200 OK").
+ * @param   mimetype    Content-Type of body (or NULL to omit).
+ * @param   body        Body of response (or NULL).
+ * @param   length      Length of body.
+ * @param   extra       Additional CRLF terminated header lines (or NULL).
+ *
+ * On blocking connections, the headers and body leave in a single writev (see
+ * response_send).
+ **/
+void    write_response(Request *r, const char *status, const char *mimetype, const char *body, size_t length, const char *extra) {
+    Response p;
+
+    write_status(&p, status, mimetype, length, false);
+    response_lines(&p, extra);
+    response_finish(&p, r->keep_alive);
+    response_send(r, &p, body, length);
+    r->content_length = body ? length : 0;
+}
+
+/**
+ * Begin response with HTTP status line and entity headers.
+ *
+ * @param   p           Response to begin.
+ * @param   status      HTTP status string (ie. "200 OK").
+ * @param   mimetype    Content-Type of body (or NULL to omit).
+ * @param   length      Content-Length of body (or -1 if unknown).
+ * @param   chunked     Whether or not the body is sent with chunked encoding.
+ *
+ * This is shared by the writers above and the response cache, which stores
+ * these lines pre-serialized and appends the general headers per request.
+ **/
+void    write_status(Response *p, const char *status, const char *mimetype, off_t length, bool chunked) {
+    response_status(p, status);
+    if (mimetype) {
+        response_header(p, "Content-Type", mimetype);
+    }
+    if (length >= 0) {
+        response_length(p, length);
+    } else if (chunked) {
+        response_header(p, "Transfer-Encoding", "chunked");
+    }
+}
+
+/**
+ * Write cached response.
+ *
+ * @param   r           HTTP Request structure.
+ * @param   c           Cached response.
+ *
+ * On blocking connections, the cached headers, general headers, and body leave
+ * in a single writev.  Otherwise, they are copied to the stream for the server
+ * loop to send.
+ **/
+void    write_cached_response(Request *r, const CachedResponse *c) {
+    Response     general;
+    struct iovec iov[3];
+
+    general.length = 0;
+    response_finish(&general, r->keep_alive);
+
+    iov[0] = (struct iovec){ c->data,                    c->header_length };
+    iov[1] = (struct iovec){ general.data,               general.length };
+    iov[2] = (struct iovec){ c->data + c->header_length, c->size };
+
+    r->content_length = c->size;
+
+    if (r->defer_body) {
+        for (size_t i = 0; i < sizeof(iov) / sizeof(iov[0]); i++) {
+            fwrite(iov[i].iov_base, 1, iov[i].iov_len, r->stream);
+        }
+        return;
+    }
+
+    fflush(r->stream);
+    if (socket_writev(r->fd, iov, sizeof(iov) / sizeof(iov[0])) < 0) {
+        debug("Unable to writev: %s", strerror(errno));
+        r->keep_alive = false;
+    }
+}
+
+/**
+ * Write part of HTTP response body.
+ *
+ * @param   r           HTTP Request structure.
+ * @param   chunked     Whether or not to use chunked encoding.
+ * @param   data        Body data (NULL marks the end of the body).
+ * @param   length      Length of body data.
+ **/
+void    write_body(Request *r, bool chunked, const char *data, size_t length) {
+    if (data) {
+        r->content_length += length;
+    }
+
+    if (data && !chunked) {
+        fwrite(data, sizeof(char), length, r->stream);
+    } else if (data && length > 0) {
+        fprintf(r->stream, "%zx\r\n", length);
+        fwrite(data, sizeof(char), length, r->stream);
+        fprintf(r->stream, "\r\n");
+    } else if (!data && chunked) {
+        fprintf(r->stream, "0\r\n\r\n");
+    }
+}
+
+/**
+ * Send window of file as HTTP response body.
+ *
+ * @param   r           HTTP Request structure.
+ * @param   fd          File descriptor to send from.
+ * @param   offset      Offset of first byte to send.
+ * @param   end         Offset just past last byte to send.
+ *
+ * The socket is corked so the headers already written to the stream and the
+ * start of the body leave in the same segments, and the body is then copied
+ * from the page cache with sendfile(2).  If the server loop set
+ * r->defer_body, then the window is left in r->body_fd, r->body_offset, and
+ * r->body_length for the server loop to send instead.
+ **/
+void    send_file_body(Request *r, int fd, off_t offset, off_t end) {
+    uint64_t traced;
+
+    /* Leave body for server loop */
+    if (r->defer_body) {
+        r->body_fd     = fd;
+        r->body_offset = offset;
+        r->body_length = end;
+        return;
+    }
+
+    /* Send headers and body together: cork socket, flush headers, send body */
+    traced = trace_start();
+    socket_cork(r->fd, true);
+    fflush(r->stream);
+
+    while (offset < end) {
+        if (socket_sendfile(r->fd, fd, &offset, end - offset) <= 0) {
+            debug("Unable to send file: %s", strerror(errno));
+            r->keep_alive = false;
+            break;
+        }
+    }
+
+    socket_cork(r->fd, false);
+    trace_end(TRACE_SEND, traced);
+}
+
+/**
+ * Parse Range header.
+ *
+ * @param   value       Value of Range header (or NULL).
+ * @param   size        Size of file.
+ * @param   ranges      Array to store satisfiable byte ranges in.
+ * @param   max         Maximum number of byte ranges.
+ * @return  Number of satisfiable byte ranges, 0 if none are satisfiable, or -1
+ *          if the header is missing or should be ignored.
+ *
+ * Only byte ranges are understood:
+ *
+ *  bytes=<FIRST>-<LAST>, <FIRST>-, -<SUFFIX LENGTH>
+ *
+ * Last offsets past the end of the file are clamped to it.  The ranges are
+ * sorted and overlapping or adjacent ones are coalesced, so a client cannot
+ * request the same bytes many times over.  Headers that are invalid or that
+ * contain more than max satisfiable ranges are ignored.
+ **/
+ssize_t parse_ranges(const char *value, off_t size, ByteRange *ranges, size_t max) {
+    const char *s = value;
+    char       *end;
+    size_t      n = 0;
+    size_t      m = 0;
+
+    if (!s || strncasecmp(s, "bytes=", 6) != 0 || s[6] == '\0') {
+        return -1;
+    }
+
+    for (s += 6; *s; s++) {
+        ByteRange range;
+
+        while (*s == ' ' || *s == '\t') s++;
+
+        if (*s == '-' && isdigit(s[1])) {       /* Suffix length */
+            intmax_t suffix = strtoimax(s + 1, &end, 10);
+
+            range.first = suffix < size ? size - suffix : 0;
+            range.last  = size - 1;
+        } else if (isdigit(*s)) {               /* First offset */
+            range.first = strtoimax(s, &end, 10);
+            if (*end != '-') {
+                return -1;
+            }
+
+            if (isdigit(end[1])) {              /* Last offset */
+                range.last = strtoimax(end + 1, &end, 10);
+                if (range.last < range.first) {
+                    return -1;
+                }
+            } else {
+                range.last = size - 1;
+                end++;
+            }
+
+            range.last = range.last < size ? range.last : size - 1;
+        } else {
+            return -1;
+        }
+
+        for (s = end; *s == ' ' || *s == '\t'; s++);
+
+        if (*s != ',' && *s != '\0') {
+            return -1;
+        }
+
+        /* Insert satisfiable range in order */
+        if (range.first <= range.last) {
+            size_t i;
+
+            if (n == max) {
+                return -1;
+            }
+
+            for (i = n++; i > 0 && ranges[i - 1].first > range.first; i--) {
+                ranges[i] = ranges[i - 1];
+            }
+            ranges[i] = range;
+        }
+
+        if (*s == '\0') {
+            break;
+        }
+    }
+
+    if (n == 0) {
+        return 0;
+    }
+
+    /* Coalesce overlapping and adjacent ranges */
+    for (size_t i = 1; i < n; i++) {
+        if (ranges[i].first <= ranges[m].last + 1) {
+            ranges[m].last = ranges[i].last > ranges[m].last ? ranges[i].last : ranges[m].last;
+        } else {
+            ranges[++m] = ranges[i];
+        }
+    }
+
+    return m + 1;
+}
+
+/**
+ * Determine whether client's cached copy is still current.
+ *
+ * @param   r           HTTP Request structure.
+ * @param   etag        Strong entity tag of current representation.
+ * @param   modified    Last modification time of representation (or -1 if unknown).
+ * @return  Whether or not HTTP_STATUS_NOT_MODIFIED should be sent.
+ *
+ * If-None-Match uses weak comparison and takes precedence, so If-Modified-Since
+ * is only checked when the former is missing.
+ **/
+bool    request_not_modified(const Request *r, const char *etag, time_t modified) {
+    const char *value;
+    time_t      since;
+
+    if ((value = request_header(r, HEADER_IF_NONE_MATCH))) {
+        return etag_matches(value, etag, true);
+    }
+
+    if (modified >= 0 && (value = request_header(r, HEADER_IF_MODIFIED_SINCE))) {
+        since = parse_http_date(value);
+        return since >= 0 && modified <= since;
+    }
+
+    return false;
+}
+
+/**
+ * Determine whether a Range request applies to the current file.
+ *
+ * @param   r           HTTP Request structure.
+ * @param   f           Cached file metadata.
+ * @return  Whether or not the Range header should be honored.
+ *
+ * Without If-Range, the Range header always applies.  Otherwise, it only
+ * applies if the If-Range entity tag strongly matches or its date is exactly
+ * the file's modification time.
+ **/
+bool    request_range_current(const Request *r, const FileEntry *f) {
+    const char *value = request_header(r, HEADER_IF_RANGE);
+
+    if (!value) {
+        return true;
+    }
+
+    if (*value == '"' || strncmp(value, "W/", 2) == 0) {
+        return etag_matches(value, f->etag, false);
+    }
+
+    return parse_http_date(value) == f->mtime.tv_sec;
+}
+
+/**
+ * Match entity tag against list of entity tags.
+ *
+ * @param   list        Comma separated entity tags (or "*").
+ * @param   etag        Strong entity tag (with quotes).
+ * @param   weak        Whether to use weak comparison (ignore W/ prefix).
+ * @return  Whether or not any entity tag in list matches.
+ **/
+bool    etag_matches(const char *list, const char *etag, bool weak) {
+    size_t length = strlen(etag);
+
+    if (streq(list, "*")) {
+        return true;
+    }
+
+    while (*list) {
+        bool        prefixed = false;
+        const char *end;
+
+        while (*list == ' ' || *list == '\t' || *list == ',') list++;
+
+        if (strncmp(list, "W/", 2) == 0) {
+            prefixed = true;
+            list    += 2;
+        }
+
+        if (*list != '"' || !(end = strchr(list + 1, '"'))) {
+            return false;
+        }
+
+        end++;
+        if ((weak || !prefixed) && (size_t)(end - list) == length && strncmp(list, etag, length) == 0) {
+            return true;
+        }
+
+        list = end;
+    }
+
+    return false;
+}
+
+/**
+ * Format headers of unencoded file.
+ *
+ * @param   f           Cached file metadata.
+ * @param   buffer      Buffer to store CRLF terminated header lines in.
+ * @param   size        Size of buffer.
+ * @return  Length of header lines.
+ *
+ * Besides the ETag and Last-Modified validators, this advertises byte ranges
+ * and, for files that may also be sent encoded, that the response varies with
+ * Accept-Encoding.
+ **/
+int     file_headers(const FileEntry *f, char *buffer, size_t size) {
+    return snprintf(buffer, size, "Accept-Ranges: bytes\r\n%sETag: %s\r\nLast-Modified: %s\r\n",
+                    encoding_compressible(f->mimetype) ? "Vary: Accept-Encoding\r\n" : "", f->etag, f->modified);
+}
+
+/**
+ * Append CGI environment variable.
+ *
+ * @param   env         CGI environment.
+ * @param   name        Name of variable.
+ * @param   value       Value of variable (skipped if NULL or empty).
+ *
+ * Each variable is formatted as "NAME=VALUE" into the environment's arena, so
+ * nothing needs to be free'd.  Variables that do not fit are skipped.
+ **/
+void    add_cgi_variable(CgiEnvironment *env, const char *name, const char *value) {
+    char *variable = env->arena + env->used;
+    int   length;
+
+    if (!value || !*value || env->envc + 1 >= CGI_MAX_VARIABLES) {
+        return;
+    }
+
+    length = snprintf(variable, sizeof(env->arena) - env->used, "%s=%s", name, value);
+    if (length < 0 || (size_t)length >= sizeof(env->arena) - env->used) {
+        debug("CGI environment is full, skipping %s", name);
+        return;
+    }
+
+    env->used              += length + 1;
+    env->envp[env->envc++]  = variable;
+    env->envp[env->envc]    = NULL;
+}
+
+/**
+ * Read CGI output.
+ *
+ * @param   fd          File descriptor of script's output.
+ * @param   buffer      Buffer to read into.
+ * @param   size        Size of buffer.
+ * @param   remaining   Pointer to number of bytes of output left (or NULL if
+ *                      output ends at EOF).
+ * @param   deadline    Time at which the script is abandoned.
+ * @return  Number of bytes read (0 at end of output, -1 on error with errno
+ * set to ETIMEDOUT once the deadline has passed).
+ **/
+ssize_t read_cgi_output(int fd, char *buffer, size_t size, off_t *remaining, const struct timespec *deadline) {
+    ssize_t nread;
+    int     events;
+
+    if (remaining && (off_t)size > *remaining) {
+        size = *remaining;
+    }
+
+    if (size == 0) {
+        return 0;
+    }
+
+    /* Wait first, so read never blocks past the deadline */
+    if ((events = poll_cgi(fd, deadline)) == 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    if (events < 0) {
+        return -1;
+    }
+
+    while ((nread = read(fd, buffer, size)) < 0 && errno == EINTR);
+
+    if (nread > 0 && remaining) {
+        *remaining -= nread;
+    }
+
+    return nread;
+}
+
+/**
+ * Splice CGI body from pipe to socket.
+ *
+ * @param   r           HTTP Request structure.
+ * @param   fd          Read end of pipe connected to script's standard output.
+ * @param   chunked     Whether or not to use chunked encoding.
+ * @param   deadline    Time at which the script is abandoned.
+ * @return  Whether or not the whole body was sent.
+ *
+ * Whatever is in the pipe is moved into the socket with splice(2), framed as
+ * one chunk on chunked responses.  The headers (and any body bytes read with
+ * them) are flushed from the stream first.
+ **/
+bool    splice_cgi_body(Request *r, int fd, bool chunked, const struct timespec *deadline) {
+    if (fflush(r->stream) != 0) {
+        return false;
+    }
+
+    while (true) {
+        int  available = 0;
+        int  events    = poll_cgi(fd, deadline);
+        char header[32];
+
+        if (events == 0) {
+            debug("CGI script %s timed out", r->path);
+            return false;
+        }
+
+        if (events < 0 || !(events & (POLLIN | POLLHUP))) {
+            debug("Unable to poll CGI script %s: %s", r->path, events < 0 ? strerror(errno) : "error on pipe");
+            return false;
+        }
+
+        if (ioctl(fd, FIONREAD, &available) < 0) {
+            debug("Unable to ioctl: %s", strerror(errno));
+            return false;
+        }
+
+        /* Readable with nothing buffered means end of output */
+        if (available == 0) {
+            return true;
+        }
+
+        if (chunked) {
+            int length = snprintf(header, sizeof(header), "%x\r\n", available);
+
+            if (send(r->fd, header, length, MSG_NOSIGNAL | MSG_MORE) != length) {
+                return false;
+            }
+        }
+
+        while (available > 0) {
+            ssize_t nspliced = splice(fd, NULL, r->fd, NULL, available, SPLICE_F_MOVE | SPLICE_F_MORE);
+
+            if (nspliced < 0 && errno == EINTR) {
+                continue;
+            }
+
+            if (nspliced <= 0) {
+                debug("Unable to splice: %s", strerror(errno));
+                return false;
+            }
+
+            available         -= nspliced;
+            r->content_length += nspliced;
+        }
+
+        if (chunked && send(r->fd, "\r\n", 2, MSG_NOSIGNAL | MSG_MORE) != 2) {
+            return false;
+        }
+    }
+}
+
+/**
+ * Reap CGI script, killing it once it runs out of time.
+ *
+ * @param   pid         Process id of script (and of its process group).
+ * @param   deadline    Time at which the script is abandoned.
+ *
+ * The script may keep running after closing its output, so its exit is
+ * awaited on a pidfd.  If pidfds are not supported, this simply waits.
+ **/
+void    reap_cgi(pid_t pid, const struct timespec *deadline) {
+    int pidfd = syscall(SYS_pidfd_open, pid, 0);
+
+    if (pidfd >= 0 && poll_cgi(pidfd, deadline) == 0) {
+        debug("Killing CGI script %d after %d seconds", pid, CGITimeout);
+        kill(-pid, SIGKILL);
+    }
+
+    if (pidfd >= 0) {
+        close(pidfd);
+    }
+
+    while (waitpid(pid, NULL, 0) < 0 && errno == EINTR);
+}
+
+/**
+ * Wait for CGI script's output (or exit) until deadline.
+ *
+ * @param   fd          File descriptor of script's output (or pidfd).
+ * @param   deadline    Time at which the script is abandoned.
+ * @return  Events returned by poll (0 once the deadline has passed, -1 on
+ * error).
+ *
+ * Waits interrupted by signals (ie. SIGHUP reloading mime-types) are resumed
+ * with whatever time is left until the deadline.
+ **/
+int     poll_cgi(int fd, const struct timespec *deadline) {
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    int           ready;
+
+    while ((ready = poll(&pfd, 1, cgi_timeout(deadline))) < 0 && errno == EINTR);
+
+    return ready > 0 ? pfd.revents : ready;
+}
+
+/**
+ * Determine milliseconds left until deadline.
+ *
+ * @param   deadline    Time at which the script is abandoned.
+ * @return  Milliseconds left (0 if passed, -1 if CGITimeout is disabled).
+ **/
+int     cgi_timeout(const struct timespec *deadline) {
+    struct timespec now;
+    long long       left;
+
+    if (CGITimeout <= 0) {
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    left = (deadline->tv_sec - now.tv_sec) * 1000LL + (deadline->tv_nsec - now.tv_nsec) / 1000000;
+    return left > 0 ? left : 0;
+}
+
 /* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,70 @@
+/* Generated by src/genheaders.c: do not edit */
+
+#define HEADER_HASH_SEED 0x811c9dceu
+
+static const uint8_t HeaderSlots[64] = {
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    2,              /* Accept-Language */
+    HEADER_UNKNOWN,
+    12,             /* If-Modified-Since */
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    8,              /* Cookie */
+    14,             /* If-Range */
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    7,              /* Content-Type */
+    9,              /* Expect */
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    19,             /* TE */
+    18,             /* Referer */
+    4,              /* Cache-Control */
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    3,              /* Authorization */
+    16,             /* Origin */
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    5,              /* Connection */
+    21,             /* Upgrade */
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    6,              /* Content-Length */
+    20,             /* Transfer-Encoding */
+    HEADER_UNKNOWN,
+    22,             /* User-Agent */
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    1,              /* Accept-Encoding */
+    11,             /* If-Match */
+    HEADER_UNKNOWN,
+    0,              /* Accept */
+    13,             /* If-None-Match */
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    15,             /* If-Unmodified-Since */
+    HEADER_UNKNOWN,
+    10,             /* Host */
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    HEADER_UNKNOWN,
+    17,             /* Range */
+};
@@ -0,0 +1,799 @@
+/* log.c: Asynchronous Logging */
+
+#include "server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Constants */
+
+#define LOG_RING_SLOTS          4096    /* Power of two */
+#define LOG_RECORD_ARGS         464     /* Bytes of packed arguments per record */
+#define LOG_FLUSH_INTERVAL      100     /* Milliseconds between flushes */
+#define LOG_BUFFER_SIZE         (64 << 10)
+#define LOG_LINE_MAX            4096    /* Longest rendered line */
+
+/* Record (arguments are packed in binary and only formatted by the flusher) */
+
+typedef struct {
+    uint64_t    time;                   /*< Nanoseconds since the epoch */
+    const char *format;                 /*< Format string (its address is the format id) */
+    const char *file;                   /*< Source file of log call */
+    uint16_t    line;                   /*< Source line of log call */
+    uint8_t     level;                  /*< LogLevel of record */
+    bool        complete;               /*< Whether every argument fit */
+    uint16_t    nconversions;           /*< Number of conversions packed */
+    uint16_t    length;                 /*< Bytes of args used */
+    char        args[LOG_RECORD_ARGS];  /*< Packed arguments */
+} LogRecord;
+
+/* Ring (written only by its thread, read only by the flusher) */
+
+typedef struct log_ring LogRing;
+struct log_ring {
+    LogRecord   records[LOG_RING_SLOTS];
+    uint32_t    head __attribute__((aligned(64)));  /*< Records written */
+    uint32_t    tail __attribute__((aligned(64)));  /*< Records flushed */
+    uint64_t    dropped;                /*< Records dropped because ring was full */
+    uint64_t    reported;               /*< Drops already reported by flusher */
+    LogRing    *next;                   /*< Next ring */
+};
+
+/* Conversion Specification */
+
+typedef struct {
+    char        text[32];               /*< Specification for snprintf (integers widened to ll) */
+    char        kind;                   /*< i(signed), u(nsigned), f(loat), s(tring), c(har), p(ointer) */
+    char        modifier;               /*< Length modifier (H for hh, L for ll, 0 for none) */
+} LogSpec;
+
+/* Output Buffer */
+
+typedef struct {
+    int         fd;                     /*< Destination */
+    char        data[LOG_BUFFER_SIZE];
+    size_t      length;
+} LogBuffer;
+
+/* Logger (one per process) */
+
+static struct {
+    pthread_mutex_t lock;               /*< Serializes flushes and protects everything below */
+    LogRing        *rings;              /*< Rings of threads in this process */
+    bool            initialized;        /*< Whether fork and exit handlers are registered */
+    bool            running;            /*< Whether the flusher runs in this process */
+    bool            synchronous;        /*< Whether records are flushed as they are logged */
+    int             wake;               /*< Eventfd that wakes the flusher early */
+    pid_t           pid;                /*< Process id of this process */
+    int             access_fd;          /*< Access log (-1 if disabled) */
+    LogBuffer       errors;             /*< Pending debug and log lines */
+    LogBuffer       access;             /*< Pending access log lines */
+    LogBuffer       trace;              /*< Pending trace events */
+    time_t          clock_now;          /*< Second clock was rendered for */
+    char            clock[16];          /*< Wall clock time (HH:MM:SS) */
+} Log = {
+    .lock      = PTHREAD_MUTEX_INITIALIZER,
+    .wake      = -1,
+    .access_fd = -1,
+    .errors    = { .fd = STDERR_FILENO },
+    .access    = { .fd = -1 },
+    .trace     = { .fd = -1 },
+};
+
+static __thread LogRing *LogLocal;      /*< Ring of calling thread */
+
+/* Common Log Format Date (rendered at most once a second per thread) */
+
+static __thread struct {
+    time_t  now;
+    char    date[32];
+} LogDate;
+
+static const char *LogLevelNames[] = {"FATAL", "LOG", "DEBUG", "ACCESS", "TRACE"};
+
+/* Internal Declarations */
+LogRing *   log_attach(void);
+void *      log_flusher(void *arg);
+const char *log_spec(const char *f, LogSpec *spec);
+void        log_pack(LogRecord *record, const char *format, va_list ap);
+size_t      log_render(LogRecord *record, char *buffer, size_t size);
+size_t      log_format(const LogRecord *record, char *buffer, size_t size);
+size_t      log_escape(const char *s, size_t length, char *buffer, size_t size, bool json);
+void        log_write(LogBuffer *b);
+void        log_prepare(void);
+void        log_parent(void);
+void        log_child(void);
+
+/**
+ * Open access log or trace file.
+ *
+ * @param   level       LOG_LEVEL_ACCESS or LOG_LEVEL_TRACE.
+ * @param   path        Path of file ("-" for standard output).
+ * @return  Whether or not the file was opened.
+ *
+ * Lines are appended, so several processes can share the file.  A trace file
+ * is a single JSON array of trace events, which is never closed (as the
+ * Chrome trace event format allows), so only a new trace file gets the
+ * opening bracket.
+ **/
+bool log_open(LogLevel level, const char *path) {
+    LogBuffer  *b  = level == LOG_LEVEL_TRACE ? &Log.trace : &Log.access;
+    int         fd = streq(path, "-") ? STDOUT_FILENO : open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    struct stat s;
+
+    if (fd < 0) {
+        return false;
+    }
+
+    pthread_mutex_lock(&Log.lock);
+    b->fd = fd;
+    if (level == LOG_LEVEL_TRACE && fstat(fd, &s) == 0 && s.st_size == 0) {
+        b->length = snprintf(b->data, sizeof(b->data), "[\n");
+        log_write(b);
+    }
+    if (level == LOG_LEVEL_ACCESS) {
+        Log.access_fd = fd;
+    }
+    pthread_mutex_unlock(&Log.lock);
+    return true;
+}
+
+/**
+ * Record log message.
+ *
+ * @param   level       LogLevel of message.
+ * @param   file        Source file of log call.
+ * @param   line        Source line of log call.
+ * @param   format      Format string (must be a string literal).
+ *
+ * The message is not formatted here.  Its timestamp, level, format string,
+ * and arguments are packed into the next slot of the calling thread's ring,
+ * and the flusher formats and writes it shortly after.  Since each ring has
+ * exactly one writer and one reader, this takes no locks and makes no system
+ * calls (except to wake the flusher once a ring is half full).  If the ring is
+ * full, the message is dropped and counted instead of waiting for room.
+ *
+ * Strings are copied, so arguments may be freed as soon as this returns.
+ * Strings that do not fit in the record are cut short.
+ **/
+void log_record(LogLevel level, const char *file, int line, const char *format, ...) {
+    int             saved = errno;
+    LogRing        *ring  = LogLocal;
+    LogRecord      *record;
+    uint32_t        head, tail;
+    struct timespec now;
+    va_list         ap;
+
+    if (!ring || !__atomic_load_n(&Log.running, __ATOMIC_RELAXED)) {
+        if (!(ring = log_attach())) {
+            errno = saved;
+            return;
+        }
+    }
+
+    head = ring->head;
+    tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail >= LOG_RING_SLOTS) {
+        __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+        errno = saved;
+        return;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    record         = &ring->records[head & (LOG_RING_SLOTS - 1)];
+    record->time   = (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+    record->format = format;
+    record->file   = file;
+    record->line   = line;
+    record->level  = level;
+
+    va_start(ap, format);
+    log_pack(record, format, ap);
+    va_end(ap);
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    if (Log.synchronous) {
+        log_flush();
+    } else if (head + 1 - tail == LOG_RING_SLOTS / 2) {
+        eventfd_write(Log.wake, 1);
+    }
+
+    errno = saved;
+}
+
+/**
+ * Record access log line for request.
+ *
+ * @param   r           HTTP Request structure.
+ * @param   status      Status of the HTTP request.
+ *
+ * Lines are in Common Log Format, followed by the Referer and User-Agent
+ * headers if AccessLogCombined is set (Combined Log Format).  The size is the
+ * length of the response body, or "-" if it was empty.
+ **/
+void log_access(Request *r, Status status) {
+    const char *status_string = http_status_string(status);
+    const char *referer;
+    const char *agent;
+    const char *query = r->query && *r->query ? r->query : NULL;
+    char        bytes[24] = "-";
+    time_t      now;
+
+    if (Log.access_fd < 0) {
+        return;
+    }
+
+    if ((now = time(NULL)) != LogDate.now) {
+        struct tm tm;
+
+        strftime(LogDate.date, sizeof(LogDate.date), "%d/%b/%Y:%H:%M:%S %z", localtime_r(&now, &tm));
+        LogDate.now = now;
+    }
+
+    if (r->content_length > 0) {
+        snprintf(bytes, sizeof(bytes), "%jd", (intmax_t)r->content_length);
+    }
+
+    if (!r->method || !r->uri) {
+        log_record(LOG_LEVEL_ACCESS, __FILE__, __LINE__, "%s - - [%s] \"-\" %.3s %s%s",
+                   request_host(r), LogDate.date, status_string, bytes, AccessLogCombined ? " \"-\" \"-\"" : "");
+        return;
+    }
+
+    if (!AccessLogCombined) {
+        log_record(LOG_LEVEL_ACCESS, __FILE__, __LINE__, "%s - - [%s] \"%s %s%s%s HTTP/1.%d\" %.3s %s",
+                   request_host(r), LogDate.date, r->method, r->uri, query ? "?" : "", query ? query : "",
+                   r->http11, status_string, bytes);
+        return;
+    }
+
+    referer = request_header(r, HEADER_REFERER);
+    agent   = request_header(r, HEADER_USER_AGENT);
+
+    log_record(LOG_LEVEL_ACCESS, __FILE__, __LINE__, "%s - - [%s] \"%s %s%s%s HTTP/1.%d\" %.3s %s \"%s\" \"%s\"",
+               request_host(r), LogDate.date, r->method, r->uri, query ? "?" : "", query ? query : "",
+               r->http11, status_string, bytes, referer ? referer : "-", agent ? agent : "-");
+}
+
+/**
+ * Format and write every record logged so far.
+ *
+ * The flusher calls this periodically (and early once a ring is half full),
+ * and it runs once more at exit.  Lines are batched per destination, so each
+ * flush costs a write per LOG_BUFFER_SIZE bytes rather than one per line.
+ * Drops since the previous flush are reported as a LOG line.
+ **/
+void log_flush(void) {
+    pthread_mutex_lock(&Log.lock);
+
+    for (LogRing *ring = Log.rings; ring; ring = ring->next) {
+        uint32_t head    = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+
+        for (uint32_t tail = ring->tail; tail != head; tail++) {
+            LogRecord *record = &ring->records[tail & (LOG_RING_SLOTS - 1)];
+            LogBuffer *b      = record->level == LOG_LEVEL_ACCESS ? &Log.access :
+                                record->level == LOG_LEVEL_TRACE  ? &Log.trace  : &Log.errors;
+
+            if (b->fd < 0) {
+                continue;
+            }
+
+            if (sizeof(b->data) - b->length < LOG_LINE_MAX) {
+                log_write(b);
+            }
+
+            b->length += log_render(record, b->data + b->length, LOG_LINE_MAX);
+        }
+
+        __atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+
+        if (dropped != ring->reported) {
+            if (sizeof(Log.errors.data) - Log.errors.length < LOG_LINE_MAX) {
+                log_write(&Log.errors);
+            }
+
+            Log.errors.length += snprintf(Log.errors.data + Log.errors.length, LOG_LINE_MAX,
+                                          "[%5d] LOG   Dropped %ju log records (ring full)\n",
+                                          Log.pid, (uintmax_t)(dropped - ring->reported));
+            ring->reported = dropped;
+        }
+    }
+
+    log_write(&Log.errors);
+    log_write(&Log.access);
+    log_write(&Log.trace);
+
+    pthread_mutex_unlock(&Log.lock);
+}
+
+/**
+ * Count records dropped because rings were full.
+ *
+ * @return  Number of records dropped by this process.
+ **/
+uint64_t log_dropped(void) {
+    uint64_t dropped = 0;
+
+    pthread_mutex_lock(&Log.lock);
+    for (LogRing *ring = Log.rings; ring; ring = ring->next) {
+        dropped += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&Log.lock);
+
+    return dropped;
+}
+
+/**
+ * Attach ring to calling thread and start flusher of this process.
+ *
+ * @return  Ring of calling thread (or NULL on allocation failure).
+ *
+ * Rings live until the process exits.  The flusher is started again in every
+ * forked child (see log_child).  If it cannot be started, records are flushed
+ * as they are logged instead.
+ **/
+LogRing * log_attach(void) {
+    pthread_mutex_lock(&Log.lock);
+
+    if (!Log.initialized) {
+        pthread_atfork(log_prepare, log_parent, log_child);
+        atexit(log_flush);
+        Log.pid         = getpid();
+        Log.initialized = true;
+    }
+
+    if (!LogLocal && (LogLocal = calloc(1, sizeof(LogRing)))) {
+        LogLocal->next = Log.rings;
+        Log.rings      = LogLocal;
+    }
+
+    if (!Log.running) {
+        pthread_t thread;
+        sigset_t  all, saved;
+
+        /* Flusher blocks all signals, so they keep going to the server threads */
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &saved);
+
+        Log.wake        = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        Log.synchronous = Log.wake < 0 || pthread_create(&thread, NULL, log_flusher, NULL) != 0;
+
+        if (!Log.synchronous) {
+            pthread_detach(thread);
+        }
+
+        pthread_sigmask(SIG_SETMASK, &saved, NULL);
+        __atomic_store_n(&Log.running, true, __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_unlock(&Log.lock);
+    return LogLocal;
+}
+
+/**
+ * Flush records until the process exits.
+ *
+ * @param   arg         Unused.
+ * @return  Nothing (never returns).
+ **/
+void * log_flusher(void *arg) {
+    struct pollfd pfd = { .fd = Log.wake, .events = POLLIN };
+
+    while (true) {
+        eventfd_t value;
+
+        if (poll(&pfd, 1, LOG_FLUSH_INTERVAL) > 0) {
+            eventfd_read(pfd.fd, &value);
+        }
+
+        log_flush();
+    }
+
+    return NULL;
+}
+
+/**
+ * Parse printf conversion specification.
+ *
+ * @param   f           Format string at '%'.
+ * @param   spec        Specification to fill in.
+ * @return  Format string just past the specification (or NULL if it is not
+ * supported, ie. '*' widths and long doubles).
+ **/
+const char * log_spec(const char *f, LogSpec *spec) {
+    const char *start = f++;
+    size_t      n;
+
+    f += strspn(f, "-+ #0");
+    f += strspn(f, "0123456789");
+    if (*f == '.') {
+        f++;
+        f += strspn(f, "0123456789");
+    }
+
+    n = f - start;
+    if (n + 4 > sizeof(spec->text)) {
+        return NULL;
+    }
+    memcpy(spec->text, start, n);
+
+    spec->modifier = 0;
+    if (f[0] == 'h' && f[1] == 'h') {
+        spec->modifier = 'H';
+        f += 2;
+    } else if (f[0] == 'l' && f[1] == 'l') {
+        spec->modifier = 'L';
+        f += 2;
+    } else if (strchr("hlzjt", *f) && *f) {
+        spec->modifier = *f++;
+    }
+
+    switch (*f) {
+        case 'd': case 'i':                     spec->kind = 'i'; break;
+        case 'u': case 'x': case 'X': case 'o': spec->kind = 'u'; break;
+        case 'f': case 'e': case 'g': case 'a':
+        case 'F': case 'E': case 'G': case 'A': spec->kind = 'f'; break;
+        case 's':                               spec->kind = 's'; break;
+        case 'c':                               spec->kind = 'c'; break;
+        case 'p':                               spec->kind = 'p'; break;
+        default:                                return NULL;
+    }
+
+    /* Integers are stored widened, so they are formatted as long long */
+    if (spec->kind == 'i' || spec->kind == 'u') {
+        spec->text[n++] = 'l';
+        spec->text[n++] = 'l';
+    }
+    spec->text[n++] = *f;
+    spec->text[n]   = '\0';
+
+    return f + 1;
+}
+
+/**
+ * Pack arguments of format into record.
+ *
+ * @param   record      Record to fill in.
+ * @param   format      Format string.
+ * @param   ap          Arguments.
+ *
+ * Integers, doubles, and pointers take 8 bytes, and strings take a 16-bit
+ * length followed by their bytes.  Packing stops at the first conversion that
+ * is not supported or that does not fit.
+ **/
+void log_pack(LogRecord *record, const char *format, va_list ap) {
+    char       *args = record->args;
+    char       *end  = record->args + sizeof(record->args);
+    const char *f    = format;
+    LogSpec     spec;
+
+    record->complete     = false;
+    record->nconversions = 0;
+
+    while ((f = strchr(f, '%'))) {
+        if (f[1] == '%') {
+            f += 2;
+            continue;
+        }
+
+        if (!(f = log_spec(f, &spec)) || end - args < 8) {
+            record->length = args - record->args;
+            return;
+        }
+
+        if (spec.kind == 'i') {
+            long long value;
+
+            switch (spec.modifier) {
+                case 'l': value = va_arg(ap, long);      break;
+                case 'L': value = va_arg(ap, long long); break;
+                case 'z': value = va_arg(ap, ssize_t);   break;
+                case 'j': value = va_arg(ap, intmax_t);  break;
+                case 't': value = va_arg(ap, ptrdiff_t); break;
+                default:  value = va_arg(ap, int);       break;
+            }
+            memcpy(args, &value, 8);
+            args += 8;
+        } else if (spec.kind == 'u') {
+            unsigned long long value;
+
+            switch (spec.modifier) {
+                case 'l': value = va_arg(ap, unsigned long);      break;
+                case 'L': value = va_arg(ap, unsigned long long); break;
+                case 'z': value = va_arg(ap, size_t);             break;
+                case 'j': value = va_arg(ap, uintmax_t);          break;
+                case 't': value = va_arg(ap, ptrdiff_t);          break;
+                default:  value = va_arg(ap, unsigned);           break;
+            }
+            memcpy(args, &value, 8);
+            args += 8;
+        } else if (spec.kind == 'f') {
+            double value = va_arg(ap, double);
+
+            memcpy(args, &value, 8);
+            args += 8;
+        } else if (spec.kind == 'c') {
+            long long value = va_arg(ap, int);
+
+            memcpy(args, &value, 8);
+            args += 8;
+        } else if (spec.kind == 'p') {
+            void *value = va_arg(ap, void *);
+
+            memcpy(args, &value, sizeof(value));
+            args += 8;
+        } else {
+            const char *value  = va_arg(ap, const char *);
+            size_t      room   = end - args - sizeof(uint16_t);
+            size_t      length = value ? strnlen(value, room) : 6;
+            uint16_t    stored = length;
+
+            memcpy(args, &stored, sizeof(stored));
+            memcpy(args + sizeof(stored), value ? value : "(null)", length);
+            args += sizeof(stored) + length;
+
+            if (length == room) {
+                record->nconversions++;
+                record->length = args - record->args;
+                return;
+            }
+        }
+
+        record->nconversions++;
+    }
+
+    record->complete = true;
+    record->length   = args - record->args;
+}
+
+/**
+ * Render record as a line.
+ *
+ * @param   record      Record.
+ * @param   buffer      Buffer to render into.
+ * @param   size        Size of buffer.
+ * @return  Length of line (including newline).
+ *
+ * Access lines and trace events are just the message.  Other lines are
+ * prefixed with the wall clock time, process id, level, and source location
+ * of the log call.
+ **/
+size_t log_render(LogRecord *record, char *buffer, size_t size) {
+    size_t n = 0;
+
+    if (record->level < LOG_LEVEL_ACCESS) {
+        time_t    seconds = record->time / 1000000000ull;
+        struct tm tm;
+
+        if (seconds != Log.clock_now) {
+            strftime(Log.clock, sizeof(Log.clock), "%H:%M:%S", localtime_r(&seconds, &tm));
+            Log.clock_now = seconds;
+        }
+
+        n = snprintf(buffer, size, "%s.%03u [%5d] %-5s %10s:%-4d ", Log.clock,
+                     (unsigned)(record->time / 1000000 % 1000), Log.pid,
+                     LogLevelNames[record->level], record->file, record->line);
+        n = n < size ? n : size - 1;
+    }
+
+    n += log_format(record, buffer + n, size - n - 1);
+    buffer[n++] = '\n';
+    return n;
+}
+
+/**
+ * Format message of record.
+ *
+ * @param   record      Record.
+ * @param   buffer      Buffer to format into.
+ * @param   size        Size of buffer.
+ * @return  Length of message (not NUL terminated).
+ *
+ * The format string is walked again with the packed arguments.  Messages
+ * whose arguments did not all fit end in "...".  Strings in access lines and
+ * trace events are escaped, so a request cannot forge lines or fields.
+ **/
+size_t log_format(const LogRecord *record, char *buffer, size_t size) {
+    const char *args = record->args;
+    const char *f    = record->format;
+    size_t      n    = 0;
+    LogSpec     spec;
+
+    for (uint16_t c = 0; *f && n < size; ) {
+        const char *percent = strchr(f, '%');
+        size_t      length  = percent ? (size_t)(percent - f) : strlen(f);
+        int         written = 0;
+
+        /* Literal text */
+        length = length < size - n ? length : size - n;
+        memcpy(buffer + n, f, length);
+        n += length;
+        f += length;
+
+        if (*f != '%' || n >= size) {
+            continue;
+        }
+
+        if (f[1] == '%') {
+            buffer[n++] = '%';
+            f += 2;
+            continue;
+        }
+
+        /* Conversion */
+        if (c == record->nconversions || !(f = log_spec(f, &spec))) {
+            break;
+        }
+
+        if (spec.kind == 's') {
+            uint16_t stored;
+
+            memcpy(&stored, args, sizeof(stored));
+            args += sizeof(stored);
+
+            if (record->level >= LOG_LEVEL_ACCESS) {
+                const char *precision = strchr(spec.text, '.');
+                size_t      limit     = precision ? strtoul(precision + 1, NULL, 10) : stored;
+
+                written = log_escape(args, limit < stored ? limit : stored, buffer + n, size - n,
+                                     record->level == LOG_LEVEL_TRACE);
+            } else {
+                char   value[LOG_RECORD_ARGS];
+
+                memcpy(value, args, stored);
+                value[stored] = '\0';
+                written = snprintf(buffer + n, size - n, spec.text, value);
+            }
+            args += stored;
+        } else {
+            long long          i;
+            unsigned long long u;
+            double             d;
+            void              *p;
+
+            switch (spec.kind) {
+                case 'i': memcpy(&i, args, 8); written = snprintf(buffer + n, size - n, spec.text, i);      break;
+                case 'u': memcpy(&u, args, 8); written = snprintf(buffer + n, size - n, spec.text, u);      break;
+                case 'f': memcpy(&d, args, 8); written = snprintf(buffer + n, size - n, spec.text, d);      break;
+                case 'c': memcpy(&i, args, 8); written = snprintf(buffer + n, size - n, spec.text, (int)i); break;
+                case 'p': memcpy(&p, args, sizeof(p)); written = snprintf(buffer + n, size - n, spec.text, p); break;
+            }
+            args += 8;
+        }
+
+        n += written > 0 ? (size_t)written : 0;
+        n  = n < size ? n : size - 1;
+        c++;
+    }
+
+    if (!record->complete && n + 3 <= size) {
+        memcpy(buffer + n, "...", 3);
+        n += 3;
+    }
+
+    return n < size ? n : size;
+}
+
+/**
+ * Escape string for access log (as Apache does) or trace event (as JSON).
+ *
+ * @param   s           String.
+ * @param   length      Length of string.
+ * @param   buffer      Buffer to escape into.
+ * @param   size        Size of buffer.
+ * @param   json        Whether to escape as a JSON string.
+ * @return  Length of escaped string.
+ *
+ * Quotes and backslashes are prefixed with a backslash, and control and
+ * non-ASCII bytes are written as \xHH (or \u00HH in JSON).
+ **/
+size_t log_escape(const char *s, size_t length, char *buffer, size_t size, bool json) {
+    static const char hex[] = "0123456789abcdef";
+    size_t            n     = 0;
+
+    for (size_t i = 0; i < length && n + 6 < size; i++) {
+        unsigned char c = s[i];
+
+        if (c == '"' || c == '\\') {
+            buffer[n++] = '\\';
+            buffer[n++] = c;
+        } else if ((c < 0x20 || c >= 0x7f) && json) {
+            n += snprintf(buffer + n, size - n, "\\u%04x", c);
+        } else if (c < 0x20 || c >= 0x7f) {
+            buffer[n++] = '\\';
+            buffer[n++] = 'x';
+            buffer[n++] = hex[c >> 4];
+            buffer[n++] = hex[c & 0xf];
+        } else {
+            buffer[n++] = c;
+        }
+    }
+
+    return n;
+}
+
+/**
+ * Write out buffered lines (lock must be held).
+ *
+ * @param   b           Output buffer.
+ **/
+void log_write(LogBuffer *b) {
+    size_t offset = 0;
+
+    while (offset < b->length) {
+        ssize_t nwritten = write(b->fd, b->data + offset, b->length - offset);
+
+        if (nwritten < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (nwritten <= 0) {
+            break;
+        }
+
+        offset += nwritten;
+    }
+
+    b->length = 0;
+}
+
+/**
+ * Hold logger across fork, so the child does not inherit it mid-flush.
+ **/
+void log_prepare(void) {
+    pthread_mutex_lock(&Log.lock);
+}
+
+/**
+ * Release logger in parent after fork.
+ **/
+void log_parent(void) {
+    pthread_mutex_unlock(&Log.lock);
+}
+
+/**
+ * Reset logger in child after fork.
+ *
+ * Records inherited from the parent are left for the parent to write, and
+ * only the forking thread's ring is kept.  The flusher did not survive the
+ * fork, so the next record starts a new one (see log_attach).
+ **/
+void log_child(void) {
+    if (Log.wake >= 0) {
+        close(Log.wake);
+    }
+
+    Log.pid           = getpid();
+    Log.running       = false;
+    Log.synchronous   = false;
+    Log.wake          = -1;
+    Log.rings         = LogLocal;
+    Log.errors.length = 0;
+    Log.access.length = 0;
+    Log.trace.length  = 0;
+
+    if (LogLocal) {
+        LogLocal->tail     = LogLocal->head;
+        LogLocal->dropped  = 0;
+        LogLocal->reported = 0;
+        LogLocal->next     = NULL;
+    }
+
+    pthread_mutex_unlock(&Log.lock);
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,462 @@
+/* metrics.c: Request Metrics */
+
+#include "server.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#include <sys/mman.h>
+#include <time.h>
+
+/* Constants */
+
+#define METRICS_SLOTS           64      /* Workers beyond this share slots */
+#define METRICS_SUB_BITS        3       /* 8 linear sub-buckets per power of two */
+#define METRICS_MAX_EXPONENT    35      /* Largest power of two of microseconds kept apart */
+#define METRICS_BUCKETS         ((METRICS_MAX_EXPONENT - METRICS_SUB_BITS + 2) << METRICS_SUB_BITS)
+#define METRICS_MAX_BOUNDARY    26      /* Largest exported bucket boundary (2^26us = 67s) */
+
+/* Latency Histogram (log-linear, as HdrHistogram, in microseconds) */
+
+typedef struct {
+    uint64_t    buckets[METRICS_BUCKETS];
+    uint64_t    sum;                    /*< Sum of recorded values */
+} Histogram;
+
+/* Slot (one per worker thread or process) */
+
+typedef struct {
+    uint64_t    requests[HTTP_STATUS_COUNT][HANDLER_COUNT];
+    uint64_t    sent;                   /*< Bytes of response bodies */
+    int64_t     connections;            /*< Connections opened minus closed */
+    Histogram   latency;                /*< Time to handle requests */
+    Histogram   cgi;                    /*< Time CGI scripts took */
+} __attribute__((aligned(64))) MetricsSlot;
+
+/* Shared Region (mapped before forking, so processes share it) */
+
+typedef struct {
+    uint64_t    claimed;                /*< Slots claimed so far (modulo METRICS_SLOTS) */
+    time_t      started;                /*< Time metrics were initialized */
+    MetricsSlot slots[METRICS_SLOTS];
+} MetricsRegion;
+
+static MetricsRegion *Metrics = NULL;
+
+static __thread MetricsSlot *MetricsLocal;  /*< Slot of calling thread */
+
+static const char *HandlerNames[] = {"browse", "file", "cgi", "error", "status"};
+
+/* Internal Declarations */
+MetricsSlot *metrics_slot(void);
+void         metrics_child(void);
+void         metrics_record(Histogram *h, const struct timespec *start);
+size_t       metrics_bucket(uint64_t value);
+uint64_t     metrics_upper(size_t bucket);
+void         metrics_sum(MetricsSlot *total);
+double       metrics_quantile(const Histogram *h, uint64_t count, double q);
+uint64_t     metrics_count(const Histogram *h);
+void         metrics_prometheus(FILE *fs, const MetricsSlot *total);
+void         metrics_histogram(FILE *fs, const char *name, const char *help, const Histogram *h);
+void         metrics_json(FILE *fs, const MetricsSlot *total);
+void         metrics_summary(FILE *fs, const char *name, const Histogram *h);
+
+/**
+ * Map shared metrics region.
+ *
+ * This must be called before the server forks, so every process records into
+ * the same region.  If the region cannot be mapped, nothing is recorded.
+ **/
+void metrics_init(void) {
+    MetricsRegion *region = mmap(NULL, sizeof(MetricsRegion), PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (region == MAP_FAILED) {
+        log("Unable to map metrics (%s), metrics disabled", strerror(errno));
+        return;
+    }
+
+    region->started = time(NULL);
+    Metrics         = region;
+    pthread_atfork(NULL, NULL, metrics_child);
+}
+
+/**
+ * Record opened or closed connection.
+ *
+ * @param   delta       1 when a connection is opened, -1 when it is closed.
+ **/
+void metrics_connection(int delta) {
+    MetricsSlot *s = metrics_slot();
+
+    if (s) {
+        __atomic_fetch_add(&s->connections, delta, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Record handled request.
+ *
+ * @param   status      Status of the HTTP request.
+ * @param   handler     Handler that served the request.
+ * @param   sent        Bytes of response body.
+ * @param   start       Time request handling started (CLOCK_MONOTONIC).
+ *
+ * Each worker records into its own slot with relaxed atomic adds, so this
+ * takes no locks, and the adds only contend when more workers than
+ * METRICS_SLOTS share a slot.
+ **/
+void metrics_request(Status status, Handler handler, off_t sent, const struct timespec *start) {
+    MetricsSlot *s = metrics_slot();
+
+    if (!s) {
+        return;
+    }
+
+    __atomic_fetch_add(&s->requests[status][handler], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->sent, sent, __ATOMIC_RELAXED);
+    metrics_record(&s->latency, start);
+}
+
+/**
+ * Record CGI script runtime.
+ *
+ * @param   start       Time script was started (CLOCK_MONOTONIC).
+ **/
+void metrics_cgi(const struct timespec *start) {
+    MetricsSlot *s = metrics_slot();
+
+    if (s) {
+        metrics_record(&s->cgi, start);
+    }
+}
+
+/**
+ * Render metrics of all workers.
+ *
+ * @param   json        Whether to render JSON (rather than Prometheus text).
+ * @param   length      Pointer to store length of rendering in.
+ * @return  Allocated rendering that must be free'd (or NULL on failure).
+ **/
+char * metrics_render(bool json, size_t *length) {
+    MetricsSlot *total;
+    char        *data = NULL;
+    FILE        *fs;
+
+    if (!Metrics || !(total = calloc(1, sizeof(MetricsSlot)))) {
+        return NULL;
+    }
+
+    if (!(fs = open_memstream(&data, length))) {
+        free(total);
+        return NULL;
+    }
+
+    metrics_sum(total);
+
+    if (json) {
+        metrics_json(fs, total);
+    } else {
+        metrics_prometheus(fs, total);
+    }
+
+    fclose(fs);
+    free(total);
+    return data;
+}
+
+/**
+ * Claim slot for calling thread (once per thread and process).
+ *
+ * @return  Slot of calling thread (or NULL if metrics are disabled).
+ **/
+MetricsSlot * metrics_slot(void) {
+    if (!MetricsLocal && Metrics) {
+        uint64_t claimed = __atomic_fetch_add(&Metrics->claimed, 1, __ATOMIC_RELAXED);
+
+        MetricsLocal = &Metrics->slots[claimed % METRICS_SLOTS];
+    }
+
+    return MetricsLocal;
+}
+
+/**
+ * Forget slot of parent in forked child, so the child claims its own.
+ **/
+void metrics_child(void) {
+    MetricsLocal = NULL;
+}
+
+/**
+ * Record time elapsed since start in histogram.
+ *
+ * @param   h           Histogram.
+ * @param   start       Start time (CLOCK_MONOTONIC).
+ **/
+void metrics_record(Histogram *h, const struct timespec *start) {
+    struct timespec now;
+    uint64_t        elapsed;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (now.tv_sec - start->tv_sec) * 1000000 + (now.tv_nsec - start->tv_nsec) / 1000;
+
+    __atomic_fetch_add(&h->buckets[metrics_bucket(elapsed)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum, elapsed, __ATOMIC_RELAXED);
+}
+
+/**
+ * Determine histogram bucket of value.
+ *
+ * @param   value       Value in microseconds.
+ * @return  Index of bucket.
+ *
+ * Values below 8 get a bucket each.  Above that, every power of two is split
+ * into 8 equal buckets, so values are kept within 12.5% of their size.
+ **/
+size_t metrics_bucket(uint64_t value) {
+    size_t exponent;
+
+    if (value < (1 << METRICS_SUB_BITS)) {
+        return value;
+    }
+
+    exponent = 63 - __builtin_clzll(value);
+    if (exponent > METRICS_MAX_EXPONENT) {
+        return METRICS_BUCKETS - 1;
+    }
+
+    return ((exponent - METRICS_SUB_BITS + 1) << METRICS_SUB_BITS) +
+           ((value >> (exponent - METRICS_SUB_BITS)) & ((1 << METRICS_SUB_BITS) - 1));
+}
+
+/**
+ * Determine upper bound of histogram bucket.
+ *
+ * @param   bucket      Index of bucket.
+ * @return  Smallest value (in microseconds) past the bucket.
+ **/
+uint64_t metrics_upper(size_t bucket) {
+    size_t   sub      = (1 << METRICS_SUB_BITS);
+    uint64_t exponent = bucket / sub + METRICS_SUB_BITS - 1;
+
+    if (bucket < sub) {
+        return bucket + 1;
+    }
+
+    return (uint64_t)(sub + bucket % sub + 1) << (exponent - METRICS_SUB_BITS);
+}
+
+/**
+ * Sum slots of all workers.
+ *
+ * @param   total       Zeroed slot to sum into.
+ **/
+void metrics_sum(MetricsSlot *total) {
+    for (size_t i = 0; i < METRICS_SLOTS; i++) {
+        MetricsSlot *s = &Metrics->slots[i];
+
+        for (size_t status = 0; status < HTTP_STATUS_COUNT; status++) {
+            for (size_t handler = 0; handler < HANDLER_COUNT; handler++) {
+                total->requests[status][handler] += __atomic_load_n(&s->requests[status][handler], __ATOMIC_RELAXED);
+            }
+        }
+
+        for (size_t b = 0; b < METRICS_BUCKETS; b++) {
+            total->latency.buckets[b] += __atomic_load_n(&s->latency.buckets[b], __ATOMIC_RELAXED);
+            total->cgi.buckets[b]     += __atomic_load_n(&s->cgi.buckets[b], __ATOMIC_RELAXED);
+        }
+
+        total->sent         += __atomic_load_n(&s->sent, __ATOMIC_RELAXED);
+        total->connections  += __atomic_load_n(&s->connections, __ATOMIC_RELAXED);
+        total->latency.sum  += __atomic_load_n(&s->latency.sum, __ATOMIC_RELAXED);
+        total->cgi.sum      += __atomic_load_n(&s->cgi.sum, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Count values in histogram.
+ *
+ * @param   h           Histogram.
+ * @return  Number of recorded values.
+ **/
+uint64_t metrics_count(const Histogram *h) {
+    uint64_t count = 0;
+
+    for (size_t b = 0; b < METRICS_BUCKETS; b++) {
+        count += h->buckets[b];
+    }
+
+    return count;
+}
+
+/**
+ * Estimate quantile of histogram.
+ *
+ * @param   h           Histogram.
+ * @param   count       Number of recorded values.
+ * @param   q           Quantile (ie. 0.99).
+ * @return  Upper bound of bucket holding the quantile, in seconds.
+ **/
+double metrics_quantile(const Histogram *h, uint64_t count, double q) {
+    uint64_t rank = q * count;
+    uint64_t seen = 0;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    for (size_t b = 0; b < METRICS_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen > rank || seen == count) {
+            return metrics_upper(b) / 1e6;
+        }
+    }
+
+    return metrics_upper(METRICS_BUCKETS - 1) / 1e6;
+}
+
+/**
+ * Write metrics in Prometheus text exposition format.
+ *
+ * @param   fs          Stream to write to.
+ * @param   total       Sum of all slots.
+ *
+ * Response cache counters are those of the process rendering the metrics,
+ * since every process keeps its own cache.
+ **/
+void metrics_prometheus(FILE *fs, const MetricsSlot *total) {
+    size_t hits, misses, bytes;
+
+    respcache_stats(&hits, &misses, &bytes);
+
+    fputs("# HELP c_server_requests_total Requests handled, by status and handler.\n", fs);
+    fputs("# TYPE c_server_requests_total counter\n", fs);
+    for (size_t status = 0; status < HTTP_STATUS_COUNT; status++) {
+        for (size_t handler = 0; handler < HANDLER_COUNT; handler++) {
+            if (total->requests[status][handler]) {
+                fprintf(fs, "c_server_requests_total{status=\"%.3s\",handler=\"%s\"} %ju\n",
+                        http_status_string(status), HandlerNames[handler], (uintmax_t)total->requests[status][handler]);
+            }
+        }
+    }
+
+    fputs("# HELP c_server_sent_bytes_total Bytes of response bodies sent.\n", fs);
+    fputs("# TYPE c_server_sent_bytes_total counter\n", fs);
+    fprintf(fs, "c_server_sent_bytes_total %ju\n", (uintmax_t)total->sent);
+
+    fputs("# HELP c_server_connections Connections being served.\n", fs);
+    fputs("# TYPE c_server_connections gauge\n", fs);
+    fprintf(fs, "c_server_connections %jd\n", (intmax_t)total->connections);
+
+    fputs("# HELP c_server_response_cache_hits_total Responses served from the response cache.\n", fs);
+    fputs("# TYPE c_server_response_cache_hits_total counter\n", fs);
+    fprintf(fs, "c_server_response_cache_hits_total %zu\n", hits);
+
+    fputs("# HELP c_server_response_cache_misses_total Response cache lookups that missed.\n", fs);
+    fputs("# TYPE c_server_response_cache_misses_total counter\n", fs);
+    fprintf(fs, "c_server_response_cache_misses_total %zu\n", misses);
+
+    fputs("# HELP c_server_response_cache_bytes Bytes held in the response cache.\n", fs);
+    fputs("# TYPE c_server_response_cache_bytes gauge\n", fs);
+    fprintf(fs, "c_server_response_cache_bytes %zu\n", bytes);
+
+    metrics_histogram(fs, "c_server_request_duration_seconds", "Time to handle requests.", &total->latency);
+    metrics_histogram(fs, "c_server_cgi_duration_seconds", "Time CGI scripts took.", &total->cgi);
+
+    fputs("# HELP c_server_start_time_seconds Time the server started, in seconds since the epoch.\n", fs);
+    fputs("# TYPE c_server_start_time_seconds gauge\n", fs);
+    fprintf(fs, "c_server_start_time_seconds %jd\n", (intmax_t)Metrics->started);
+}
+
+/**
+ * Write histogram in Prometheus text exposition format.
+ *
+ * @param   fs          Stream to write to.
+ * @param   name        Name of metric.
+ * @param   help        Description of metric.
+ * @param   h           Histogram.
+ *
+ * Buckets are exported at every power of two of microseconds up to
+ * 2^METRICS_MAX_BOUNDARY, which all fall on bucket boundaries, so the
+ * cumulative counts are exact.
+ **/
+void metrics_histogram(FILE *fs, const char *name, const char *help, const Histogram *h) {
+    uint64_t count = 0;
+    size_t   b     = 0;
+
+    fprintf(fs, "# HELP %s %s\n", name, help);
+    fprintf(fs, "# TYPE %s histogram\n", name);
+
+    for (size_t k = 0; k <= METRICS_MAX_BOUNDARY; k++) {
+        for (; b < METRICS_BUCKETS && metrics_upper(b) <= (1ull << k); b++) {
+            count += h->buckets[b];
+        }
+        fprintf(fs, "%s_bucket{le=\"%.9g\"} %ju\n", name, (1ull << k) / 1e6, (uintmax_t)count);
+    }
+
+    for (; b < METRICS_BUCKETS; b++) {
+        count += h->buckets[b];
+    }
+
+    fprintf(fs, "%s_bucket{le=\"+Inf\"} %ju\n", name, (uintmax_t)count);
+    fprintf(fs, "%s_sum %g\n", name, h->sum / 1e6);
+    fprintf(fs, "%s_count %ju\n", name, (uintmax_t)count);
+}
+
+/**
+ * Write metrics as JSON.
+ *
+ * @param   fs          Stream to write to.
+ * @param   total       Sum of all slots.
+ *
+ * As with metrics_prometheus, response cache counters are those of the
+ * process rendering the metrics.
+ **/
+void metrics_json(FILE *fs, const MetricsSlot *total) {
+    const char *separator = "";
+    size_t      hits, misses, bytes;
+
+    respcache_stats(&hits, &misses, &bytes);
+
+    fprintf(fs, "{\n  \"uptime_seconds\": %jd,\n", (intmax_t)(time(NULL) - Metrics->started));
+    fprintf(fs, "  \"connections\": %jd,\n", (intmax_t)total->connections);
+    fprintf(fs, "  \"sent_bytes\": %ju,\n", (uintmax_t)total->sent);
+    fprintf(fs, "  \"response_cache\": {\"hits\": %zu, \"misses\": %zu, \"bytes\": %zu},\n", hits, misses, bytes);
+
+    fputs("  \"requests\": [", fs);
+    for (size_t status = 0; status < HTTP_STATUS_COUNT; status++) {
+        for (size_t handler = 0; handler < HANDLER_COUNT; handler++) {
+            if (total->requests[status][handler]) {
+                fprintf(fs, "%s\n    {\"status\": %.3s, \"handler\": \"%s\", \"count\": %ju}", separator,
+                        http_status_string(status), HandlerNames[handler], (uintmax_t)total->requests[status][handler]);
+                separator = ",";
+            }
+        }
+    }
+    fputs("\n  ],\n", fs);
+
+    metrics_summary(fs, "request_duration_seconds", &total->latency);
+    fputs(",\n", fs);
+    metrics_summary(fs, "cgi_duration_seconds", &total->cgi);
+    fputs("\n}\n", fs);
+}
+
+/**
+ * Write histogram summary as JSON member.
+ *
+ * @param   fs          Stream to write to.
+ * @param   name        Name of member.
+ * @param   h           Histogram.
+ **/
+void metrics_summary(FILE *fs, const char *name, const Histogram *h) {
+    uint64_t count = metrics_count(h);
+
+    fprintf(fs, "  \"%s\": {\"count\": %ju, \"sum\": %g, \"p50\": %g, \"p90\": %g, \"p99\": %g, \"p999\": %g, \"max\": %g}",
+            name, (uintmax_t)count, h->sum / 1e6,
+            metrics_quantile(h, count, 0.50), metrics_quantile(h, count, 0.90),
+            metrics_quantile(h, count, 0.99), metrics_quantile(h, count, 0.999),
+            metrics_quantile(h, count, 1.0));
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
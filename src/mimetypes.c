@@ -0,0 +1,314 @@
+/* mimetypes.c: Mime-Type Index */
+
+#include "server.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Constants */
+
+#define MIMETYPES_MAX_EXTENSION 64
+
+/* Built-in Table (generated from lib/mime.types by make) */
+
+static const struct {
+    const char *extension;
+    const char *mimetype;
+} BuiltinMimeTypes[] = {
+#include "mimetypes_builtin.h"
+};
+
+/* Hash Table */
+
+typedef struct {
+    const char *extension;              /*< Lowercase file extension (NULL if slot is empty) */
+    const char *mimetype;               /*< Mime-type of extension */
+} MimeEntry;
+
+typedef struct mime_table MimeTable;
+struct mime_table {
+    MimeEntry  *entries;                /*< Open-addressing slots */
+    size_t      capacity;               /*< Number of slots (power of two) */
+    size_t      size;                   /*< Number of extensions */
+    char       *strings;                /*< Contents of mime.types file (NULL for built-in table) */
+    MimeTable  *retired;                /*< Table this one replaced */
+};
+
+static MimeTable *MimeTypes = NULL;
+static volatile sig_atomic_t MimeTypesStale = false;
+
+/* Internal Declarations */
+MimeTable * mimetypes_build(char *strings);
+bool        mimetypes_insert(MimeTable *t, const char *extension, const char *mimetype);
+char *      mimetypes_read(const char *path);
+uint32_t    mimetypes_hash(const char *extension);
+
+/**
+ * Load mime-types file into the index.
+ *
+ * @param   path        Path to mime-types file.
+ * @return  Whether or not the file was loaded.
+ *
+ * The file is parsed once into an open-addressing hash table keyed by
+ * lowercase extension, which then replaces the current table.  If the file
+ * cannot be read, then the built-in table generated from lib/mime.types is
+ * used instead (unless a table is already loaded, which is then kept).
+ *
+ * Lookups on other threads may still be using the previous table, so it is
+ * retired rather than free'd.
+ **/
+bool mimetypes_load(const char *path) {
+    MimeTable *table   = NULL;
+    char      *strings = mimetypes_read(path);
+
+    if (strings) {
+        table = mimetypes_build(strings);
+    } else {
+        log("Unable to read %s: %s", path, strerror(errno));
+    }
+
+    if (!table && MimeTypes) {
+        return false;
+    }
+
+    if (!table) {
+        debug("Using built-in mime-types");
+        table = mimetypes_build(NULL);
+    }
+
+    if (!table) {
+        fatal("Unable to build mime-types: %s", strerror(errno));
+    }
+
+    table->retired = MimeTypes;
+    __atomic_store_n(&MimeTypes, table, __ATOMIC_RELEASE);
+
+    debug("Loaded %zu mime-type extensions", table->size);
+    return table->strings != NULL;
+}
+
+/**
+ * Look up mime-type of file extension.
+ *
+ * @param   extension   File extension (without leading '.').
+ * @return  Borrowed mime-type string (or NULL if extension is unknown).
+ **/
+const char * mimetypes_lookup(const char *extension) {
+    MimeTable *table = __atomic_load_n(&MimeTypes, __ATOMIC_ACQUIRE);
+    char       key[MIMETYPES_MAX_EXTENSION];
+    size_t     i;
+
+    if (!table) {
+        return NULL;
+    }
+
+    /* Lowercase extension */
+    for (i = 0; extension[i]; i++) {
+        if (i == sizeof(key) - 1) {
+            return NULL;
+        }
+        key[i] = tolower((unsigned char)extension[i]);
+    }
+    key[i] = '\0';
+
+    /* Probe slots until match or empty slot */
+    for (i = mimetypes_hash(key) & (table->capacity - 1); table->entries[i].extension; i = (i + 1) & (table->capacity - 1)) {
+        if (streq(table->entries[i].extension, key)) {
+            return table->entries[i].mimetype;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Reload MimeTypesPath if a reload was requested.
+ *
+ * @return  Whether or not a reload was requested.
+ **/
+bool mimetypes_refresh(void) {
+    if (!MimeTypesStale || !__atomic_exchange_n(&MimeTypesStale, false, __ATOMIC_ACQ_REL)) {
+        return false;
+    }
+
+    log("Reloading %s", MimeTypesPath);
+    mimetypes_load(MimeTypesPath);
+    return true;
+}
+
+/**
+ * Signal handler that requests a reload of MimeTypesPath.
+ *
+ * @param   signum      Signal number.
+ *
+ * The reload itself happens on the next call to mimetypes_refresh, since
+ * building the table is not async-signal-safe.
+ **/
+void mimetypes_stale(int signum) {
+    MimeTypesStale = true;
+}
+
+/**
+ * Build hash table from contents of mime-types file.
+ *
+ * @param   strings     Contents of mime-types file (or NULL for built-in table).
+ * @return  Allocated table (or NULL on failure).
+ *
+ * The file contents are tokenized and lowercased in place and owned by the
+ * table.  Each line has the format:
+ *
+ *  <MIMETYPE>      <EXT1> <EXT2> ...
+ *
+ * If an extension appears more than once, the first mime-type wins.
+ **/
+MimeTable * mimetypes_build(char *strings) {
+    MimeTable *t     = calloc(1, sizeof(MimeTable));
+    size_t     count = sizeof(BuiltinMimeTypes) / sizeof(BuiltinMimeTypes[0]);
+
+    if (!t) {
+        goto fail;
+    }
+
+    /* Count tokens to bound number of extensions */
+    if (strings) {
+        count = 0;
+        for (char *s = skip_whitespace(strings); *s; s = skip_whitespace(skip_nonwhitespace(s))) {
+            count++;
+        }
+    }
+
+    /* Size table for a load factor of at most one half */
+    t->capacity = 16;
+    while (t->capacity < 2 * count) {
+        t->capacity *= 2;
+    }
+
+    t->entries = calloc(t->capacity, sizeof(MimeEntry));
+    if (!t->entries) {
+        goto fail;
+    }
+
+    /* Insert built-in table */
+    if (!strings) {
+        for (size_t i = 0; i < count; i++) {
+            mimetypes_insert(t, BuiltinMimeTypes[i].extension, BuiltinMimeTypes[i].mimetype);
+        }
+        return t;
+    }
+
+    /* Insert each line of file */
+    t->strings = strings;
+
+    for (char *line = strings, *next; line; line = next) {
+        char *mimetype, *token, *state;
+
+        next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+
+        line = skip_whitespace(line);
+        if (*line == '#') {
+            continue;
+        }
+
+        mimetype = strtok_r(line, WHITESPACE, &state);
+        token    = strtok_r(NULL, WHITESPACE, &state);
+        while (token) {
+            for (char *c = token; *c; c++) {
+                *c = tolower((unsigned char)*c);
+            }
+
+            mimetypes_insert(t, token, mimetype);
+            token = strtok_r(NULL, WHITESPACE, &state);
+        }
+    }
+
+    return t;
+
+fail:
+    if (t) {
+        free(t->entries);
+    }
+    free(t);
+    free(strings);
+    return NULL;
+}
+
+/**
+ * Insert extension into hash table.
+ *
+ * @param   t           Hash table.
+ * @param   extension   Lowercase file extension.
+ * @param   mimetype    Mime-type of extension.
+ * @return  Whether or not the extension was inserted (false if already present).
+ **/
+bool mimetypes_insert(MimeTable *t, const char *extension, const char *mimetype) {
+    size_t i;
+
+    for (i = mimetypes_hash(extension) & (t->capacity - 1); t->entries[i].extension; i = (i + 1) & (t->capacity - 1)) {
+        if (streq(t->entries[i].extension, extension)) {
+            return false;
+        }
+    }
+
+    t->entries[i].extension = extension;
+    t->entries[i].mimetype  = mimetype;
+    t->size++;
+    return true;
+}
+
+/**
+ * Read entire file into memory.
+ *
+ * @param   path        Path to file.
+ * @return  Allocated NUL-terminated contents of file (or NULL on failure).
+ **/
+char * mimetypes_read(const char *path) {
+    char  *strings = NULL;
+    size_t length  = 0;
+    FILE  *fs      = fopen(path, "r");
+
+    if (!fs) {
+        return NULL;
+    }
+
+    if (fseek(fs, 0, SEEK_END) < 0 || (length = ftell(fs)) == (size_t)-1 || fseek(fs, 0, SEEK_SET) < 0) {
+        goto fail;
+    }
+
+    strings = malloc(length + 1);
+    if (!strings || fread(strings, 1, length, fs) != length) {
+        goto fail;
+    }
+
+    strings[length] = '\0';
+    fclose(fs);
+    return strings;
+
+fail:
+    free(strings);
+    fclose(fs);
+    return NULL;
+}
+
+/**
+ * Hash file extension (FNV-1a).
+ *
+ * @param   extension   Lowercase file extension.
+ * @return  Hash of extension.
+ **/
+uint32_t mimetypes_hash(const char *extension) {
+    uint32_t hash = 2166136261u;
+
+    for (const unsigned char *c = (const unsigned char *)extension; *c; c++) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+
+    return hash;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,166 @@
+/* offload.c: Blocking Handlers on Helper Threads */
+
+#include "server.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/* Job (deferred request and the server loop connection it belongs to) */
+
+typedef struct offload_job OffloadJob;
+struct offload_job {
+    Request    *request;                /*< Request left by dispatch_request */
+    void       *context;                /*< Connection handed back to server loop */
+    OffloadJob *next;                   /*< Next job in queue */
+};
+
+/* Queues shared by the server loop and helper threads */
+
+static struct {
+    pthread_mutex_t lock;               /*< Protects everything below */
+    pthread_cond_t  ready;              /*< Signaled when jobs are pending */
+    OffloadJob     *pending;            /*< Oldest job waiting for a helper */
+    OffloadJob     *last;               /*< Newest job waiting for a helper */
+    OffloadJob     *finished;           /*< Jobs waiting for the server loop */
+    int             efd;                /*< Counts finished jobs (eventfd) */
+} Offload = { .lock = PTHREAD_MUTEX_INITIALIZER, .ready = PTHREAD_COND_INITIALIZER, .efd = -1 };
+
+/* Internal Declarations */
+void *      offload_helper(void *arg);
+
+/**
+ * Start helper threads.
+ *
+ * @return  Nonblocking eventfd that becomes readable whenever requests
+ *          finish (or -1 on failure).
+ *
+ * Server loops cannot block on a request, so requests whose handler blocks
+ * (see resume_request) are handed to one of Workers helper threads instead.
+ * The server loop watches the returned eventfd, reads it once it is readable,
+ * and then collects every finished request with offload_finished.
+ **/
+int offload_init(void) {
+    pthread_t thread;
+
+    Offload.efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (Offload.efd < 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < Workers; i++) {
+        int status = pthread_create(&thread, NULL, offload_helper, NULL);
+
+        if (status != 0) {
+            fatal("Unable to create helper thread: %s", strerror(status));
+        }
+
+        pthread_detach(thread);
+    }
+
+    return Offload.efd;
+}
+
+/**
+ * Queue deferred request for a helper thread.
+ *
+ * @param   r           HTTP Request structure (with r->deferred set).
+ * @param   context     Connection returned by offload_finished once the
+ *                      response has been rendered to r->stream.
+ * @return  Whether or not the request was queued.
+ *
+ * The server loop must not touch the request until it is handed back.
+ **/
+bool offload_request(Request *r, void *context) {
+    OffloadJob *job;
+
+    if (Offload.efd < 0 || !(job = calloc(1, sizeof(OffloadJob)))) {
+        return false;
+    }
+
+    job->request = r;
+    job->context = context;
+
+    pthread_mutex_lock(&Offload.lock);
+    if (Offload.last) {
+        Offload.last->next = job;
+    } else {
+        Offload.pending = job;
+    }
+    Offload.last = job;
+    pthread_cond_signal(&Offload.ready);
+    pthread_mutex_unlock(&Offload.lock);
+    return true;
+}
+
+/**
+ * Collect finished request.
+ *
+ * @return  Connection passed to offload_request (or NULL if no more requests
+ *          have finished).
+ **/
+void * offload_finished(void) {
+    OffloadJob *job;
+    void       *context = NULL;
+
+    pthread_mutex_lock(&Offload.lock);
+    if ((job = Offload.finished)) {
+        Offload.finished = job->next;
+    }
+    pthread_mutex_unlock(&Offload.lock);
+
+    if (job) {
+        context = job->context;
+        free(job);
+    }
+
+    return context;
+}
+
+/**
+ * Resume deferred requests oldest-first.
+ *
+ * @param   arg         Unused.
+ * @return  NULL.
+ **/
+void * offload_helper(void *arg) {
+    uint64_t one = 1;
+
+    (void)arg;
+
+    while (true) {
+        OffloadJob *job;
+
+        /* Wait for oldest pending job */
+        pthread_mutex_lock(&Offload.lock);
+        while (!Offload.pending) {
+            pthread_cond_wait(&Offload.ready, &Offload.lock);
+        }
+        job             = Offload.pending;
+        Offload.pending = job->next;
+        if (!Offload.pending) {
+            Offload.last = NULL;
+        }
+        pthread_mutex_unlock(&Offload.lock);
+
+        /* Run blocking handler */
+        resume_request(job->request);
+
+        /* Hand request back and wake server loop */
+        pthread_mutex_lock(&Offload.lock);
+        job->next        = Offload.finished;
+        Offload.finished = job;
+        pthread_mutex_unlock(&Offload.lock);
+
+        if (write(Offload.efd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            log("Unable to wake server loop: %s", strerror(errno));
+        }
+    }
+
+    return NULL;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,176 @@
+/* prefork.c: Pre-Forked HTTP Server */
+
+#include "server.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Internal Declarations */
+pid_t prefork_spawn(int sfd);
+int   prefork_worker(int sfd);
+void  prefork_stop(int signum);
+
+static volatile sig_atomic_t Running = true;
+
+/**
+ * Handle HTTP requests with a supervised pool of pre-forked worker processes.
+ *
+ * @param   sfd         Server socket file descriptor.
+ * @return  Exit status of server (EXIT_SUCCESS or EXIT_FAILURE).
+ *
+ * The parent forks Workers long-lived children that all accept on the shared
+ * server socket.  The parent then waits for children to exit and respawns
+ * them, whether they crashed or were recycled after MaxRequests requests.  On
+ * SIGHUP, the parent reloads the mime-types and forwards the signal to the
+ * workers.  On SIGINT or SIGTERM, the parent terminates all of the workers and
+ * returns.
+ **/
+int prefork_server(int sfd) {
+    struct sigaction action = { .sa_handler = prefork_stop };
+    struct sigaction reload = { .sa_handler = mimetypes_stale };
+    pid_t *workers;
+
+    /* Allocate worker table */
+    workers = calloc(Workers, sizeof(pid_t));
+
+    /* Check for failure */
+    if (!workers) {
+        log("Unable to allocate workers: %s", strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    /* Install shutdown handlers (without SA_RESTART so waitpid is interrupted) */
+    sigaction(SIGINT,  &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGHUP,  &reload, NULL);
+
+    /* Spawn initial workers */
+    for (size_t i = 0; i < Workers; i++) {
+        workers[i] = prefork_spawn(sfd);
+    }
+
+    /* Supervise workers */
+    while (Running) {
+        int   status;
+        pid_t pid = waitpid(-1, &status, 0);
+
+        /* Check for failure */
+        if (pid < 0) {
+            if (errno != EINTR) {
+                log("Unable to waitpid: %s", strerror(errno));
+                sleep(1);
+            }
+        }
+
+        /* Reload mime-types for new workers and pass reload on to others */
+        if (mimetypes_refresh()) {
+            for (size_t i = 0; i < Workers; i++) {
+                if (workers[i] > 0) {
+                    kill(workers[i], SIGHUP);
+                }
+            }
+        }
+
+        /* Respawn missing or exited workers */
+        for (size_t i = 0; Running && i < Workers; i++) {
+            if (workers[i] > 0 && workers[i] != pid) {
+                continue;
+            }
+
+            if (workers[i] > 0 && WIFSIGNALED(status)) {
+                log("Worker %d crashed with signal %d", pid, WTERMSIG(status));
+            } else if (workers[i] > 0) {
+                debug("Worker %d exited with status %d", pid, WEXITSTATUS(status));
+            }
+
+            workers[i] = prefork_spawn(sfd);
+        }
+    }
+
+    /* Terminate workers */
+    log("Terminating workers");
+    for (size_t i = 0; i < Workers; i++) {
+        if (workers[i] > 0) {
+            kill(workers[i], SIGTERM);
+        }
+    }
+
+    while (waitpid(-1, NULL, 0) > 0 || errno == EINTR);
+
+    free(workers);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Fork a new worker process.
+ *
+ * @param   sfd         Server socket file descriptor.
+ * @return  Process id of worker (or -1 on error).
+ **/
+pid_t prefork_spawn(int sfd) {
+    pid_t pid = fork();
+
+    if (pid < 0) {                              /* Error */
+        log("Unable to fork: %s", strerror(errno));
+    } else if (pid == 0) {                      /* Child */
+        struct sigaction reload = { .sa_handler = mimetypes_stale, .sa_flags = SA_RESTART };
+
+        signal(SIGINT,  SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        sigaction(SIGHUP, &reload, NULL);
+        exit(prefork_worker(sfd));
+    } else {                                    /* Parent */
+        debug("Spawned worker %d", pid);
+    }
+
+    return pid;
+}
+
+/**
+ * Accept and handle HTTP requests until MaxRequests have been served.
+ *
+ * @param   sfd         Server socket file descriptor.
+ * @return  Exit status of worker (EXIT_SUCCESS).
+ *
+ * If MaxRequests is 0, then the worker serves requests forever.
+ **/
+int prefork_worker(int sfd) {
+    size_t served = 0;
+
+    filecache_init();
+
+    while (MaxRequests == 0 || served < MaxRequests) {
+        /* Accept request */
+        Request *request = accept_request(sfd);
+
+        /* Check for failure */
+        if (!request) {
+            log("Unable to accept request: %s", strerror(errno));
+            continue;
+        }
+
+        /* Handle requests on connection */
+        served += handle_connection(request);
+
+        /* Free request */
+        free_request(request);
+    }
+
+    debug("Recycling worker after %zu requests", served);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Signal handler that stops supervising workers.
+ *
+ * @param   signum      Signal number.
+ **/
+void prefork_stop(int signum) {
+    Running = false;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
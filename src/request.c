@@ -4,33 +4,135 @@
 
 #include <errno.h>
 #include <string.h>
+#include <strings.h>
 
+#include <poll.h>
 #include <unistd.h>
 
-int parse_request_method(Request *r);
-int parse_request_headers(Request *r);
+/* Perfect hash of known header names (generated) */
+#include "headers_table.h"
+
+static const struct {
+    const char *string;
+    size_t      length;
+} HeaderStrings[] = {
+#define HEADER_STRING(name, string) { string, sizeof(string) - 1 },
+    HTTP_HEADERS(HEADER_STRING)
+#undef HEADER_STRING
+};
+
+void         request_peer(Request *r);
+RequestState parse_request_buffer(Request *r);
+bool         parse_request_line(Request *r, char *line, size_t length);
+char *       parse_request_token(char **cursor, char *end);
+bool         parse_request_header(Request *r, char *line, size_t length);
 
 /**
  * Accept request from server socket.
  *
  * @param   sfd         Server socket file descriptor.
- * @return  Newly allocated Request structure.
+ * @return  Newly allocated Request structure (or NULL with errno set).
  *
- * This function does the following:
+ * This accepts a single blocking client with its socket stream opened (see
+ * accept_requests).
+ *
+ * The returned request struct must be deallocated using free_request.
+ **/
+Request * accept_request(int sfd) {
+    Request *r = NULL;
+
+    return accept_requests(sfd, &r, 1, 0) == 1 ? r : NULL;
+}
+
+/**
+ * Accept batch of requests from server socket.
+ *
+ * @param   sfd         Server socket file descriptor.
+ * @param   requests    Array to store newly allocated Request structures in.
+ * @param   max         Maximum number of requests to accept.
+ * @param   flags       SOCK_NONBLOCK for nonblocking client sockets (or 0).
+ * @return  Number of requests accepted (0 with errno set if none were, which
+ * is EAGAIN once a nonblocking server socket has no more pending clients).
+ *
+ * This function does the following for each client, until max clients are
+ * accepted or none are pending:
  *
  *  1. Allocates a request struct initialized to 0.
- *  2. Initializes the headers list in the request struct.
- *  3. Accepts a client connection from the server socket.
- *  4. Looks up the client information and stores it in the request struct.
- *  5. Opens the client socket stream for the request struct.
- *  6. Returns the request struct.
+ *  2. Accepts a client connection from the server socket with accept4, so the
+ *     socket is close-on-exec (and nonblocking if requested) without further
+ *     system calls.
+ *  3. Keeps the client's raw address, which is only formatted if something
+ *     asks for it (see request_host).
+ *  4. Opens the client socket stream for blocking clients.  Nonblocking
+ *     clients are left for server loops that provide r->stream themselves.
+ *
+ * Batches only go beyond one client on a nonblocking server socket.
+ *
+ * The returned request structs must be deallocated using free_request.
+ **/
+size_t accept_requests(int sfd, Request **requests, size_t max, int flags) {
+    size_t n = 0;
+
+    while (n < max) {
+        Request *r = calloc(1, sizeof(Request));
+
+        /* Check for failure */
+        if (!r) {
+            debug("Unable to allocate request: %s", strerror(errno));
+            break;
+        }
+
+        r->body_fd        = -1;
+        r->address_length = sizeof(r->address);
+
+        /* Accept a client */
+        r->fd = accept4(sfd, (struct sockaddr *)&r->address, &r->address_length, flags | SOCK_CLOEXEC);
+
+        /* Check for failure */
+        if (r->fd < 0) {
+            int error = errno;
+
+            if (error != EAGAIN && error != EWOULDBLOCK) {
+                debug("Unable to accept client: %s", strerror(error));
+            }
+            free(r);
+            errno = error;
+            break;
+        }
+
+        /* Open socket stream */
+        if (!(flags & SOCK_NONBLOCK) && !(r->stream = fdopen(r->fd, "w"))) {
+            debug("Unable to fdopen: %s", strerror(errno));
+            free_request(r);
+            break;
+        }
+
+        if (TraceSampleRate > 0) {
+            r->accepted = trace_clock();
+        }
+
+        debug("Accepted client socket %d", r->fd);
+        requests[n++] = r;
+    }
+
+    return n;
+}
+
+/**
+ * Create request from already accepted client socket.
+ *
+ * @param   fd          Client socket file descriptor.
+ * @return  Newly allocated Request structure.
+ *
+ * This is used by server loops that accept clients themselves.  No socket
+ * stream is opened, so the caller is responsible for providing r->stream
+ * before handling the request.  The client's address is looked up only if
+ * something asks for it.  On failure, the client socket is not closed.
  *
  * The returned request struct must be deallocated using free_request.
  **/
-Request * accept_request(int sfd) {
+Request * create_request(int fd) {
     Request *r;
-    struct sockaddr raddr;
-    socklen_t rlen = sizeof(struct sockaddr);
 
     /* Allocate request struct (zeroed) */
     r = calloc(1, sizeof(Request));
@@ -38,44 +140,78 @@ Request * accept_request(int sfd) {
     /* Check for failure */
     if (!r) {
         debug("Unable to allocate request: %s", strerror(errno));
-        goto fail;
+        return NULL;
     }
 
-    /* Accept a client */
-    r->fd = accept(sfd, &raddr, &rlen);
+    r->fd      = fd;
+    r->body_fd = -1;
 
-    /* Check for failure */
-    if (r->fd < 0) {
-        debug("Unable to accept client: %s", strerror(errno));
-        goto fail;
+    if (TraceSampleRate > 0) {
+        r->accepted = trace_clock();
     }
 
-    /* Lookup client information */
-    int status = getnameinfo(&raddr, rlen, r->host, sizeof(r->host), r->port, sizeof(r->port), \
-                             NI_NUMERICHOST | NI_NUMERICSERV);
+    debug("Accepted client socket %d", fd);
+    return r;
+}
 
-    /* Check for failure */
-    if (status < 0) {
-        debug("Unable to getnameinfo: %s", gai_strerror(status));
-        goto fail;
+/**
+ * Return numeric host of client.
+ *
+ * @param   r           Request structure.
+ * @return  Host of client (empty if unknown).
+ **/
+const char * request_host(Request *r) {
+    request_peer(r);
+    return r->host;
+}
+
+/**
+ * Return numeric port of client.
+ *
+ * @param   r           Request structure.
+ * @return  Port of client (empty if unknown).
+ **/
+const char * request_port(Request *r) {
+    request_peer(r);
+    return r->port;
+}
+
+/**
+ * Format client address into host and port (once per connection).
+ *
+ * @param   r           Request structure.
+ *
+ * Clients created without an address (see create_request) are looked up with
+ * getpeername first.
+ **/
+void request_peer(Request *r) {
+    uint64_t traced;
+    int      status;
+
+    if (r->host[0] || r->address_length == (socklen_t)-1) {
+        return;
     }
 
-    /* Open socket stream */
-    r->stream = fdopen(r->fd, "w+");
+    traced = trace_start();
 
-    /* Check for failure */
-    if (!r->stream) {
-        debug("Unable to fdopen: %s", strerror(errno));
-        goto fail;
+    if (r->address_length == 0) {
+        r->address_length = sizeof(r->address);
+        if (getpeername(r->fd, (struct sockaddr *)&r->address, &r->address_length) < 0) {
+            r->address_length = (socklen_t)-1;
+            trace_end(TRACE_PEER, traced);
+            return;
+        }
     }
 
-    log("Accepted request from %s:%s", r->host, r->port);
-    return r;
+    status = getnameinfo((struct sockaddr *)&r->address, r->address_length, r->host, sizeof(r->host),
+                         r->port, sizeof(r->port), NI_NUMERICHOST | NI_NUMERICSERV);
+
+    if (status != 0) {
+        debug("Unable to getnameinfo: %s", gai_strerror(status));
+        r->address_length = (socklen_t)-1;
+    }
 
-fail:
-    /* Deallocate request struct */
-    free_request(r);
-    return NULL;
+    trace_end(TRACE_PEER, traced);
 }
 
 /**
@@ -86,9 +222,8 @@ fail:
  * This function does the following:
  *
  *  1. Closes the request socket stream or file descriptor.
- *  2. Frees all allocated strings in request struct.
- *  3. Frees all of the headers (including any allocated fields).
- *  4. Frees request struct.
+ *  2. Resets the request, freeing all per-request fields.
+ *  3. Frees request struct.
  **/
 void free_request(Request *r) {
     if (!r) {
@@ -96,186 +231,428 @@ void free_request(Request *r) {
     }
 
     /* Close socket or fd */
-    fclose(r->stream);
-
-    /* Free allocated strings */
-    if (r->method) free(r->method);
-    if (r->uri)    free(r->uri);
-    if (r->path)   free(r->path);
-    if (r->query)  free(r->query);
-
-    /* Free headers */
-    while (r->headers) {
-        Header *next_header = r->headers->next;
-        if (r->headers->name) free(r->headers->name);
-        if (r->headers->data) free(r->headers->data);
-        free(r->headers);
-        r->headers = next_header;
+    if (r->stream) {
+        fclose(r->stream);
+    } else if (r->fd >= 0) {
+        close(r->fd);
     }
 
+    /* Free per-request fields */
+    reset_request(r);
+
     /* Free request */
     free(r);
 }
 
+/**
+ * Reset request struct for the next request on the same connection.
+ *
+ * @param   r           Request structure.
+ *
+ * This function does the following:
+ *
+ *  1. Releases cached file metadata and closes any file body left for the
+ *     server loop to send.
+ *  2. Frees the request path and clears the parsed request line and headers.
+ *  3. Moves any unparsed (pipelined) bytes to the front of the buffer and
+ *     resets the parser.
+ *
+ * The client socket, stream, and client information are kept.
+ **/
+void reset_request(Request *r) {
+    /* Close file body (unless it is shared through the file cache) */
+    if (r->file) {
+        filecache_release(r->file);
+    } else if (r->body_fd >= 0) {
+        close(r->body_fd);
+    }
+
+    r->file        = NULL;
+
+    r->body_fd     = -1;
+    r->body_offset = 0;
+    r->body_length = 0;
+
+    r->content_length = 0;
+
+    /* Free path and forget parsed fields (which point into buffer) */
+    free(r->path);
+
+    r->method   = r->uri = r->path = r->query = NULL;
+    r->nheaders = 0;
+    r->nunknown = 0;
+    memset(r->known, 0, sizeof(r->known));
+
+    /* Keep pipelined bytes */
+    memmove(r->buffer, r->buffer + r->offset, r->length - r->offset);
+    r->length    -= r->offset;
+    r->offset     = 0;
+    r->scanned    = 0;
+    r->state      = REQUEST_LINE;
+    r->http11     = false;
+    r->keep_alive = false;
+}
+
+/**
+ * Wait for the next request on a persistent connection.
+ *
+ * @param   r           Request structure.
+ * @param   timeout     Maximum time to wait in milliseconds.
+ * @return  Whether or not request data is available.
+ *
+ * This returns immediately if pipelined bytes are already buffered.  Otherwise
+ * it waits for the client to send more data, returning false if the client
+ * closes the connection or the timeout expires.
+ **/
+bool wait_request(Request *r, int timeout) {
+    struct pollfd pfd = { .fd = r->fd, .events = POLLIN };
+
+    if (r->length > 0) {
+        return true;
+    }
+
+    if (poll(&pfd, 1, timeout) <= 0) {
+        return false;
+    }
+
+    ssize_t nread = read(r->fd, r->buffer, sizeof(r->buffer));
+
+    if (nread <= 0) {
+        return false;
+    }
+
+    r->length = nread;
+    return true;
+}
+
 /**
  * Parse HTTP Request.
  *
  * @param   r           Request structure.
  * @return  -1 on error and 0 on success.
  *
- * This function first parses the request method, any query, and then the
- * headers, returning 0 on success, and -1 on error.
+ * This function parses the request line and headers already in the request
+ * buffer, reading more data from the client socket until the header block is
+ * complete, returning 0 on success, and -1 on error.
+ *
+ * On success, it also decides whether the connection persists after this
+ * request: HTTP/1.1 connections persist unless the client sent Connection:
+ * close, while HTTP/1.0 connections persist only if the client sent
+ * Connection: keep-alive.  Requests with a body, or beyond KeepAliveRequests
+ * on the same connection, close the connection.
  **/
 int parse_request(Request *r) {
-    /* Parse HTTP Request Method */
-    int status = parse_request_method(r);
+    const char  *connection;
+    RequestState state;
+
+    log("Parsing request");
+
+    /* Parse buffered data, reading more until the header block is complete */
+    while ((state = parse_request_buffer(r)) == REQUEST_LINE || state == REQUEST_HEADERS) {
+        ssize_t nread = read(r->fd, r->buffer + r->length, sizeof(r->buffer) - r->length);
 
-    /* Parse HTTP Request Headers*/
-    status = parse_request_headers(r);
+        if (nread <= 0) {
+            return -1;
+        }
+
+        r->length += nread;
+    }
+
+    if (state != REQUEST_COMPLETE) {
+        return -1;
+    }
 
     log("Finished parsing request");
 
-    return status;
+#ifndef NDEBUG
+    for (size_t i = 0; i < HEADER_COUNT; i++) {
+        if (r->known[i].name_length) {
+            debug("HTTP HEADER %s = %s", r->buffer + r->known[i].name, r->buffer + r->known[i].value);
+        }
+    }
+    for (size_t i = 0; i < r->nunknown; i++) {
+    	debug("HTTP HEADER %s = %s", r->buffer + r->unknown[i].name, r->buffer + r->unknown[i].value);
+    }
+#endif
+
+    /* Determine if connection persists */
+    r->keep_alive = r->http11;
+
+    if ((connection = request_header(r, HEADER_CONNECTION))) {
+        if (strcasecmp(connection, "close") == 0) {
+            r->keep_alive = false;
+        } else if (strcasecmp(connection, "keep-alive") == 0) {
+            r->keep_alive = true;
+        }
+    }
+
+    if (request_header(r, HEADER_CONTENT_LENGTH) || request_header(r, HEADER_TRANSFER_ENCODING)) {
+        r->keep_alive = false;
+    }
+
+    if (KeepAliveTimeout == 0 || ++r->requests >= KeepAliveRequests) {
+        r->keep_alive = false;
+    }
+
+    return 0;
 }
 
 /**
- * Parse HTTP Request Method and URI.
+ * Check if the request buffer holds a complete header block.
  *
  * @param   r           Request structure.
- * @return  -1 on error and 0 on success.
+ * @return  Whether or not the request can be handled (its header block is
+ * complete, or it is malformed).
+ *
+ * Nonblocking server loops call this after every read.  Parsing resumes where
+ * the previous call stopped, so no byte is scanned twice however the request
+ * is split across reads.
+ **/
+bool request_headers_complete(Request *r) {
+    RequestState state = parse_request_buffer(r);
+
+    return state == REQUEST_COMPLETE || state == REQUEST_MALFORMED;
+}
+
+/**
+ * Look up value of known request header.
+ *
+ * @param   r           Request structure.
+ * @param   name        Known header.
+ * @return  Value of first header with name (or NULL if there is none).
+ *
+ * The returned string points into the request buffer and must not be free'd.
+ **/
+const char * request_header(const Request *r, HeaderName name) {
+    return r->known[name].name_length ? r->buffer + r->known[name].value : NULL;
+}
+
+/**
+ * Intern header name.
+ *
+ * @param   name        Header name (case-insensitive).
+ * @param   length      Length of header name.
+ * @return  Known header (or HEADER_UNKNOWN).
+ *
+ * The perfect hash maps every known name to its own slot, so a single
+ * case-insensitive comparison confirms the match.
+ **/
+HeaderName header_lookup(const char *name, size_t length) {
+    uint32_t   hash = HEADER_HASH_SEED;
+    HeaderName header;
+
+    for (size_t i = 0; i < length; i++) {
+        hash = header_hash_step(hash, name[i]);
+    }
+
+    header = HeaderSlots[header_hash_slot(hash)];
+
+    if (header != HEADER_UNKNOWN && HeaderStrings[header].length == length &&
+        strncasecmp(HeaderStrings[header].string, name, length) == 0) {
+        return header;
+    }
+
+    return HEADER_UNKNOWN;
+}
+
+/**
+ * Parse as much of the buffered request as possible.
+ *
+ * @param   r           Request structure.
+ * @return  State of parser after consuming all complete lines.
+ *
+ * The parser is a small state machine over the request buffer.  Each complete
+ * line is terminated in place and handed to the parser for the current state,
+ * and r->offset then moves to the start of the next line.  A partial line is
+ * left in the buffer, and r->scanned remembers how much of it has already
+ * been searched for its end.
  *
  * HTTP Requests come in the form
  *
  *  <METHOD> <URI>[QUERY] HTTP/<VERSION>
+ *  <NAME>: <VALUE>
+ *  ...
+ *  <BLANK LINE>
+ *
+ * The header block must fit in the request buffer and have at most
+ * REQUEST_MAX_HEADERS headers; otherwise the request is malformed.
+ **/
+RequestState parse_request_buffer(Request *r) {
+    while (r->state == REQUEST_LINE || r->state == REQUEST_HEADERS) {
+        char  *line = r->buffer + r->offset;
+        char  *end  = scan_delimiters(line + r->scanned, r->buffer + r->length, "\n");
+        size_t length;
+
+        /* Wait for rest of line */
+        if (!end) {
+            r->scanned = r->length - r->offset;
+
+            if (r->length == sizeof(r->buffer)) {
+                debug("Request header exceeds %zu bytes", sizeof(r->buffer));
+                r->state = REQUEST_MALFORMED;
+            }
+            break;
+        }
+
+        /* Terminate line, removing CRLF */
+        length     = end - line;
+        *end       = '\0';
+        r->offset  = end - r->buffer + 1;
+        r->scanned = 0;
+
+        if (length > 0 && line[length - 1] == '\r') {
+            line[--length] = '\0';
+        }
+
+        /* Dispatch line */
+        if (r->state == REQUEST_LINE) {
+            if (length > 0) {               /* Skip empty lines before request */
+                r->state = parse_request_line(r, line, length) ? REQUEST_HEADERS : REQUEST_MALFORMED;
+            }
+        } else if (length == 0) {
+            r->state = REQUEST_COMPLETE;
+        } else if (!parse_request_header(r, line, length)) {
+            r->state = REQUEST_MALFORMED;
+        }
+    }
+
+    return r->state;
+}
+
+/**
+ * Parse HTTP Request Method and URI.
+ *
+ * @param   r           Request structure.
+ * @param   line        Request line (terminated in place).
+ * @param   length      Length of request line.
+ * @return  Whether or not the request line is valid.
  *
  * Examples:
  *
  *  GET / HTTP/1.1
  *  GET /cgi.script?q=foo HTTP/1.0
  *
- * This function extracts the method, uri, and query (if it exists).
+ * This function extracts the method, uri, and query (which is empty if there
+ * is none) in place, and notes whether the client speaks HTTP/1.1.
  **/
-int parse_request_method(Request *r) {
-    char buffer[BUFSIZ];
-    char *method;
-    char *uri;
-    char *query;
-
-    log("Parsing request method");
-
-    /* Read line from socket */
-    if (!fgets(buffer, BUFSIZ, r->stream)) {
-        goto fail;
+bool parse_request_line(Request *r, char *line, size_t length) {
+    char *cursor = line;
+    char *end    = line + length;
+    char *version;
+    char *uri_end;
+
+    /* Parse method, uri, and version */
+    r->method = parse_request_token(&cursor, end);
+    r->uri    = parse_request_token(&cursor, end);
+    uri_end   = cursor;
+    version   = parse_request_token(&cursor, end);
+
+    if (!r->method || !r->uri) {
+        return false;
     }
 
-    /* Parse method and uri */
-    method = strtok(buffer, WHITESPACE);
-    uri    = strtok(NULL,   WHITESPACE);
-
-    if (!method || !uri) {
-        goto fail;
-    }
+    r->http11 = version && streq(version, "HTTP/1.1");
 
     /* Parse query from uri */
-    query = strchr(uri, '?');
+    r->query = scan_delimiters(r->uri, uri_end, "?");
 
-    if (!query) {
-        query = "";
+    if (!r->query) {
+        r->query = r->uri + strlen(r->uri);
     } else {
-        *query++ = '\0';
+        *r->query++ = '\0';
     }
 
-    /* Record method, uri, and query in request struct */
-    r->method = strdup(method);
-    r->uri    = strdup(uri);
-    r->query  = strdup(query);
-
     debug("HTTP METHOD: %s", r->method);
     debug("HTTP URI:    %s", r->uri);
     debug("HTTP QUERY:  %s", r->query);
+    return true;
+}
 
-    return HTTP_STATUS_OK;
+/**
+ * Extract next whitespace separated token from request line.
+ *
+ * @param   cursor      Pointer to current position in line (advanced past token).
+ * @param   end         End of line.
+ * @return  Token terminated in place (or NULL if there are no more tokens).
+ **/
+char * parse_request_token(char **cursor, char *end) {
+    char *token = *cursor;
+    char *delimiter;
+
+    while (token < end && (*token == ' ' || *token == '\t')) {
+        token++;
+    }
+
+    if (token == end) {
+        return NULL;
+    }
 
-fail:
-    return -1;
+    delimiter = scan_delimiters(token, end, " \t");
+    if (delimiter) {
+        *delimiter = '\0';
+        *cursor    = delimiter + 1;
+    } else {
+        *cursor    = end;
+    }
+
+    return token;
 }
 
 /**
- * Parse HTTP Request Headers.
+ * Parse HTTP Request Header.
  *
  * @param   r           Request structure.
- * @return  -1 on error and 0 on success.
+ * @param   line        Header line (terminated in place).
+ * @param   length      Length of header line.
+ * @return  Whether or not the header is valid.
  *
  * HTTP Headers come in the form:
  *
- *  <NAME>: <DATA>
- *
- * Example:
- *
- *  Host: localhost:8888
- *  User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:29.0) Gecko/20100101 Firefox/29.0
- *  Accept: text/html,application/xhtml+xml
- *  Accept-Language: en-US,en;q=0.5
- *  Accept-Encoding: gzip, deflate
- *  Connection: keep-alive
+ *  <NAME>: <VALUE>
  *
- * This function parses the stream from the request socket using the following
- * pseudo-code:
- *
- *  while (buffer = read_from_socket() and buffer is not empty):
- *      name, data  = buffer.split(':')
- *      header      = new Header(name, data)
- *      headers.append(header)
+ * The name and value (without surrounding whitespace) are terminated in place
+ * and recorded as offsets into the request buffer.  Known headers are stored
+ * by HeaderName (the first one wins if repeated), and all others are appended
+ * to the unknown headers.  Names may not contain whitespace, which also
+ * rejects obsolete line folding.
  **/
-int parse_request_headers(Request *r) {
-    Header *curr = NULL;
-    char buffer[BUFSIZ];
-    char *name;
-    char *data;
-
-    log("Parsing request headers");
-
-    /* Parse headers from socket */
-    while (fgets(buffer, BUFSIZ, r->stream) && strlen(buffer) > 2) {
-        chomp(buffer);
-        name = skip_whitespace(buffer);
-
-        data = strchr(name, ':');
-        if (!data) {
-            goto fail;
-        } else {
-            *data++ = '\0';
-        }
-
-        if (!name) {
-            goto fail;
-        }
+bool parse_request_header(Request *r, char *line, size_t length) {
+    char   *end   = line + length;
+    char   *colon = scan_delimiters(line, end, ": \t");
+    char   *value;
+    Header *header;
+    HeaderName name;
+
+    /* Name must end at colon without any whitespace */
+    if (!colon || *colon != ':' || colon == line) {
+        return false;
+    }
 
-        curr = calloc(1, sizeof(Header));
-        if (!curr) {
-            goto fail;
-        }
+    if (r->nheaders == REQUEST_MAX_HEADERS) {
+        debug("Request has more than %d headers", REQUEST_MAX_HEADERS);
+        return false;
+    }
 
-        curr->name = strdup(name);
-        curr->data = strdup(skip_whitespace(data));
+    /* Trim whitespace around value */
+    for (value = colon + 1; value < end && (*value == ' ' || *value == '\t'); value++);
+    for (; end > value && (end[-1] == ' ' || end[-1] == '\t'); end--);
 
-        curr->next = r->headers;
-        r->headers = curr;
-    }
+    *colon = '\0';
+    *end   = '\0';
 
-    if (!(r->headers)) {
-        goto fail;
-    }
+    name   = header_lookup(line, colon - line);
+    header = name != HEADER_UNKNOWN ? &r->known[name] : &r->unknown[r->nunknown++];
+    r->nheaders++;
 
-#ifndef NDEBUG
-    for (Header *header = r->headers; header; header = header->next) {
-    	debug("HTTP HEADER %s = %s", header->name, header->data);
+    if (header->name_length) {
+        return true;
     }
-#endif
-    return 0;
 
-fail:
-    return -1;
+    header->name         = line  - r->buffer;
+    header->name_length  = colon - line;
+    header->value        = value - r->buffer;
+    header->value_length = end   - value;
+    return true;
 }
 
 /* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,323 @@
+/* respcache.c: Small-Object Response Cache */
+
+#include "server.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#include <unistd.h>
+
+/* Constants */
+
+#define RESPCACHE_BUCKETS       1024    /* Power of two */
+#define RESPCACHE_PROTECTED     80      /* Percent of budget reserved for protected segment */
+
+/* Segment of cache in least recently used order */
+
+typedef struct {
+    CachedResponse *newest;             /*< Most recently used response */
+    CachedResponse *oldest;             /*< Least recently used response */
+    size_t          bytes;              /*< Bytes used by segment */
+} Segment;
+
+/* Cache */
+
+static struct {
+    pthread_mutex_t lock;               /*< Protects everything below */
+    CachedResponse *buckets[RESPCACHE_BUCKETS];
+    Segment         probation;          /*< Responses hit once since insertion */
+    Segment         protected;          /*< Responses hit again while on probation */
+    size_t          hits;               /*< Lookups served from cache */
+    size_t          misses;             /*< Lookups not served from cache */
+} ResponseCache = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/* Internal Declarations */
+CachedResponse * respcache_find(const char *path, uint32_t hash);
+void             respcache_push(Segment *s, CachedResponse *c);
+void             respcache_unlink(Segment *s, CachedResponse *c);
+void             respcache_remove(CachedResponse *c);
+void             respcache_evict(void);
+size_t           respcache_cost(const CachedResponse *c);
+
+/**
+ * Look up cached response for file.
+ *
+ * @param   f           Cached metadata of file.
+ * @return  Referenced response that must be released with respcache_release
+ * (or NULL on miss).
+ *
+ * A response is only used if the file still has the size and modification
+ * time it had when the response was cached.  Stale responses are dropped.
+ *
+ * The cache is a segmented LRU: new responses start on probation and are only
+ * promoted to the protected segment when hit again, so a scan over many files
+ * that are each requested once only churns the probation segment.
+ **/
+CachedResponse * respcache_lookup(const FileEntry *f) {
+    CachedResponse *c;
+
+    if (ResponseCacheBudget == 0) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&ResponseCache.lock);
+
+    c = respcache_find(f->path, f->hash);
+
+    if (c && (c->size != f->size || c->mtime.tv_sec != f->mtime.tv_sec || c->mtime.tv_nsec != f->mtime.tv_nsec)) {
+        respcache_remove(c);
+        c = NULL;
+    }
+
+    if (!c) {
+        ResponseCache.misses++;
+        pthread_mutex_unlock(&ResponseCache.lock);
+        return NULL;
+    }
+
+    /* Promote to (or refresh in) protected segment */
+    respcache_unlink(c->protected ? &ResponseCache.protected : &ResponseCache.probation, c);
+    respcache_push(&ResponseCache.protected, c);
+    c->protected = true;
+
+    /* Demote least recently used protected responses back to probation */
+    while (ResponseCache.protected.bytes > ResponseCacheBudget / 100 * RESPCACHE_PROTECTED &&
+           ResponseCache.protected.oldest != c) {
+        CachedResponse *oldest = ResponseCache.protected.oldest;
+
+        respcache_unlink(&ResponseCache.protected, oldest);
+        respcache_push(&ResponseCache.probation, oldest);
+        oldest->protected = false;
+    }
+
+    c->references++;
+    ResponseCache.hits++;
+    pthread_mutex_unlock(&ResponseCache.lock);
+    return c;
+}
+
+/**
+ * Cache response for file.
+ *
+ * @param   f           Cached metadata of file.
+ * @param   headers     Pre-serialized status line and headers (without the
+ * Connection header and terminating blank line).
+ * @param   length      Length of headers.
+ * @return  Referenced response that must be released with respcache_release
+ * (or NULL if the file is too large or could not be read).
+ **/
+CachedResponse * respcache_insert(const FileEntry *f, const char *headers, size_t length) {
+    CachedResponse *c, *existing;
+    off_t           offset = 0;
+
+    if (ResponseCacheBudget == 0 || f->fd < 0 || (size_t)f->size > ResponseCacheMaxObject) {
+        return NULL;
+    }
+
+    if (!(c = calloc(1, sizeof(CachedResponse)))) {
+        return NULL;
+    }
+
+    c->path          = strdup(f->path);
+    c->hash          = f->hash;
+    c->size          = f->size;
+    c->mtime         = f->mtime;
+    c->header_length = length;
+    c->data          = malloc(length + f->size);
+    c->references    = 2;               /* Cache and caller */
+
+    if (!c->path || !c->data) {
+        goto fail;
+    }
+
+    /* Copy headers and read body */
+    memcpy(c->data, headers, length);
+
+    while (offset < f->size) {
+        ssize_t nread = pread(f->fd, c->data + length + offset, f->size - offset, offset);
+
+        if (nread < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (nread <= 0) {
+            debug("Unable to read %s: %s", f->path, nread < 0 ? strerror(errno) : "file truncated");
+            goto fail;
+        }
+
+        offset += nread;
+    }
+
+    /* Insert on probation unless another request beat us to it */
+    pthread_mutex_lock(&ResponseCache.lock);
+
+    if ((existing = respcache_find(c->path, c->hash))) {
+        respcache_remove(existing);
+    }
+
+    c->next = ResponseCache.buckets[c->hash & (RESPCACHE_BUCKETS - 1)];
+    ResponseCache.buckets[c->hash & (RESPCACHE_BUCKETS - 1)] = c;
+    respcache_push(&ResponseCache.probation, c);
+    respcache_evict();
+
+    pthread_mutex_unlock(&ResponseCache.lock);
+    return c;
+
+fail:
+    free(c->path);
+    free(c->data);
+    free(c);
+    return NULL;
+}
+
+/**
+ * Release reference to response, freeing it once it is no longer used.
+ *
+ * @param   c           Response returned by respcache_lookup or respcache_insert.
+ **/
+void respcache_release(CachedResponse *c) {
+    size_t references;
+
+    if (!c) {
+        return;
+    }
+
+    pthread_mutex_lock(&ResponseCache.lock);
+    references = --c->references;
+    pthread_mutex_unlock(&ResponseCache.lock);
+
+    if (references == 0) {
+        free(c->path);
+        free(c->data);
+        free(c);
+    }
+}
+
+/**
+ * Report cache counters.
+ *
+ * @param   hits        Pointer to number of lookups served from cache.
+ * @param   misses      Pointer to number of lookups not served from cache.
+ * @param   bytes       Pointer to number of bytes cached.
+ **/
+void respcache_stats(size_t *hits, size_t *misses, size_t *bytes) {
+    pthread_mutex_lock(&ResponseCache.lock);
+    *hits   = ResponseCache.hits;
+    *misses = ResponseCache.misses;
+    *bytes  = ResponseCache.probation.bytes + ResponseCache.protected.bytes;
+    pthread_mutex_unlock(&ResponseCache.lock);
+}
+
+/**
+ * Find cached response for path (lock must be held).
+ *
+ * @param   path        Resolved path of file.
+ * @param   hash        Hash of path.
+ * @return  Cached response (or NULL if path is not cached).
+ **/
+CachedResponse * respcache_find(const char *path, uint32_t hash) {
+    for (CachedResponse *c = ResponseCache.buckets[hash & (RESPCACHE_BUCKETS - 1)]; c; c = c->next) {
+        if (c->hash == hash && streq(c->path, path)) {
+            return c;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Link response in front of segment (lock must be held).
+ *
+ * @param   s           Segment.
+ * @param   c           Response.
+ **/
+void respcache_push(Segment *s, CachedResponse *c) {
+    c->newer = NULL;
+    c->older = s->newest;
+
+    if (s->newest) {
+        s->newest->newer = c;
+    } else {
+        s->oldest = c;
+    }
+
+    s->newest = c;
+    s->bytes += respcache_cost(c);
+}
+
+/**
+ * Unlink response from segment (lock must be held).
+ *
+ * @param   s           Segment.
+ * @param   c           Response.
+ **/
+void respcache_unlink(Segment *s, CachedResponse *c) {
+    if (c->newer) {
+        c->newer->older = c->older;
+    } else {
+        s->newest = c->older;
+    }
+
+    if (c->older) {
+        c->older->newer = c->newer;
+    } else {
+        s->oldest = c->newer;
+    }
+
+    c->newer = c->older = NULL;
+    s->bytes -= respcache_cost(c);
+}
+
+/**
+ * Remove response from cache (lock must be held).
+ *
+ * @param   c           Response.
+ *
+ * The cache's reference is dropped here, but the response itself is only
+ * free'd once requests still sending it have released it.
+ **/
+void respcache_remove(CachedResponse *c) {
+    CachedResponse **p = &ResponseCache.buckets[c->hash & (RESPCACHE_BUCKETS - 1)];
+
+    while (*p != c) {
+        p = &(*p)->next;
+    }
+    *p = c->next;
+
+    respcache_unlink(c->protected ? &ResponseCache.protected : &ResponseCache.probation, c);
+
+    if (--c->references == 0) {
+        free(c->path);
+        free(c->data);
+        free(c);
+    }
+}
+
+/**
+ * Evict responses until cache fits in its budget (lock must be held).
+ *
+ * Responses on probation are evicted first, so that protected responses are
+ * only evicted once the probation segment is empty.
+ **/
+void respcache_evict(void) {
+    while (ResponseCache.probation.bytes + ResponseCache.protected.bytes > ResponseCacheBudget) {
+        CachedResponse *oldest = ResponseCache.probation.oldest ? ResponseCache.probation.oldest
+                                                                : ResponseCache.protected.oldest;
+
+        debug("Evicting %s from response cache", oldest->path);
+        respcache_remove(oldest);
+    }
+}
+
+/**
+ * Determine number of bytes charged to budget for response.
+ *
+ * @param   c           Response.
+ * @return  Bytes used by response.
+ **/
+size_t respcache_cost(const CachedResponse *c) {
+    return sizeof(CachedResponse) + c->header_length + c->size;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
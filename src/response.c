@@ -0,0 +1,185 @@
+/* response.c: HTTP Response Builder */
+
+#include "server.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <time.h>
+
+/* Constants */
+
+#define RESPONSE_SERVER         "c_server"
+#define RESPONSE_RESERVE        128     /* Room kept for the lines response_finish appends */
+
+/* Date and Server Header Lines (rendered at most once a second per thread) */
+
+static __thread struct {
+    time_t  now;                        /*< Second the lines were rendered for */
+    char    lines[96];                  /*< Date and Server header lines */
+    size_t  length;                     /*< Length of lines */
+} ResponseDate;
+
+/* Internal Declarations */
+void        response_append(Response *p, const char *data, size_t length, size_t limit);
+
+/**
+ * Begin response with status line.
+ *
+ * @param   p           Response.
+ * @param   status      HTTP status string (ie. "200 OK").
+ **/
+void response_status(Response *p, const char *status) {
+    p->length = 0;
+    response_append(p, "HTTP/1.1 ", 9, sizeof(p->data));
+    response_append(p, status, strlen(status), sizeof(p->data));
+    response_append(p, "\r\n", 2, sizeof(p->data));
+}
+
+/**
+ * Append header line to response.
+ *
+ * @param   p           Response.
+ * @param   name        Name of header.
+ * @param   value       Value of header.
+ *
+ * Header lines that do not fit are dropped.
+ **/
+void response_header(Response *p, const char *name, const char *value) {
+    size_t nlength = strlen(name);
+    size_t vlength = strlen(value);
+    size_t limit   = sizeof(p->data) - RESPONSE_RESERVE;
+
+    if (p->length + nlength + vlength + 4 > limit) {
+        debug("Dropping %s header from full response", name);
+        return;
+    }
+
+    response_append(p, name, nlength, limit);
+    response_append(p, ": ", 2, limit);
+    response_append(p, value, vlength, limit);
+    response_append(p, "\r\n", 2, limit);
+}
+
+/**
+ * Append Content-Length header line to response.
+ *
+ * @param   p           Response.
+ * @param   length      Length of body.
+ **/
+void response_length(Response *p, off_t length) {
+    char  digits[24];
+    char *d = digits + sizeof(digits);
+
+    *--d = '\0';
+    do {
+        *--d = '0' + length % 10;
+        length /= 10;
+    } while (length > 0);
+
+    response_header(p, "Content-Length", d);
+}
+
+/**
+ * Append preformatted header lines to response.
+ *
+ * @param   p           Response.
+ * @param   lines       CRLF terminated header lines (or NULL).
+ *
+ * Lines that do not fit are dropped.
+ **/
+void response_lines(Response *p, const char *lines) {
+    size_t limit = sizeof(p->data) - RESPONSE_RESERVE;
+
+    while (lines && *lines) {
+        const char *end = strstr(lines, "\r\n");
+        size_t      length = end ? (size_t)(end - lines) + 2 : strlen(lines);
+
+        if (p->length + length > limit) {
+            debug("Dropping header lines from full response");
+            return;
+        }
+
+        response_append(p, lines, length, limit);
+        lines += length;
+    }
+}
+
+/**
+ * Finish response with general header lines and end of header block.
+ *
+ * @param   p           Response (may be empty to render only these lines).
+ * @param   keep_alive  Whether connection persists after response.
+ *
+ * The Date and Server lines are only rendered again once a second, so most
+ * responses just copy them.
+ **/
+void response_finish(Response *p, bool keep_alive) {
+    time_t      now        = time(NULL);
+    const char *connection = keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+
+    if (ResponseDate.now != now || ResponseDate.length == 0) {
+        char date[32];
+
+        format_http_date(now, date, sizeof(date));
+        ResponseDate.length = snprintf(ResponseDate.lines, sizeof(ResponseDate.lines),
+                                       "Date: %s\r\nServer: %s\r\n", date, RESPONSE_SERVER);
+        ResponseDate.now    = now;
+    }
+
+    response_append(p, ResponseDate.lines, ResponseDate.length, sizeof(p->data));
+    response_append(p, connection, strlen(connection), sizeof(p->data));
+}
+
+/**
+ * Send finished response headers followed by body.
+ *
+ * @param   r           HTTP Request structure.
+ * @param   p           Finished response.
+ * @param   body        Body of response (or NULL).
+ * @param   length      Length of body.
+ * @return  Whether or not the response was sent.
+ *
+ * On blocking connections, the headers and body leave in a single writev.
+ * Otherwise, they are copied to the stream for the server loop to send.
+ **/
+bool response_send(Request *r, const Response *p, const void *body, size_t length) {
+    struct iovec iov[] = {
+        { (void *)p->data, p->length },
+        { (void *)body,    body ? length : 0 },
+    };
+
+    if (r->defer_body) {
+        fwrite(iov[0].iov_base, 1, iov[0].iov_len, r->stream);
+        fwrite(iov[1].iov_base, 1, iov[1].iov_len, r->stream);
+        return true;
+    }
+
+    /* Anything already on the stream goes first */
+    fflush(r->stream);
+
+    if (socket_writev(r->fd, iov, iov[1].iov_len ? 2 : 1) < 0) {
+        debug("Unable to writev: %s", strerror(errno));
+        r->keep_alive = false;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Append bytes to response if they fit.
+ *
+ * @param   p           Response.
+ * @param   data        Bytes to append.
+ * @param   length      Number of bytes.
+ * @param   limit       Length response may not exceed.
+ **/
+void response_append(Response *p, const char *data, size_t length, size_t limit) {
+    if (p->length + length <= limit) {
+        memcpy(p->data + p->length, data, length);
+        p->length += length;
+    }
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
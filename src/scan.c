@@ -0,0 +1,170 @@
+/* scan.c: Vectorized Delimiter Scanning */
+
+#include "server.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+/* Constants */
+
+#define SCAN_MAX_DELIMITERS 4
+
+/* Internal Declarations */
+typedef char *(*Scanner)(const char *start, const char *end, const char *set);
+
+char * scan_scalar(const char *start, const char *end, const char *set);
+char * scan_resolve(const char *start, const char *end, const char *set);
+#ifdef SCAN_X86
+char * scan_sse42(const char *start, const char *end, const char *set) __attribute__((target("sse4.2")));
+char * scan_avx2(const char *start, const char *end, const char *set)  __attribute__((target("avx2")));
+#endif
+
+/* Implementation chosen for this CPU (resolved on first use) */
+static Scanner ScanImplementation = scan_resolve;
+
+/**
+ * Find first delimiter in buffer.
+ *
+ * @param   start       Start of buffer.
+ * @param   end         End of buffer.
+ * @param   set         Delimiters to look for (at most SCAN_MAX_DELIMITERS).
+ * @return  Pointer to first delimiter (or NULL if there is none).
+ *
+ * This compares 32 bytes at a time with AVX2, or 16 bytes at a time with
+ * SSE4.2, depending on what the CPU supports, and otherwise falls back to a
+ * scalar loop.  Only whole blocks inside the buffer are loaded, so the tail is
+ * always finished by the scalar loop and nothing past end is ever read.
+ **/
+char * scan_delimiters(const char *start, const char *end, const char *set) {
+    return ScanImplementation(start, end, set);
+}
+
+/**
+ * Choose scanner for this CPU and scan with it.
+ *
+ * @param   start       Start of buffer.
+ * @param   end         End of buffer.
+ * @param   set         Delimiters to look for.
+ * @return  Pointer to first delimiter (or NULL if there is none).
+ *
+ * Concurrent first calls may all resolve, but they store the same scanner.
+ **/
+char * scan_resolve(const char *start, const char *end, const char *set) {
+    Scanner     scanner = scan_scalar;
+    const char *name    = "scalar loop";
+
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        scanner = scan_avx2;
+        name    = "AVX2";
+    } else if (__builtin_cpu_supports("sse4.2")) {
+        scanner = scan_sse42;
+        name    = "SSE4.2";
+    }
+#endif
+
+    debug("Scanning delimiters with %s", name);
+    __atomic_store_n(&ScanImplementation, scanner, __ATOMIC_RELAXED);
+    return scanner(start, end, set);
+}
+
+/**
+ * Find first delimiter in buffer one byte at a time.
+ *
+ * @param   start       Start of buffer.
+ * @param   end         End of buffer.
+ * @param   set         Delimiters to look for.
+ * @return  Pointer to first delimiter (or NULL if there is none).
+ **/
+char * scan_scalar(const char *start, const char *end, const char *set) {
+    for (const char *p = start; p < end; p++) {
+        for (const char *s = set; *s; s++) {
+            if (*p == *s) {
+                return (char *)p;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+#ifdef SCAN_X86
+
+/**
+ * Find first delimiter in buffer 16 bytes at a time with SSE4.2.
+ *
+ * @param   start       Start of buffer.
+ * @param   end         End of buffer.
+ * @param   set         Delimiters to look for.
+ * @return  Pointer to first delimiter (or NULL if there is none).
+ *
+ * PCMPESTRI compares every byte of a block against every delimiter at once
+ * and yields the index of the first match (or 16 if there is none).
+ **/
+char * scan_sse42(const char *start, const char *end, const char *set) {
+    char        delimiters[16] = {0};
+    int         ndelimiters    = strlen(set);
+    const char *p              = start;
+
+    memcpy(delimiters, set, ndelimiters);
+    __m128i needles = _mm_loadu_si128((const __m128i *)delimiters);
+
+    for (; end - p >= 16; p += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)p);
+        int     index = _mm_cmpestri(needles, ndelimiters, block, 16,
+                                     _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+
+        if (index < 16) {
+            return (char *)p + index;
+        }
+    }
+
+    return scan_scalar(p, end, set);
+}
+
+/**
+ * Find first delimiter in buffer 32 bytes at a time with AVX2.
+ *
+ * @param   start       Start of buffer.
+ * @param   end         End of buffer.
+ * @param   set         Delimiters to look for.
+ * @return  Pointer to first delimiter (or NULL if there is none).
+ *
+ * Each block is compared against every delimiter broadcast into a register,
+ * and the first set bit of the combined byte mask locates the first match.
+ **/
+char * scan_avx2(const char *start, const char *end, const char *set) {
+    __m256i     needles[SCAN_MAX_DELIMITERS];
+    size_t      ndelimiters = 0;
+    const char *p           = start;
+
+    for (; set[ndelimiters] && ndelimiters < SCAN_MAX_DELIMITERS; ndelimiters++) {
+        needles[ndelimiters] = _mm256_set1_epi8(set[ndelimiters]);
+    }
+
+    for (; end - p >= 32; p += 32) {
+        __m256i  block   = _mm256_loadu_si256((const __m256i *)p);
+        __m256i  matches = _mm256_cmpeq_epi8(block, needles[0]);
+
+        for (size_t i = 1; i < ndelimiters; i++) {
+            matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(block, needles[i]));
+        }
+
+        uint32_t mask = _mm256_movemask_epi8(matches);
+        if (mask) {
+            return (char *)p + __builtin_ctz(mask);
+        }
+    }
+
+    return scan_sse42(p, end, set);
+}
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
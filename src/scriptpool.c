@@ -0,0 +1,356 @@
+/* scriptpool.c: Persistent Script Worker Pool */
+
+#include "server.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Pool of Workers for one Script */
+
+typedef struct script_pool ScriptPool;
+struct script_pool {
+    char           *path;               /*< Resolved path of script */
+    ScriptWorker   *workers;            /*< ScriptWorkers worker slots (pid 0 if empty) */
+    size_t          queued;             /*< Requests waiting for an idle worker */
+    pthread_cond_t  available;          /*< Signaled when a worker becomes idle */
+    ScriptPool     *next;               /*< Next pool */
+};
+
+/* Pools */
+
+static struct {
+    pthread_mutex_t lock;               /*< Protects everything below */
+    ScriptPool     *pools;              /*< Pools by script */
+} ScriptPools = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/* Internal Declarations */
+ScriptPool * scriptpool_find(const char *path);
+bool         scriptpool_spawn(ScriptPool *p, ScriptWorker *w);
+void         scriptpool_retire(pid_t pid, int fd);
+bool         scriptpool_write(int fd, const void *data, size_t length);
+bool         scriptpool_read(int fd, void *data, size_t length);
+
+/**
+ * Determine whether script is served by persistent workers.
+ *
+ * @param   path        Resolved path of executable.
+ * @return  Whether or not the path has ScriptWorkerExtension.
+ **/
+bool scriptpool_handles(const char *path) {
+    const char *ext = strrchr(path, '.');
+
+    return ScriptWorkerLauncher && ScriptWorkerExtension && ext && !strchr(ext, '/') &&
+           streq(ext + 1, ScriptWorkerExtension);
+}
+
+/**
+ * Acquire idle worker for script.
+ *
+ * @param   path        Resolved path of script.
+ * @return  Busy worker that must be returned with scriptpool_release (or NULL
+ * with errno set to EAGAIN if ScriptQueueLimit requests are already waiting).
+ *
+ * Workers are spawned lazily, up to ScriptWorkers per script.  Once they are
+ * all busy, requests wait for one to become idle.
+ **/
+ScriptWorker * scriptpool_acquire(const char *path) {
+    ScriptPool   *p;
+    ScriptWorker *w = NULL;
+
+    pthread_mutex_lock(&ScriptPools.lock);
+
+    if (!(p = scriptpool_find(path))) {
+        pthread_mutex_unlock(&ScriptPools.lock);
+        return NULL;
+    }
+
+    while (!w) {
+        ScriptWorker *empty = NULL;
+
+        /* Find idle worker (or empty slot) */
+        for (size_t i = 0; i < ScriptWorkers && !w; i++) {
+            if (p->workers[i].pid > 0 && !p->workers[i].busy) {
+                w = &p->workers[i];
+            } else if (p->workers[i].pid == 0 && !empty) {
+                empty = &p->workers[i];
+            }
+        }
+
+        if (w) {
+            break;
+        }
+
+        /* Spawn worker into empty slot */
+        if (empty) {
+            if (!scriptpool_spawn(p, empty)) {
+                pthread_mutex_unlock(&ScriptPools.lock);
+                return NULL;
+            }
+            w = empty;
+            break;
+        }
+
+        /* Wait for worker (unless queue is full) */
+        if (p->queued >= ScriptQueueLimit) {
+            debug("Script worker queue for %s is full", path);
+            pthread_mutex_unlock(&ScriptPools.lock);
+            errno = EAGAIN;
+            return NULL;
+        }
+
+        p->queued++;
+        pthread_cond_wait(&p->available, &ScriptPools.lock);
+        p->queued--;
+    }
+
+    w->busy = true;
+    pthread_mutex_unlock(&ScriptPools.lock);
+    return w;
+}
+
+/**
+ * Return worker to its pool.
+ *
+ * @param   w           Worker returned by scriptpool_acquire.
+ * @param   reusable    Whether the worker completed its request cleanly.
+ *
+ * Workers that failed or have served ScriptMaxRequests requests are retired,
+ * and their slot is refilled on demand.
+ **/
+void scriptpool_release(ScriptWorker *w, bool reusable) {
+    pid_t pid = 0;
+    int   fd  = -1;
+
+    pthread_mutex_lock(&ScriptPools.lock);
+
+    w->requests++;
+    if (!reusable || (ScriptMaxRequests > 0 && w->requests >= ScriptMaxRequests)) {
+        debug("Retiring script worker %d after %zu requests", w->pid, w->requests);
+        pid         = w->pid;
+        fd          = w->fd;
+        w->pid      = 0;
+        w->fd       = -1;
+        w->requests = 0;
+    }
+
+    w->busy = false;
+    pthread_cond_signal(&w->pool->available);
+    pthread_mutex_unlock(&ScriptPools.lock);
+
+    if (pid > 0) {
+        scriptpool_retire(pid, fd);
+    }
+}
+
+/**
+ * Send request to worker and wait for its response.
+ *
+ * @param   w           Busy worker.
+ * @param   envp        CGI environment (NULL terminated).
+ * @param   timeout     Milliseconds to wait for the response (-1 for no limit).
+ * @return  Length of CGI output that follows on w->fd (or -1 on failure, with
+ * errno set to ETIMEDOUT if the worker did not respond in time).
+ *
+ * Frames are a native-endian 32-bit length followed by that many bytes.  A
+ * request is one frame of NUL terminated NAME=VALUE strings, and the response
+ * is one frame with the script's complete CGI output.
+ **/
+ssize_t scriptpool_request(ScriptWorker *w, char **envp, int timeout) {
+    struct pollfd pfd    = { .fd = w->fd, .events = POLLIN };
+    uint32_t      length = 0;
+
+    for (char **e = envp; *e; e++) {
+        length += strlen(*e) + 1;
+    }
+
+    if (!scriptpool_write(w->fd, &length, sizeof(length))) {
+        return -1;
+    }
+
+    for (char **e = envp; *e; e++) {
+        if (!scriptpool_write(w->fd, *e, strlen(*e) + 1)) {
+            return -1;
+        }
+    }
+
+    if (poll(&pfd, 1, timeout) == 0) {
+        debug("Script worker %d timed out", w->pid);
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    if (!scriptpool_read(w->fd, &length, sizeof(length))) {
+        return -1;
+    }
+
+    return length;
+}
+
+/**
+ * Find or create pool for script (lock must be held).
+ *
+ * @param   path        Resolved path of script.
+ * @return  Pool (or NULL on allocation failure).
+ **/
+ScriptPool * scriptpool_find(const char *path) {
+    ScriptPool *p;
+
+    for (p = ScriptPools.pools; p; p = p->next) {
+        if (streq(p->path, path)) {
+            return p;
+        }
+    }
+
+    if (!(p = calloc(1, sizeof(ScriptPool)))) {
+        return NULL;
+    }
+
+    p->path    = strdup(path);
+    p->workers = calloc(ScriptWorkers, sizeof(ScriptWorker));
+
+    if (!p->path || !p->workers) {
+        free(p->path);
+        free(p->workers);
+        free(p);
+        return NULL;
+    }
+
+    pthread_cond_init(&p->available, NULL);
+    p->next           = ScriptPools.pools;
+    ScriptPools.pools = p;
+    return p;
+}
+
+/**
+ * Spawn worker for script (lock must be held).
+ *
+ * @param   p           Pool of script.
+ * @param   w           Empty worker slot.
+ * @return  Whether or not the worker was started.
+ *
+ * The worker runs ScriptWorkerLauncher with the script's path as its argument
+ * and talks to us over a Unix socket on its standard input.  It should exit
+ * once that socket is closed.
+ **/
+bool scriptpool_spawn(ScriptPool *p, ScriptWorker *w) {
+    char *envp[] = {NULL, NULL};
+    int   sv[2];
+    pid_t pid;
+
+    /* Workers only inherit PATH (requests carry their own environment) */
+    if (getenv("PATH") && asprintf(&envp[0], "PATH=%s", getenv("PATH")) < 0) {
+        envp[0] = NULL;
+    }
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+        debug("Unable to socketpair: %s", strerror(errno));
+        free(envp[0]);
+        return false;
+    }
+
+    pid = fork();
+
+    if (pid < 0) {                              /* Error */
+        debug("Unable to fork: %s", strerror(errno));
+        close(sv[0]);
+        close(sv[1]);
+        free(envp[0]);
+        return false;
+    }
+
+    if (pid == 0) {                             /* Child */
+        char *argv[] = {ScriptWorkerLauncher, p->path, NULL};
+
+        dup2(sv[1], STDIN_FILENO);
+        execve(argv[0], argv, envp);
+        _exit(EXIT_FAILURE);
+    }
+
+    close(sv[1]);
+    free(envp[0]);
+    debug("Spawned script worker %d for %s", pid, p->path);
+
+    w->pool     = p;
+    w->pid      = pid;
+    w->fd       = sv[0];
+    w->requests = 0;
+    w->busy     = false;
+    return true;
+}
+
+/**
+ * Stop retired worker.
+ *
+ * @param   pid         Process id of worker.
+ * @param   fd          Socket connected to worker.
+ **/
+void scriptpool_retire(pid_t pid, int fd) {
+    close(fd);
+    kill(pid, SIGTERM);
+    while (waitpid(pid, NULL, 0) < 0 && errno == EINTR);
+}
+
+/**
+ * Write all of buffer to worker.
+ *
+ * @param   fd          Socket connected to worker.
+ * @param   data        Buffer.
+ * @param   length      Length of buffer.
+ * @return  Whether or not the buffer was written.
+ **/
+bool scriptpool_write(int fd, const void *data, size_t length) {
+    while (length > 0) {
+        ssize_t nwritten = send(fd, data, length, MSG_NOSIGNAL);
+
+        if (nwritten < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (nwritten <= 0) {
+            debug("Unable to write to script worker: %s", strerror(errno));
+            return false;
+        }
+
+        data    = (const char *)data + nwritten;
+        length -= nwritten;
+    }
+
+    return true;
+}
+
+/**
+ * Read exactly length bytes from worker.
+ *
+ * @param   fd          Socket connected to worker.
+ * @param   data        Buffer.
+ * @param   length      Number of bytes to read.
+ * @return  Whether or not the bytes were read.
+ **/
+bool scriptpool_read(int fd, void *data, size_t length) {
+    while (length > 0) {
+        ssize_t nread = read(fd, data, length);
+
+        if (nread < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (nread <= 0) {
+            debug("Unable to read from script worker: %s", nread < 0 ? strerror(errno) : "worker exited");
+            return false;
+        }
+
+        data    = (char *)data + nread;
+        length -= nread;
+    }
+
+    return true;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
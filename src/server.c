@@ -3,6 +3,8 @@
 #include "server.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <string.h>
 
@@ -13,6 +15,33 @@ char *Port	      = "22222";
 char *MimeTypesPath   = "/afs/crc.nd.edu/user/r/rdestefa/Public/mime.types";
 char *DefaultMimeType = "text/plain";
 char *RootPath	      = "www";
+int   RootFd          = -1;
+size_t Workers        = 4;
+size_t MaxRequests    = 0;
+size_t Acceptors      = 1;
+int    KeepAliveTimeout  = 5;
+size_t KeepAliveRequests = 100;
+int    FileCacheTTL      = 10;
+size_t ResponseCacheBudget    = 16 << 20;
+size_t ResponseCacheMaxObject = 64 << 10;
+size_t CompressCacheBudget    = 8 << 20;
+size_t CompressMaxObject      = 1 << 20;
+char  *ScriptWorkerLauncher   = NULL;
+char  *ScriptWorkerExtension  = NULL;
+size_t ScriptWorkers          = 2;
+size_t ScriptMaxRequests      = 1000;
+size_t ScriptQueueLimit       = 64;
+int    CGITimeout             = 30;
+char  *StatusPath             = "/server-status";
+int    DeferAccept            = 0;
+int    FastOpenQueue          = 0;
+LogLevel LogVerbosity         = LOG_LEVEL_DEBUG;
+char  *AccessLogPath          = NULL;
+bool   AccessLogCombined      = false;
+char  *TracePath              = NULL;
+size_t TraceSampleRate        = 0;
+
+static const char *ModeNames[] = {"Single", "Forking", "Event", "Prefork", "Threaded", "Uring"};
 
 /**
  * Display usage message and exit with specified status code.
@@ -21,14 +50,37 @@ char *RootPath	      = "www";
  * @param   status      Exit status.
  */
 void usage(const char *progname, int status) {
-    fprintf(stderr, "Usage: %s [hcmMpr]\n", progname);
+    fprintf(stderr, "Usage: %s [haABCcDFfKkLlmMnpQRrSsTtWwXZz]\n", progname);
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "    -h            Display help message\n");
-    fprintf(stderr, "    -c mode       Single or Forking mode\n");
+    fprintf(stderr, "    -a acceptors  Number of acceptor threads\n");
+    fprintf(stderr, "    -A path       Access log (- for standard output)\n");
+    fprintf(stderr, "    -B bytes      Response cache budget (0 disables cache)\n");
+    fprintf(stderr, "    -C seconds    File metadata cache TTL (0 disables cache)\n");
+    fprintf(stderr, "    -c mode       Single, Forking, Event, Prefork, Threaded, or Uring mode\n");
+    fprintf(stderr, "    -D seconds    Accept clients only once request data arrives (TCP_DEFER_ACCEPT)\n");
+    fprintf(stderr, "    -F length     TCP Fast Open queue length (0 disables Fast Open)\n");
+    fprintf(stderr, "    -f format     Access log format: Common or Combined\n");
+    fprintf(stderr, "    -k seconds    Keep-alive idle timeout (0 disables keep-alive)\n");
+    fprintf(stderr, "    -K requests   Maximum requests per keep-alive connection\n");
+    fprintf(stderr, "    -L bytes      Largest file kept in response cache\n");
+    fprintf(stderr, "    -l level      Most verbose messages logged: Fatal, Log, or Debug\n");
     fprintf(stderr, "    -m path       Path to mimetypes file\n");
     fprintf(stderr, "    -M mimetype   Default mimetype\n");
+    fprintf(stderr, "    -n workers    Number of workers (helper threads for CGI in event and uring modes)\n");
     fprintf(stderr, "    -p port       Port to listen on\n");
+    fprintf(stderr, "    -Q requests   Requests allowed to wait for a script worker\n");
+    fprintf(stderr, "    -R requests   Requests per worker before recycling\n");
     fprintf(stderr, "    -r path       Root directory\n");
+    fprintf(stderr, "    -S path       URI of metrics endpoint (empty disables endpoint)\n");
+    fprintf(stderr, "    -s rate       Trace one in rate requests (defaults to every request with -t)\n");
+    fprintf(stderr, "    -T seconds    CGI execution timeout (0 disables timeout)\n");
+    fprintf(stderr, "    -t path       Trace file in Chrome trace event format (- for standard output)\n");
+    fprintf(stderr, "    -W workers    Persistent workers per script\n");
+    fprintf(stderr, "    -w ext=path   Serve scripts with extension through persistent workers running path\n");
+    fprintf(stderr, "    -X requests   Requests per script worker before recycling\n");
+    fprintf(stderr, "    -Z bytes      Compressed response cache budget (0 disables compression)\n");
+    fprintf(stderr, "    -z bytes      Largest file compressed on the fly\n");
     exit(status);
 }
 
@@ -40,19 +92,59 @@ void usage(const char *progname, int status) {
  * @param   mode        Pointer to ServerMode variable.
  * @return  true if parsing was successful, false if there was an error.
  *
- * This should set the mode, MimeTypesPath, DefaultMimeType, Port, and RootPath
- * if specified.
+ * This should set the mode, MimeTypesPath, DefaultMimeType, Port, RootPath,
+ * Workers, MaxRequests, Acceptors, KeepAliveTimeout, KeepAliveRequests,
+ * FileCacheTTL, ResponseCacheBudget, and ResponseCacheMaxObject if specified.
  */
 bool parse_options(int argc, char *argv[], ServerMode *mode) {
     int argind = 1;
     while (argind < argc && strlen(argv[argind]) > 1 && argv[argind][0] == '-') {
         char *arg = argv[argind++];
     	switch (arg[1]) {
+	    case 'a':
+	    	Acceptors = strtoul(argv[argind++], NULL, 10);
+	    	if (Acceptors == 0) {
+	    	    return false;
+	    	}
+	    	break;
+	    case 'A':
+	    	AccessLogPath = argv[argind++];
+	    	break;
+	    case 'B':
+	    	ResponseCacheBudget = strtoul(argv[argind++], NULL, 10);
+	    	break;
+	    case 'C':
+	    	FileCacheTTL = atoi(argv[argind++]);
+	    	break;
 	    case 'c':
 	    	if (streq(argv[argind], "single")) {
 	    	    *mode = SINGLE;
                 } else if (streq(argv[argind], "forking")) {
 	    	    *mode = FORKING;
+                } else if (streq(argv[argind], "event")) {
+                    *mode = EVENT;
+                } else if (streq(argv[argind], "prefork")) {
+                    *mode = PREFORK;
+                } else if (streq(argv[argind], "threaded")) {
+                    *mode = THREADED;
+                } else if (streq(argv[argind], "uring")) {
+                    *mode = URING;
+	    	} else {
+	    	    return false;
+	    	}
+	    	argind++;
+	    	break;
+	    case 'D':
+	    	DeferAccept = atoi(argv[argind++]);
+	    	break;
+	    case 'F':
+	    	FastOpenQueue = atoi(argv[argind++]);
+	    	break;
+	    case 'f':
+	    	if (streq(argv[argind], "common")) {
+	    	    AccessLogCombined = false;
+	    	} else if (streq(argv[argind], "combined")) {
+	    	    AccessLogCombined = true;
 	    	} else {
 	    	    return false;
 	    	}
@@ -61,24 +153,94 @@ bool parse_options(int argc, char *argv[], ServerMode *mode) {
 	    case 'h':
 	    	usage(argv[0], EXIT_SUCCESS);
 	    	break;
+	    case 'k':
+	    	KeepAliveTimeout = atoi(argv[argind++]);
+	    	break;
+	    case 'K':
+	    	KeepAliveRequests = strtoul(argv[argind++], NULL, 10);
+	    	break;
+	    case 'L':
+	    	ResponseCacheMaxObject = strtoul(argv[argind++], NULL, 10);
+	    	break;
+	    case 'l':
+	    	if (streq(argv[argind], "fatal")) {
+	    	    LogVerbosity = LOG_LEVEL_FATAL;
+	    	} else if (streq(argv[argind], "log")) {
+	    	    LogVerbosity = LOG_LEVEL_LOG;
+	    	} else if (streq(argv[argind], "debug")) {
+	    	    LogVerbosity = LOG_LEVEL_DEBUG;
+	    	} else {
+	    	    return false;
+	    	}
+	    	argind++;
+	    	break;
 	    case 'm':
 	    	MimeTypesPath = argv[argind++];
 	    	break;
 	    case 'M':
 	    	DefaultMimeType = argv[argind++];
 	    	break;
+	    case 'n':
+	    	Workers = strtoul(argv[argind++], NULL, 10);
+	    	if (Workers == 0) {
+	    	    return false;
+	    	}
+	    	break;
 	    case 'p':
 	    	Port = argv[argind++];
 	    	break;
+	    case 'Q':
+	    	ScriptQueueLimit = strtoul(argv[argind++], NULL, 10);
+	    	break;
+	    case 'R':
+	    	MaxRequests = strtoul(argv[argind++], NULL, 10);
+	    	break;
 	    case 'r':
 	    	RootPath = argv[argind++];
 	    	break;
+	    case 'S':
+	    	StatusPath = argv[argind++];
+	    	break;
+	    case 's':
+	    	TraceSampleRate = strtoul(argv[argind++], NULL, 10);
+	    	break;
+	    case 'T':
+	    	CGITimeout = atoi(argv[argind++]);
+	    	break;
+	    case 't':
+	    	TracePath = argv[argind++];
+	    	break;
+	    case 'W':
+	    	ScriptWorkers = strtoul(argv[argind++], NULL, 10);
+	    	break;
+	    case 'w':
+	    	ScriptWorkerExtension = argv[argind++];
+	    	ScriptWorkerLauncher  = strchr(ScriptWorkerExtension, '=');
+	    	if (!ScriptWorkerLauncher) {
+	    	    return false;
+	    	}
+	    	*ScriptWorkerLauncher++ = '\0';
+	    	break;
+	    case 'X':
+	    	ScriptMaxRequests = strtoul(argv[argind++], NULL, 10);
+	    	break;
+	    case 'Z':
+	    	CompressCacheBudget = strtoul(argv[argind++], NULL, 10);
+	    	break;
+	    case 'z':
+	    	CompressMaxObject = strtoul(argv[argind++], NULL, 10);
+	    	break;
 	    default:
 	        return false;
 	    	break;
 	}
     }
 
+    /* Persistent workers need at least one worker per script (-W may follow -w) */
+    if (ScriptWorkerLauncher && ScriptWorkers == 0) {
+        return false;
+    }
+
     return true;
 }
 
@@ -94,6 +256,33 @@ int main(int argc, char *argv[]) {
         usage(argv[0], EXIT_FAILURE);
     }
 
+    /* Open access log */
+    if (AccessLogPath && !log_open(LOG_LEVEL_ACCESS, AccessLogPath)) {
+        fatal("Could not open access log %s: %s", AccessLogPath, strerror(errno));
+    }
+
+    /* Open trace file (tracing every request unless sampled) and calibrate clock */
+    if (TracePath && !log_open(LOG_LEVEL_TRACE, TracePath)) {
+        fatal("Could not open trace file %s: %s", TracePath, strerror(errno));
+    }
+
+    if (TracePath && TraceSampleRate == 0) {
+        TraceSampleRate = 1;
+    }
+
+    if (TraceSampleRate > 0) {
+        trace_init();
+    }
+
+    /* Writes to closed sockets should fail rather than kill the process */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Load mime-types once, and again on SIGHUP */
+    struct sigaction reload = { .sa_handler = mimetypes_stale, .sa_flags = SA_RESTART };
+
+    mimetypes_load(MimeTypesPath);
+    sigaction(SIGHUP, &reload, NULL);
+
     /* Listen to server socket */
     int server_fd = socket_listen(Port);
 
@@ -102,23 +291,62 @@ int main(int argc, char *argv[]) {
         fatal("Could not establish connection to port %s", Port);
     }
 
-    /* Determine real RootPath */
-    char buffer[BUFSIZ]; 
-    RootPath = realpath(RootPath, buffer);
+    /* Determine real RootPath (allocated once and never modified afterwards) */
+    RootPath = realpath(RootPath, NULL);
+
+    if (!RootPath) {
+        fatal("Could not resolve root directory: %s", strerror(errno));
+    }
+
+    /* Hold root directory open so request paths are resolved beneath it */
+    RootFd = open(RootPath, O_PATH | O_DIRECTORY | O_CLOEXEC);
+
+    if (RootFd < 0) {
+        fatal("Could not open root directory: %s", strerror(errno));
+    }
+
+    /* Map metrics shared by all workers (before any of them are forked) */
+    metrics_init();
 
     log("Listening on port %s", Port);
     debug("RootPath        = %s", RootPath);
     debug("MimeTypesPath   = %s", MimeTypesPath);
     debug("DefaultMimeType = %s", DefaultMimeType);
-    debug("ConcurrencyMode = %s", mode == SINGLE ? "Single" : "Forking");
+    debug("ConcurrencyMode = %s", ModeNames[mode]);
+    debug("Workers         = %zu", Workers);
+    debug("MaxRequests     = %zu", MaxRequests);
+    debug("Acceptors       = %zu", Acceptors);
+    debug("KeepAlive       = %ds, %zu requests", KeepAliveTimeout, KeepAliveRequests);
+    debug("FileCacheTTL    = %ds", FileCacheTTL);
+    debug("ResponseCache   = %zu bytes, %zu per file", ResponseCacheBudget, ResponseCacheMaxObject);
+    debug("CompressCache   = %zu bytes, %zu per file", CompressCacheBudget, CompressMaxObject);
+    debug("ScriptWorkers   = %s for .%s, %zu per script, %zu requests, %zu queued", ScriptWorkerLauncher ? ScriptWorkerLauncher : "(none)",
+          ScriptWorkerExtension ? ScriptWorkerExtension : "", ScriptWorkers, ScriptMaxRequests, ScriptQueueLimit);
+    debug("CGITimeout      = %ds", CGITimeout);
+    debug("Listener        = defer accept %ds, fast open queue %d", DeferAccept, FastOpenQueue);
+    debug("StatusPath      = %s", *StatusPath ? StatusPath : "(disabled)");
+    debug("AccessLog       = %s (%s)", AccessLogPath ? AccessLogPath : "(none)", AccessLogCombined ? "combined" : "common");
+    debug("Trace           = %s, 1 in %zu requests", TracePath ? TracePath : "(none)", TraceSampleRate);
 
-    /* Start either forking or single HTTP server */
+    /* Start appropriate HTTP server */
     if (mode == SINGLE) {
         log("Calling single server");
         status = single_server(server_fd);
     } else if (mode == FORKING) {
         log("Calling forking server");
         status = forking_server(server_fd);
+    } else if (mode == EVENT) {
+        log("Calling event server");
+        status = event_server(server_fd);
+    } else if (mode == PREFORK) {
+        log("Calling prefork server");
+        status = prefork_server(server_fd);
+    } else if (mode == THREADED) {
+        log("Calling threaded server");
+        status = threaded_server(server_fd);
+    } else if (mode == URING) {
+        log("Calling uring server");
+        status = uring_server(server_fd);
     }
 
     return status;
@@ -14,6 +14,8 @@
  * @return  Exit status of server (EXIT_SUCCESS).
  **/
 int single_server(int sfd) {
+    filecache_init();
+
     /* Accept and handle HTTP request */
     while (true) {
     	/* Accept request */
@@ -25,8 +27,8 @@ int single_server(int sfd) {
             continue;
         }
 
-	/* Handle request */
-        handle_request(request);
+	/* Handle requests on connection */
+        handle_connection(request);
 
 	/* Free request */
         free_request(request);
@@ -9,7 +9,10 @@
 
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 /**
@@ -17,6 +20,12 @@
  *
  * @param   port        Port number to bind to and listen on.
  * @return  Allocated server socket file descriptor.
+ *
+ * If DeferAccept is set, clients are only accepted once request data has
+ * arrived (TCP_DEFER_ACCEPT), so workers do not wake up for idle connections.
+ * If FastOpenQueue is set, clients may send their request in the SYN
+ * (TCP_FASTOPEN).  Both are best effort: failing to set them is logged and
+ * otherwise ignored.
  **/
 int socket_listen(const char *port) {
    /* Look up server address information */
@@ -39,20 +48,33 @@ int socket_listen(const char *port) {
 
    for (struct addrinfo *p = results; p && server_fd < 0; p = p->ai_next) {
       /* Allocate socket */
-      server_fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+      server_fd = socket(p->ai_family, p->ai_socktype | SOCK_CLOEXEC, p->ai_protocol);
       
       /* Check for failure */
       if (server_fd < 0) {
          continue;
       }
 
-      /* Bind socket to port */
+      /* Bind socket to port (even while old connections linger in TIME_WAIT) */
+      setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int));
+
       if (bind(server_fd, p->ai_addr, p->ai_addrlen) < 0) {
          close(server_fd);
          server_fd = -1;
          continue;
       }
 
+      /* Set optional listener behavior (before listen for TCP_FASTOPEN) */
+      if (DeferAccept > 0 &&
+          setsockopt(server_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &DeferAccept, sizeof(DeferAccept)) < 0) {
+         log("Unable to set TCP_DEFER_ACCEPT: %s", strerror(errno));
+      }
+
+      if (FastOpenQueue > 0 &&
+          setsockopt(server_fd, IPPROTO_TCP, TCP_FASTOPEN, &FastOpenQueue, sizeof(FastOpenQueue)) < 0) {
+         log("Unable to set TCP_FASTOPEN: %s", strerror(errno));
+      }
+
       /* Listen on socket */
       if (listen(server_fd, SOMAXCONN) < 0) {
          close(server_fd);
@@ -65,4 +87,95 @@ int socket_listen(const char *port) {
    return server_fd;
 }
 
+/**
+ * Cork or uncork a TCP socket.
+ *
+ * @param   fd          Socket file descriptor.
+ * @param   on          Whether to hold back partial frames (true) or flush them (false).
+ * @return  0 on success, -1 on failure.
+ *
+ * While corked, the kernel only sends full segments, so response headers
+ * written before a sendfile body leave in the same packets as the body.
+ **/
+int socket_cork(int fd, bool on) {
+    int value = on;
+
+    return setsockopt(fd, IPPROTO_TCP, TCP_CORK, &value, sizeof(value));
+}
+
+/**
+ * Send part of a file to a socket.
+ *
+ * @param   sfd         Socket file descriptor.
+ * @param   fd          File descriptor to send from.
+ * @param   offset      Offset in file to send from (updated on success).
+ * @param   count       Maximum number of bytes to send.
+ * @return  Number of bytes sent (or -1 on error).
+ *
+ * This uses sendfile(2) to copy directly from the page cache.  Filesystems that
+ * do not support sendfile fall back to a pread and send through a bounce buffer.
+ **/
+ssize_t socket_sendfile(int sfd, int fd, off_t *offset, size_t count) {
+    char    buffer[BUFSIZ];
+    ssize_t nread, nsent;
+
+    nsent = sendfile(sfd, fd, offset, count);
+    if (nsent >= 0 || (errno != EINVAL && errno != ENOSYS)) {
+        return nsent;
+    }
+
+    /* Fallback: copy one buffer through user space */
+    nread = pread(fd, buffer, count < sizeof(buffer) ? count : sizeof(buffer), *offset);
+    if (nread <= 0) {
+        return nread;
+    }
+
+    nsent = send(sfd, buffer, nread, MSG_NOSIGNAL);
+    if (nsent > 0) {
+        *offset += nsent;
+    }
+
+    return nsent;
+}
+
+/**
+ * Write all of a vector of buffers to a blocking socket.
+ *
+ * @param   fd          Socket file descriptor.
+ * @param   iov         Array of buffers (modified as buffers are sent).
+ * @param   iovcnt      Number of buffers.
+ * @return  0 on success, -1 on failure.
+ **/
+int socket_writev(int fd, struct iovec *iov, int iovcnt) {
+    uint64_t traced = trace_start();
+
+    while (iovcnt > 0) {
+        ssize_t nwritten = writev(fd, iov, iovcnt);
+
+        if (nwritten < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (nwritten < 0) {
+            trace_end(TRACE_SEND, traced);
+            return -1;
+        }
+
+        /* Skip buffers that were sent completely, then advance into the next */
+        while (iovcnt > 0 && (size_t)nwritten >= iov->iov_len) {
+            nwritten -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+
+        if (iovcnt > 0) {
+            iov->iov_base  = (char *)iov->iov_base + nwritten;
+            iov->iov_len  -= nwritten;
+        }
+    }
+
+    trace_end(TRACE_SEND, traced);
+    return 0;
+}
+
 /* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
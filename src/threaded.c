@@ -0,0 +1,297 @@
+/* threaded.c: Multithreaded HTTP Server */
+
+#include "server.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* Constants */
+
+#define DEQUE_INITIAL_CAPACITY  64
+#define ACCEPT_BATCH            32
+#define ACCEPT_BACKOFF          100     /* Milliseconds to wait after accept fails */
+
+/* Work-Stealing Deque */
+
+typedef struct {
+    pthread_mutex_t lock;               /*< Protects ring buffer */
+    Request       **requests;           /*< Ring buffer of pending requests */
+    size_t          capacity;           /*< Capacity of ring buffer */
+    size_t          head;               /*< Index of oldest request */
+    size_t          size;               /*< Number of pending requests */
+} Deque;
+
+/* Thread Pool */
+
+typedef struct {
+    int             sfd;                /*< Server socket file descriptor */
+    Deque          *deques;             /*< Per-worker deques */
+    pthread_mutex_t lock;               /*< Protects pending */
+    pthread_cond_t  ready;              /*< Signaled when requests are pending */
+    size_t          pending;            /*< Requests not yet claimed by a worker */
+} Pool;
+
+typedef struct {
+    Pool           *pool;               /*< Shared thread pool */
+    size_t          id;                 /*< Index of thread */
+} Worker;
+
+/* Internal Declarations */
+void *    threaded_acceptor(void *arg);
+void *    threaded_worker(void *arg);
+bool      deque_push(Deque *d, Request *r);
+Request * deque_pop(Deque *d);
+Request * deque_steal(Deque *d);
+
+/**
+ * Handle HTTP requests with a pool of acceptor and worker threads.
+ *
+ * @param   sfd         Server socket file descriptor.
+ * @return  Exit status of server (EXIT_SUCCESS or EXIT_FAILURE).
+ *
+ * Acceptors accept requests in batches and hand them round-robin to
+ * per-worker deques.
+ * Each worker serves its own deque oldest-first and, when it runs dry, steals
+ * the newest request from the tail of another worker's deque.  A shared count
+ * of unclaimed requests lets idle workers sleep until there is work to do.
+ **/
+int threaded_server(int sfd) {
+    Pool       pool = { .sfd = sfd, .lock = PTHREAD_MUTEX_INITIALIZER, .ready = PTHREAD_COND_INITIALIZER };
+    pthread_t *threads;
+    Worker    *workers;
+    size_t     nthreads = Workers + Acceptors;
+
+    filecache_init();
+
+    /* Acceptors drain the server socket in batches, so it must not block */
+    if (set_nonblocking(sfd) < 0) {
+        log("Unable to make server socket nonblocking: %s", strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    /* Allocate deques, threads, and thread arguments */
+    pool.deques = calloc(Workers, sizeof(Deque));
+    threads     = calloc(nthreads, sizeof(pthread_t));
+    workers     = calloc(nthreads, sizeof(Worker));
+
+    /* Check for failure */
+    if (!pool.deques || !threads || !workers) {
+        log("Unable to allocate thread pool: %s", strerror(errno));
+        goto fail;
+    }
+
+    for (size_t i = 0; i < Workers; i++) {
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+    }
+
+    /* Start workers, then acceptors */
+    for (size_t i = 0; i < nthreads; i++) {
+        workers[i].pool = &pool;
+        workers[i].id   = i;
+
+        int status = pthread_create(&threads[i], NULL,
+                                    i < Workers ? threaded_worker : threaded_acceptor, &workers[i]);
+
+        if (status != 0) {
+            fatal("Unable to create thread: %s", strerror(status));
+        }
+    }
+
+    /* Wait for threads (which run forever) */
+    for (size_t i = 0; i < nthreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(pool.deques);
+    free(threads);
+    free(workers);
+    return EXIT_SUCCESS;
+
+fail:
+    free(pool.deques);
+    free(threads);
+    free(workers);
+    return EXIT_FAILURE;
+}
+
+/**
+ * Accept requests and distribute them to worker deques.
+ *
+ * @param   arg         Pointer to Worker structure.
+ * @return  NULL.
+ *
+ * The acceptor sleeps in poll until clients are pending, then accepts up to
+ * ACCEPT_BATCH of them and wakes workers once for the whole batch.  If accept
+ * fails (ie. EMFILE) the listener stays readable, so the acceptor sleeps for
+ * ACCEPT_BACKOFF milliseconds instead of spinning.
+ **/
+void * threaded_acceptor(void *arg) {
+    Pool         *pool = ((Worker *)arg)->pool;
+    size_t        next = ((Worker *)arg)->id;
+    Request      *requests[ACCEPT_BATCH];
+    struct pollfd pfd  = { .fd = pool->sfd, .events = POLLIN };
+
+    while (true) {
+        /* Accept batch of requests, waiting for clients if none are pending */
+        size_t n = accept_requests(pool->sfd, requests, ACCEPT_BATCH, 0);
+        size_t queued = 0;
+
+        if (n == 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                poll(&pfd, 1, -1);
+            } else if (errno != EINTR && errno != ECONNABORTED) {
+                log("Unable to accept request: %s", strerror(errno));
+                poll(NULL, 0, ACCEPT_BACKOFF);
+            }
+            continue;
+        }
+
+        /* Push onto next worker deques */
+        for (size_t i = 0; i < n; i++) {
+            if (!deque_push(&pool->deques[next++ % Workers], requests[i])) {
+                log("Unable to queue request: %s", strerror(errno));
+                free_request(requests[i]);
+                continue;
+            }
+            queued++;
+        }
+
+        /* Wake idle workers */
+        pthread_mutex_lock(&pool->lock);
+        pool->pending += queued;
+        if (queued > 1) {
+            pthread_cond_broadcast(&pool->ready);
+        } else if (queued == 1) {
+            pthread_cond_signal(&pool->ready);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return NULL;
+}
+
+/**
+ * Handle requests from own deque, stealing from others when it is empty.
+ *
+ * @param   arg         Pointer to Worker structure.
+ * @return  NULL.
+ *
+ * A worker first claims one pending request, which guarantees that some deque
+ * holds a request for it, and then searches its own deque followed by the
+ * other deques until it finds one.
+ **/
+void * threaded_worker(void *arg) {
+    Pool  *pool = ((Worker *)arg)->pool;
+    size_t id   = ((Worker *)arg)->id;
+
+    while (true) {
+        Request *request = NULL;
+
+        /* Claim a pending request */
+        pthread_mutex_lock(&pool->lock);
+        while (pool->pending == 0) {
+            pthread_cond_wait(&pool->ready, &pool->lock);
+        }
+        pool->pending--;
+        pthread_mutex_unlock(&pool->lock);
+
+        /* Find claimed request in own deque or steal from another */
+        while (!request) {
+            request = deque_pop(&pool->deques[id]);
+
+            for (size_t i = 1; !request && i < Workers; i++) {
+                request = deque_steal(&pool->deques[(id + i) % Workers]);
+            }
+        }
+
+        /* Handle requests on connection */
+        handle_connection(request);
+
+        /* Free request */
+        free_request(request);
+    }
+
+    return NULL;
+}
+
+/**
+ * Push request onto tail of deque.
+ *
+ * @param   d           Deque structure.
+ * @param   r           Request structure.
+ * @return  Whether or not the request was queued.
+ *
+ * The ring buffer doubles in capacity whenever it is full.
+ **/
+bool deque_push(Deque *d, Request *r) {
+    pthread_mutex_lock(&d->lock);
+
+    if (d->size == d->capacity) {
+        size_t   capacity = d->capacity ? 2 * d->capacity : DEQUE_INITIAL_CAPACITY;
+        Request **requests = malloc(capacity * sizeof(Request *));
+
+        if (!requests) {
+            pthread_mutex_unlock(&d->lock);
+            return false;
+        }
+
+        for (size_t i = 0; i < d->size; i++) {
+            requests[i] = d->requests[(d->head + i) % d->capacity];
+        }
+
+        free(d->requests);
+        d->requests = requests;
+        d->capacity = capacity;
+        d->head     = 0;
+    }
+
+    d->requests[(d->head + d->size++) % d->capacity] = r;
+
+    pthread_mutex_unlock(&d->lock);
+    return true;
+}
+
+/**
+ * Pop oldest request from head of deque (owner side).
+ *
+ * @param   d           Deque structure.
+ * @return  Request structure (or NULL if deque is empty).
+ **/
+Request * deque_pop(Deque *d) {
+    Request *r = NULL;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->size > 0) {
+        r       = d->requests[d->head];
+        d->head = (d->head + 1) % d->capacity;
+        d->size--;
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    return r;
+}
+
+/**
+ * Steal newest request from tail of deque (thief side).
+ *
+ * @param   d           Deque structure.
+ * @return  Request structure (or NULL if deque is empty).
+ **/
+Request * deque_steal(Deque *d) {
+    Request *r = NULL;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->size > 0) {
+        r = d->requests[(d->head + --d->size) % d->capacity];
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    return r;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
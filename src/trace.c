@@ -0,0 +1,249 @@
+/* trace.c: Per-Request Phase Tracing */
+
+#include "server.h"
+
+#include <string.h>
+
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define TRACE_X86
+#endif
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TRACE_USDT
+#endif
+#endif
+
+/* Constants */
+
+#define TRACE_MAX_SPANS         32      /* Spans beyond this are dropped */
+#define TRACE_CALIBRATION       20000000 /* Nanoseconds the TSC is calibrated over */
+
+/* Span (one phase of a request) */
+
+typedef struct {
+    TracePhase  phase;
+    uint64_t    start;                  /*< Clock at start of phase */
+    uint64_t    end;                    /*< Clock at end of phase */
+} TraceSpan;
+
+/* Clock (TSC calibrated against CLOCK_MONOTONIC, or CLOCK_MONOTONIC itself) */
+
+static struct {
+    bool        tsc;                    /*< Whether trace_clock reads the TSC */
+    uint64_t    ticks;                  /*< TSC at calibration */
+    uint64_t    nanoseconds;            /*< CLOCK_MONOTONIC at calibration */
+    double      scale;                  /*< Nanoseconds per tick */
+} TraceClock;
+
+/* Trace of current request (one per thread) */
+
+static __thread struct {
+    uint64_t    count;                  /*< Requests begun by thread */
+    uint64_t    started;                /*< Clock at start of request */
+    size_t      nspans;                 /*< Number of spans recorded */
+    TraceSpan   spans[TRACE_MAX_SPANS];
+} Trace;
+
+__thread bool TraceActive = false;
+
+static const char *TracePhaseNames[] = {
+    "request", "queue", "parse", "path", "lookup", "mimetype", "handler", "peer", "send", "log",
+};
+
+/* Internal Declarations */
+uint64_t    trace_nanoseconds(uint64_t clock);
+void        trace_emit(TracePhase phase, uint64_t start, uint64_t end, int pid, int tid);
+
+/**
+ * Calibrate trace clock.
+ *
+ * This must be called before the server forks or starts threads.  On x86
+ * processors with an invariant TSC, trace_clock reads the TSC, which is
+ * converted to CLOCK_MONOTONIC nanoseconds with a scale measured here.
+ * Elsewhere, trace_clock reads CLOCK_MONOTONIC directly.
+ **/
+void trace_init(void) {
+#ifdef TRACE_X86
+    unsigned int    eax, ebx, ecx, edx;
+    struct timespec before, after, pause = { .tv_nsec = TRACE_CALIBRATION };
+    uint64_t        start, end;
+
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1u << 8))) {
+        debug("Tracing with CLOCK_MONOTONIC (no invariant TSC)");
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    start = __rdtsc();
+    nanosleep(&pause, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &after);
+    end   = __rdtsc();
+
+    if (end <= start) {
+        return;
+    }
+
+    TraceClock.ticks       = end;
+    TraceClock.nanoseconds = (uint64_t)after.tv_sec * 1000000000ull + after.tv_nsec;
+    TraceClock.scale       = (double)(TraceClock.nanoseconds - ((uint64_t)before.tv_sec * 1000000000ull + before.tv_nsec)) / (end - start);
+    TraceClock.tsc         = true;
+    debug("Tracing with TSC (%.3f GHz)", 1.0 / TraceClock.scale);
+#endif
+}
+
+/**
+ * Read trace clock.
+ *
+ * @return  TSC ticks or CLOCK_MONOTONIC nanoseconds (see trace_init).
+ **/
+uint64_t trace_clock(void) {
+    struct timespec now;
+
+#ifdef TRACE_X86
+    if (TraceClock.tsc) {
+        return __rdtsc();
+    }
+#endif
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/**
+ * Begin trace of request (if it is sampled).
+ *
+ * @param   r           HTTP Request structure.
+ *
+ * One in TraceSampleRate requests of each thread is traced.  The first request
+ * on a connection also records how long the connection waited between being
+ * accepted and being handled.
+ **/
+void trace_begin(Request *r) {
+    uint64_t accepted = r->accepted;
+
+    r->accepted = 0;
+
+    if (TraceSampleRate == 0 || ++Trace.count % TraceSampleRate != 0) {
+        TraceActive = false;
+        return;
+    }
+
+    TraceActive   = true;
+    Trace.nspans  = 0;
+    Trace.started = trace_clock();
+
+    if (accepted) {
+        trace_span(TRACE_QUEUE, accepted);
+    }
+}
+
+/**
+ * Record span of traced request ending now.
+ *
+ * @param   phase       Phase of request.
+ * @param   start       Clock at start of phase (see trace_start).
+ **/
+void trace_span(TracePhase phase, uint64_t start) {
+    TraceSpan *s;
+
+    if (Trace.nspans >= TRACE_MAX_SPANS) {
+        return;
+    }
+
+    s        = &Trace.spans[Trace.nspans++];
+    s->phase = phase;
+    s->start = start;
+    s->end   = trace_clock();
+}
+
+/**
+ * Finish trace of request.
+ *
+ * @param   r           HTTP Request structure.
+ * @param   status      Status of the HTTP request.
+ *
+ * Each span is written to the trace file (if TracePath is set) as a Chrome
+ * trace event, followed by one event for the whole request.  The spans also
+ * fire USDT probes (c_server:phase and c_server:request) where the server is
+ * built with sys/sdt.h.
+ **/
+void trace_finish(Request *r, Status status) {
+    uint64_t    end    = trace_clock();
+    const char *method = r->method ? r->method : "";
+    const char *uri    = r->uri    ? r->uri    : "";
+    int         pid, tid;
+
+    if (!TraceActive) {
+        return;
+    }
+
+    TraceActive = false;
+    pid         = getpid();
+    tid         = syscall(SYS_gettid);
+
+    for (size_t i = 0; i < Trace.nspans; i++) {
+        trace_emit(Trace.spans[i].phase, Trace.spans[i].start, Trace.spans[i].end, pid, tid);
+    }
+
+#ifdef TRACE_USDT
+    DTRACE_PROBE4(c_server, request, method, uri, http_status_string(status),
+                  trace_nanoseconds(end) - trace_nanoseconds(Trace.started));
+#endif
+
+    if (TracePath) {
+        log_record(LOG_LEVEL_TRACE, __FILE__, __LINE__,
+                   "{\"name\":\"%s\",\"cat\":\"http\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,"
+                   "\"args\":{\"method\":\"%s\",\"uri\":\"%s\",\"status\":\"%.3s\",\"sent\":%lld}},",
+                   TracePhaseNames[TRACE_REQUEST], trace_nanoseconds(Trace.started) / 1000.0,
+                   (trace_nanoseconds(end) - trace_nanoseconds(Trace.started)) / 1000.0, pid, tid,
+                   method, uri, http_status_string(status), (long long)r->content_length);
+    }
+}
+
+/**
+ * Convert trace clock to CLOCK_MONOTONIC nanoseconds.
+ *
+ * @param   clock       Value of trace_clock.
+ * @return  Nanoseconds.
+ **/
+uint64_t trace_nanoseconds(uint64_t clock) {
+    if (!TraceClock.tsc) {
+        return clock;
+    }
+
+    return TraceClock.nanoseconds + (int64_t)((double)(int64_t)(clock - TraceClock.ticks) * TraceClock.scale);
+}
+
+/**
+ * Emit span as USDT probe and trace event.
+ *
+ * @param   phase       Phase of request.
+ * @param   start       Clock at start of phase.
+ * @param   end         Clock at end of phase.
+ * @param   pid         Process id.
+ * @param   tid         Thread id.
+ **/
+void trace_emit(TracePhase phase, uint64_t start, uint64_t end, int pid, int tid) {
+    uint64_t first = trace_nanoseconds(start);
+    uint64_t last  = trace_nanoseconds(end);
+
+#ifdef TRACE_USDT
+    DTRACE_PROBE3(c_server, phase, TracePhaseNames[phase], first, last);
+#endif
+
+    if (TracePath) {
+        log_record(LOG_LEVEL_TRACE, __FILE__, __LINE__,
+                   "{\"name\":\"%s\",\"cat\":\"http\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d},",
+                   TracePhaseNames[phase], first / 1000.0, (last - first) / 1000.0, pid, tid);
+    }
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
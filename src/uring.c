@@ -0,0 +1,763 @@
+/* uring.c: io_uring HTTP Server */
+
+#include "server.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* Constants */
+
+#define URING_ENTRIES       1024        /* Submission queue entries */
+#define URING_BUFFERS       256         /* Provided receive buffers (power of 2) */
+#define URING_BUFFER_SIZE   4096        /* Size of each receive buffer */
+#define URING_BUFFER_GROUP  0           /* Provided buffer group id */
+#define URING_CHUNK_SIZE    65536       /* Size of file body chunks */
+
+/* Operation tags stored in the low bits of user_data */
+
+enum {
+    URING_ACCEPT = 0,
+    URING_RECV,
+    URING_SEND,
+    URING_READ,
+    URING_CLOSE,
+    URING_TICK,
+    URING_HELPERS,
+    URING_MASK   = 7,
+};
+
+/* Ring */
+
+typedef struct {
+    int                      fd;        /*< io_uring file descriptor */
+    unsigned                *sq_head;   /*< Submission queue head (kernel) */
+    unsigned                *sq_tail;   /*< Submission queue tail (shared) */
+    unsigned                *sq_mask;   /*< Submission queue mask */
+    unsigned                *sq_array;  /*< Submission queue index array */
+    unsigned                 sq_entries;/*< Number of submission entries */
+    unsigned                 sq_local;  /*< Submission tail not yet published */
+    struct io_uring_sqe     *sqes;      /*< Submission queue entries */
+    unsigned                *cq_head;   /*< Completion queue head (shared) */
+    unsigned                *cq_tail;   /*< Completion queue tail (kernel) */
+    unsigned                *cq_mask;   /*< Completion queue mask */
+    struct io_uring_cqe     *cqes;      /*< Completion queue entries */
+    struct io_uring_buf_ring*br;        /*< Provided buffer ring */
+    unsigned short           br_tail;   /*< Provided buffer ring tail */
+    char                    *buffers;   /*< Provided buffer memory */
+    void                    *ring_ptr;  /*< Mapped rings */
+    size_t                   ring_size; /*< Size of mapped rings */
+    size_t                   sqes_size; /*< Size of mapped entries */
+} Ring;
+
+/* Connection */
+
+typedef struct connection Connection;
+struct connection {
+    Request    *request;                /*< Client request */
+    char       *output;                 /*< Buffered response headers (and body) */
+    size_t      output_size;            /*< Size of buffered response */
+    size_t      output_sent;            /*< Bytes of response already sent */
+    char       *chunk;                  /*< File body chunk buffer */
+    size_t      chunk_length;           /*< Bytes in current chunk */
+    size_t      chunk_sent;             /*< Bytes of chunk already sent */
+    int         inflight;               /*< Operations not yet completed */
+    bool        closing;                /*< Whether connection should be closed */
+    bool        deferred;               /*< Whether request is with a helper thread */
+    time_t      deadline;               /*< Time at which idle connection is shut down */
+    Connection *prev;                   /*< Previous connection in idle list */
+    Connection *next;                   /*< Next connection in idle list */
+};
+
+/* Idle list ordered by deadline (oldest activity first) */
+static Connection *Oldest = NULL;
+static Connection *Newest = NULL;
+
+/* Interval between idle connection sweeps */
+static struct __kernel_timespec Tick = { .tv_sec = 1 };
+
+/* Eventfd of helper threads and count read from it */
+static int      HelperFd = -1;
+static uint64_t HelperCount;
+
+/* Internal Declarations */
+int                   ring_setup(Ring *ring);
+void                  ring_teardown(Ring *ring);
+struct io_uring_sqe * ring_sqe(Ring *ring, Connection *c, int op);
+int                   ring_submit(Ring *ring, unsigned wait);
+void                  ring_return_buffer(Ring *ring, unsigned short bid);
+void                  uring_accept(Ring *ring, int sfd);
+void                  uring_recv(Ring *ring, Connection *c);
+void                  uring_respond(Ring *ring, Connection *c);
+void                  uring_send(Ring *ring, Connection *c);
+void                  uring_close(Ring *ring, Connection *c);
+void                  uring_complete(Ring *ring, int sfd, struct io_uring_cqe *cqe);
+void                  uring_tick(Ring *ring);
+void                  uring_helpers(Ring *ring);
+void                  uring_resume(Ring *ring);
+void                  uring_sweep(void);
+void                  uring_touch(Connection *c);
+void                  uring_unlink(Connection *c);
+
+/**
+ * Handle HTTP requests with an io_uring completion loop.
+ *
+ * @param   sfd         Server socket file descriptor.
+ * @return  Exit status of server (EXIT_SUCCESS or EXIT_FAILURE).
+ *
+ * Clients are accepted with a single multishot accept, request headers are
+ * received into kernel-selected provided buffers, and file bodies are sent as
+ * linked read and send pairs.  All operations queued while processing a batch
+ * of completions are submitted with the next io_uring_enter, which also waits
+ * for more completions.
+ *
+ * CGI requests would block the loop, so they are handed to helper threads
+ * (see offload_init), whose eventfd is read by the ring to resume them.
+ *
+ * Persistent connections go back to receiving after each response.  A timeout
+ * operation fires every second to shut down connections that have been idle
+ * for KeepAliveTimeout seconds, which completes their pending receive.
+ *
+ * If io_uring is not available, then this falls back to the epoll server.
+ **/
+int uring_server(int sfd) {
+    Ring ring;
+
+    /* Setup ring */
+    if (ring_setup(&ring) < 0) {
+        log("Unable to setup io_uring (%s), falling back to event server", strerror(errno));
+        return event_server(sfd);
+    }
+
+    filecache_init();
+
+    /* Start helper threads */
+    if ((HelperFd = offload_init()) < 0) {
+        log("Unable to start helper threads: %s", strerror(errno));
+        ring_teardown(&ring);
+        return EXIT_FAILURE;
+    }
+
+    /* Accept clients, wait for helpers, and start sweeping idle connections */
+    uring_accept(&ring, sfd);
+    uring_helpers(&ring);
+    if (KeepAliveTimeout > 0) {
+        uring_tick(&ring);
+    }
+
+    /* Submit operations and dispatch completions */
+    while (true) {
+        if (ring_submit(&ring, 1) < 0 && errno != EINTR && errno != EBUSY) {
+            log("Unable to io_uring_enter: %s", strerror(errno));
+            break;
+        }
+
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+
+        while (head != tail) {
+            struct io_uring_cqe cqe = ring.cqes[head++ & *ring.cq_mask];
+
+            __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+            uring_complete(&ring, sfd, &cqe);
+        }
+    }
+
+    ring_teardown(&ring);
+    return EXIT_FAILURE;
+}
+
+/**
+ * Dispatch completion to the appropriate connection handler.
+ *
+ * @param   ring        Ring structure.
+ * @param   sfd         Server socket file descriptor.
+ * @param   cqe         Completion queue entry.
+ **/
+void uring_complete(Ring *ring, int sfd, struct io_uring_cqe *cqe) {
+    Connection *c   = (Connection *)(uintptr_t)(cqe->user_data & ~(uint64_t)URING_MASK);
+    int         op  = cqe->user_data & URING_MASK;
+    int         res = cqe->res;
+
+    switch (op) {
+        case URING_ACCEPT:
+            if (res >= 0) {
+                Connection *client = calloc(1, sizeof(Connection));
+
+                if (!client || !(client->request = create_request(res))) {
+                    log("Unable to allocate connection: %s", strerror(errno));
+                    free(client);
+                    close(res);
+                } else {
+                    uring_touch(client);
+                    metrics_connection(1);
+                    uring_recv(ring, client);
+                }
+            } else {
+                log("Unable to accept request: %s", strerror(-res));
+            }
+
+            /* Rearm multishot accept if it was terminated */
+            if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                uring_accept(ring, sfd);
+            }
+            return;
+
+        case URING_CLOSE:
+            return;
+
+        case URING_TICK:
+            uring_sweep();
+            uring_tick(ring);
+            return;
+
+        case URING_HELPERS:
+            uring_resume(ring);
+            uring_helpers(ring);
+            return;
+    }
+
+    c->inflight--;
+    uring_touch(c);
+
+    switch (op) {
+        case URING_RECV:
+            if (cqe->flags & IORING_CQE_F_BUFFER) {
+                unsigned short bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+                Request       *r   = c->request;
+
+                /* uring_recv limits the receive to what fits in the request buffer */
+                if (res > 0) {
+                    memcpy(r->buffer + r->length, ring->buffers + bid * URING_BUFFER_SIZE, res);
+                    r->length += res;
+                }
+
+                ring_return_buffer(ring, bid);
+            }
+
+            if (res == -ENOBUFS) {
+                uring_recv(ring, c);
+            } else if (res <= 0) {
+                c->closing = true;
+            } else if (request_headers_complete(c->request)) {
+                uring_respond(ring, c);
+            } else {
+                uring_recv(ring, c);
+            }
+            break;
+
+        case URING_READ:
+            /* A short read cancels the linked send, so just close afterwards */
+            if (res != (int)c->chunk_length) {
+                c->closing = true;
+            }
+            break;
+
+        case URING_SEND:
+            if (res < 0) {
+                c->closing = true;
+            } else if (c->output_sent < c->output_size) {
+                c->output_sent += res;
+            } else {
+                c->chunk_sent  += res;
+            }
+
+            if (!c->closing) {
+                uring_send(ring, c);
+            }
+            break;
+    }
+
+    if (c->closing && c->inflight == 0) {
+        uring_close(ring, c);
+    }
+}
+
+/**
+ * Queue multishot accept on server socket.
+ *
+ * @param   ring        Ring structure.
+ * @param   sfd         Server socket file descriptor.
+ **/
+void uring_accept(Ring *ring, int sfd) {
+    struct io_uring_sqe *sqe = ring_sqe(ring, NULL, URING_ACCEPT);
+
+    sqe->opcode       = IORING_OP_ACCEPT;
+    sqe->fd           = sfd;
+    sqe->ioprio       = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+}
+
+/**
+ * Queue receive of more request data into a provided buffer.
+ *
+ * @param   ring        Ring structure.
+ * @param   c           Client connection.
+ *
+ * The receive is limited to the free space of the request buffer, so nothing
+ * received is ever dropped.  This is only called while the header block is
+ * incomplete, which the parser treats as malformed (and answers with 400)
+ * once the request buffer is full, so there is always free space.
+ **/
+void uring_recv(Ring *ring, Connection *c) {
+    struct io_uring_sqe *sqe = ring_sqe(ring, c, URING_RECV);
+    Request             *r   = c->request;
+
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = r->fd;
+    sqe->len       = sizeof(r->buffer) - r->length;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+}
+
+/**
+ * Handle complete request and begin sending response.
+ *
+ * @param   ring        Ring structure.
+ * @param   c           Client connection.
+ *
+ * The response headers (and any non-file body) are rendered into an in-memory
+ * stream, while file bodies are left open by handle_file_request so they can
+ * be sent in chunks by the ring.  Requests with a blocking handler are handed
+ * to a helper thread instead, and the connection leaves the idle list until
+ * uring_resume gets it back.
+ **/
+void uring_respond(Ring *ring, Connection *c) {
+    Request *r = c->request;
+
+    r->stream = open_memstream(&c->output, &c->output_size);
+    if (!r->stream) {
+        log("Unable to open_memstream: %s", strerror(errno));
+        c->closing = true;
+        return;
+    }
+
+    r->defer_body = true;
+    handle_request(r);
+
+    /* Hand blocking handler to a helper thread (or run it here if that fails) */
+    if (r->deferred && offload_request(r, c)) {
+        c->deferred = true;
+        uring_unlink(c);
+        return;
+    }
+
+    if (r->deferred) {
+        log("Unable to queue request for helper thread: %s", strerror(errno));
+        resume_request(r);
+    }
+
+    fclose(r->stream);
+    r->stream = NULL;
+
+    uring_send(ring, c);
+}
+
+/**
+ * Queue read of helper eventfd, which completes once requests have finished.
+ *
+ * @param   ring        Ring structure.
+ **/
+void uring_helpers(Ring *ring) {
+    struct io_uring_sqe *sqe = ring_sqe(ring, NULL, URING_HELPERS);
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd     = HelperFd;
+    sqe->addr   = (uintptr_t)&HelperCount;
+    sqe->len    = sizeof(HelperCount);
+}
+
+/**
+ * Resume connections whose requests helper threads have finished.
+ *
+ * @param   ring        Ring structure.
+ **/
+void uring_resume(Ring *ring) {
+    Connection *c;
+
+    while ((c = offload_finished())) {
+        fclose(c->request->stream);
+        c->request->stream = NULL;
+        c->deferred        = false;
+        uring_touch(c);
+        uring_send(ring, c);
+
+        if (c->closing && c->inflight == 0) {
+            uring_close(ring, c);
+        }
+    }
+}
+
+/**
+ * Queue next send of response data.
+ *
+ * @param   ring        Ring structure.
+ * @param   c           Client connection.
+ *
+ * Buffered output is sent first, then any remaining part of the current file
+ * chunk, and then the next file chunk as a linked read and send pair.  Once
+ * everything has been sent, the connection is either closed or reset for the
+ * next request.
+ **/
+void uring_send(Ring *ring, Connection *c) {
+    Request             *r    = c->request;
+    bool                 more = r->body_fd >= 0 && r->body_offset < r->body_length;
+    struct io_uring_sqe *sqe;
+
+    /* Send remaining buffered output */
+    if (c->output_sent < c->output_size) {
+        sqe            = ring_sqe(ring, c, URING_SEND);
+        sqe->opcode    = IORING_OP_SEND;
+        sqe->fd        = r->fd;
+        sqe->addr      = (uintptr_t)(c->output + c->output_sent);
+        sqe->len       = c->output_size - c->output_sent;
+        sqe->msg_flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+        return;
+    }
+
+    /* Send remaining part of current chunk */
+    if (c->chunk_sent < c->chunk_length) {
+        sqe            = ring_sqe(ring, c, URING_SEND);
+        sqe->opcode    = IORING_OP_SEND;
+        sqe->fd        = r->fd;
+        sqe->addr      = (uintptr_t)(c->chunk + c->chunk_sent);
+        sqe->len       = c->chunk_length - c->chunk_sent;
+        sqe->msg_flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+        return;
+    }
+
+    /* Read and send next chunk of file body */
+    if (more) {
+        if (!c->chunk && !(c->chunk = malloc(URING_CHUNK_SIZE))) {
+            c->closing = true;
+            return;
+        }
+
+        c->chunk_length = r->body_length - r->body_offset;
+        c->chunk_length = c->chunk_length < URING_CHUNK_SIZE ? c->chunk_length : URING_CHUNK_SIZE;
+        c->chunk_sent   = 0;
+
+        /* Make sure the linked pair is not split across submissions */
+        if (*ring->sq_head + ring->sq_entries - ring->sq_local < 2) {
+            ring_submit(ring, 0);
+        }
+
+        sqe            = ring_sqe(ring, c, URING_READ);
+        sqe->opcode    = IORING_OP_READ;
+        sqe->fd        = r->body_fd;
+        sqe->flags     = IOSQE_IO_LINK;
+        sqe->addr      = (uintptr_t)c->chunk;
+        sqe->len       = c->chunk_length;
+        sqe->off       = r->body_offset;
+
+        r->body_offset += c->chunk_length;
+        more = r->body_offset < r->body_length;
+
+        sqe            = ring_sqe(ring, c, URING_SEND);
+        sqe->opcode    = IORING_OP_SEND;
+        sqe->fd        = r->fd;
+        sqe->addr      = (uintptr_t)c->chunk;
+        sqe->len       = c->chunk_length;
+        sqe->msg_flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+        return;
+    }
+
+    /* Response complete */
+    if (!r->keep_alive) {
+        c->closing = true;
+        return;
+    }
+
+    /* Reset connection and handle pipelined request or wait for next one */
+    free(c->output);
+    c->output       = NULL;
+    c->output_size  = 0;
+    c->output_sent  = 0;
+    c->chunk_length = 0;
+    c->chunk_sent   = 0;
+    reset_request(r);
+
+    if (request_headers_complete(r)) {
+        uring_respond(ring, c);
+    } else {
+        uring_recv(ring, c);
+    }
+}
+
+/**
+ * Close client connection.
+ *
+ * @param   ring        Ring structure.
+ * @param   c           Client connection.
+ *
+ * The client socket and any file body not shared through the file cache are
+ * closed asynchronously by the ring.
+ **/
+void uring_close(Ring *ring, Connection *c) {
+    Request *r = c->request;
+    int      fds[] = {r->fd, r->file ? -1 : r->body_fd};
+
+    for (size_t i = 0; i < sizeof(fds) / sizeof(int); i++) {
+        if (fds[i] >= 0) {
+            struct io_uring_sqe *sqe = ring_sqe(ring, NULL, URING_CLOSE);
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd     = fds[i];
+        }
+    }
+
+    r->fd      = -1;
+    r->body_fd = -1;
+
+    metrics_connection(-1);
+    uring_unlink(c);
+    free_request(r);
+    free(c->output);
+    free(c->chunk);
+    free(c);
+}
+
+/**
+ * Queue timeout that triggers the next idle connection sweep.
+ *
+ * @param   ring        Ring structure.
+ **/
+void uring_tick(Ring *ring) {
+    struct io_uring_sqe *sqe = ring_sqe(ring, NULL, URING_TICK);
+
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->addr   = (uintptr_t)&Tick;
+    sqe->len    = 1;
+}
+
+/**
+ * Shut down connections that have been idle for too long.
+ *
+ * Shutting down the socket completes any pending receive, which then closes
+ * the connection through the normal completion path.
+ **/
+void uring_sweep(void) {
+    time_t now = time(NULL);
+
+    while (Oldest && Oldest->deadline <= now) {
+        Connection *c = Oldest;
+
+        debug("Closing idle connection from %s:%s", request_host(c->request), request_port(c->request));
+        shutdown(c->request->fd, SHUT_RDWR);
+        uring_unlink(c);
+    }
+}
+
+/**
+ * Record activity on connection by moving it to the end of the idle list.
+ *
+ * @param   c           Client connection.
+ **/
+void uring_touch(Connection *c) {
+    uring_unlink(c);
+
+    c->deadline = time(NULL) + KeepAliveTimeout;
+    c->prev     = Newest;
+    c->next     = NULL;
+
+    if (Newest) {
+        Newest->next = c;
+    } else {
+        Oldest = c;
+    }
+    Newest = c;
+}
+
+/**
+ * Remove connection from idle list.
+ *
+ * @param   c           Client connection.
+ **/
+void uring_unlink(Connection *c) {
+    if (c->prev) {
+        c->prev->next = c->next;
+    } else if (Oldest == c) {
+        Oldest = c->next;
+    }
+
+    if (c->next) {
+        c->next->prev = c->prev;
+    } else if (Newest == c) {
+        Newest = c->prev;
+    }
+
+    c->prev = c->next = NULL;
+}
+
+/**
+ * Setup io_uring instance and provided buffer ring.
+ *
+ * @param   ring        Ring structure.
+ * @return  -1 on error and 0 on success.
+ *
+ * This uses the raw system calls so that no additional library is required.
+ **/
+int ring_setup(Ring *ring) {
+    struct io_uring_params params;
+    struct io_uring_buf_reg reg;
+
+    memset(ring, 0, sizeof(Ring));
+    memset(&params, 0, sizeof(params));
+    ring->ring_ptr = MAP_FAILED;
+    ring->sqes     = MAP_FAILED;
+    ring->br       = MAP_FAILED;
+
+    /* Create io_uring instance */
+    ring->fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (ring->fd < 0) {
+        return -1;
+    }
+
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        errno = ENOSYS;
+        goto fail;
+    }
+
+    /* Map submission and completion rings */
+    ring->ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    if (params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe) > ring->ring_size) {
+        ring->ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    }
+
+    ring->ring_ptr = mmap(NULL, ring->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring->fd, IORING_OFF_SQ_RING);
+    if (ring->ring_ptr == MAP_FAILED) {
+        goto fail;
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes      = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        goto fail;
+    }
+
+    char *ptr        = ring->ring_ptr;
+    ring->sq_head    = (unsigned *)(ptr + params.sq_off.head);
+    ring->sq_tail    = (unsigned *)(ptr + params.sq_off.tail);
+    ring->sq_mask    = (unsigned *)(ptr + params.sq_off.ring_mask);
+    ring->sq_array   = (unsigned *)(ptr + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+    ring->sq_local   = *ring->sq_tail;
+    ring->cq_head    = (unsigned *)(ptr + params.cq_off.head);
+    ring->cq_tail    = (unsigned *)(ptr + params.cq_off.tail);
+    ring->cq_mask    = (unsigned *)(ptr + params.cq_off.ring_mask);
+    ring->cqes       = (struct io_uring_cqe *)(ptr + params.cq_off.cqes);
+
+    /* Register provided buffer ring */
+    ring->br      = mmap(NULL, URING_BUFFERS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ring->buffers = malloc(URING_BUFFERS * URING_BUFFER_SIZE);
+    if (ring->br == MAP_FAILED || !ring->buffers) {
+        goto fail;
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr    = (uintptr_t)ring->br;
+    reg.ring_entries = URING_BUFFERS;
+    reg.bgid         = URING_BUFFER_GROUP;
+
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        goto fail;
+    }
+
+    for (unsigned short bid = 0; bid < URING_BUFFERS; bid++) {
+        ring_return_buffer(ring, bid);
+    }
+
+    return 0;
+
+fail:
+    ring_teardown(ring);
+    return -1;
+}
+
+/**
+ * Release io_uring instance and associated memory.
+ *
+ * @param   ring        Ring structure.
+ **/
+void ring_teardown(Ring *ring) {
+    int saved = errno;
+
+    if (ring->br != MAP_FAILED)       munmap(ring->br, URING_BUFFERS * sizeof(struct io_uring_buf));
+    if (ring->sqes != MAP_FAILED)     munmap(ring->sqes, ring->sqes_size);
+    if (ring->ring_ptr != MAP_FAILED) munmap(ring->ring_ptr, ring->ring_size);
+    if (ring->fd >= 0)                close(ring->fd);
+    free(ring->buffers);
+
+    errno = saved;
+}
+
+/**
+ * Get next submission queue entry.
+ *
+ * @param   ring        Ring structure.
+ * @param   c           Client connection (or NULL).
+ * @param   op          Operation tag.
+ * @return  Zeroed submission queue entry tagged with connection and operation.
+ *
+ * If the submission queue is full, pending entries are submitted first.
+ **/
+struct io_uring_sqe * ring_sqe(Ring *ring, Connection *c, int op) {
+    while (ring->sq_local - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+        ring_submit(ring, 0);
+    }
+
+    unsigned             index = ring->sq_local++ & *ring->sq_mask;
+    struct io_uring_sqe *sqe   = &ring->sqes[index];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->user_data        = (uintptr_t)c | op;
+    ring->sq_array[index] = index;
+
+    if (c) {
+        c->inflight++;
+    }
+
+    return sqe;
+}
+
+/**
+ * Submit pending entries and optionally wait for completions.
+ *
+ * @param   ring        Ring structure.
+ * @param   wait        Minimum number of completions to wait for.
+ * @return  Number of entries submitted (or -1 on error).
+ **/
+int ring_submit(Ring *ring, unsigned wait) {
+    unsigned pending = ring->sq_local - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local, __ATOMIC_RELEASE);
+
+    return syscall(__NR_io_uring_enter, ring->fd, pending, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+/**
+ * Return provided buffer to the kernel.
+ *
+ * @param   ring        Ring structure.
+ * @param   bid         Buffer id.
+ **/
+void ring_return_buffer(Ring *ring, unsigned short bid) {
+    struct io_uring_buf *buf = &ring->br->bufs[ring->br_tail & (URING_BUFFERS - 1)];
+
+    buf->addr = (uintptr_t)(ring->buffers + bid * URING_BUFFER_SIZE);
+    buf->len  = URING_BUFFER_SIZE;
+    buf->bid  = bid;
+
+    __atomic_store_n(&ring->br->tail, ++ring->br_tail, __ATOMIC_RELEASE);
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -4,112 +4,230 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 
+#include <linux/openat2.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
+/* Internal Declarations */
+char *  determine_request_realpath(const char *path);
+
 /**
  * Determine mime-type from file extension.
  *
  * @param   path        Path to file.
- * @return  An allocated string containing the mime-type of the specified file.
- *
- * This function first finds the file's extension and then scans the contents
- * of the MimeTypesPath file to determine which mimetype the file has.
- *
- * The MimeTypesPath file (typically /etc/mime.types) consists of rules in the
- * following format:
+ * @return  A borrowed string containing the mime-type of the specified file.
  *
- *  <MIMETYPE>      <EXT1> <EXT2> ...
- *
- * This function simply checks the file extension version each extension for
- * each mimetype and returns the mimetype on the first match.
+ * This function finds the file's extension and looks it up in the mime-types
+ * index loaded from MimeTypesPath (reloading it first if requested).
  *
  * If no extension exists or no matching mimetype is found, then return
  * DefaultMimeType.
+ **/
+const char * determine_mimetype(const char *path) {
+    const char *ext      = strrchr(path, '.');
+    const char *mimetype = NULL;
+    uint64_t    traced   = trace_start();
+
+    mimetypes_refresh();
+
+    /* Find file extension (ignoring dots in directory names) */
+    if (ext && !strchr(ext, '/')) {
+        mimetype = mimetypes_lookup(ext + 1);
+    }
+
+    trace_end(TRACE_MIMETYPE, traced);
+    return mimetype ? mimetype : DefaultMimeType;
+}
+
+/**
+ * Determine actual filesystem path based on RootPath and URI.
+ *
+ * @param   uri         Resource path of URI.
+ * @return  An allocated string containing the full path of the resource on
+ * the local filesystem (or NULL if it is too long).
  *
- * This function returns an allocated string that must be free'd.
+ * The URI's dot segments are removed (as in RFC 3986, so ".." never climbs
+ * above the root) and the rest is appended to RootPath, keeping a trailing
+ * slash, which requires a directory.  This touches no filesystem at all: the
+ * path is only ever opened with open_request_path, which resolves it beneath
+ * the root, and the file cache remembers what it resolved to.
+ *
+ * The returned string must later be free'd.
  **/
+char * determine_request_path(const char *uri) {
+    char   relative[BUFSIZ];
+    char   path[BUFSIZ];
+    size_t length = 0;
 
-char * determine_mimetype(const char *path) {
-    char *ext;
-    char *mimetype;
-    char *token;
-    char buffer[BUFSIZ];
-    FILE *fs = NULL;
+    log("Determining request path");
 
-    /* Find file extension */
-    ext = strrchr(path, '.');
+    /* Remove dot segments and empty segments */
+    for (const char *s = uri; *s; ) {
+        size_t n;
 
-    if (!ext) {
-        return strdup(DefaultMimeType);
-    } else {
-        ext++;
-    }
+        while (*s == '/') {
+            s++;
+        }
 
-    /* Open MimeTypesPath file */
-    fs = fopen(MimeTypesPath, "r");
+        n = strcspn(s, "/");
 
-    /* Check for failure */
-    if (!fs) {
-        debug("Unable to fopen: %s", strerror(errno));
-        fclose(fs);
-        return NULL;
+        if ((n == 1 && s[0] == '.') || n == 0) {
+            /* Skip */
+        } else if (n == 2 && s[0] == '.' && s[1] == '.') {
+            while (length > 0 && relative[--length] != '/');
+        } else if (length + n + 2 < sizeof(relative)) {
+            if (length > 0) {
+                relative[length++] = '/';
+            }
+            memcpy(relative + length, s, n);
+            length += n;
+        } else {
+            debug("Request path is too long");
+            return NULL;
+        }
+
+        s += n;
     }
 
-    /* Scan file for matching file extensions */
-    while (fgets(buffer, BUFSIZ, fs)) {
-        mimetype = strtok(skip_whitespace(buffer), WHITESPACE);
-        token    = strtok(NULL, WHITESPACE);
-        while (token) {
-            if (streq(token, ext)) {
-                if (fs) fclose(fs);
-                return strdup(mimetype);
-            }
+    if (length == 0) {
+        return strdup(RootPath);
+    }
 
-            token = strtok(NULL, WHITESPACE);
-        }
+    /* A trailing slash requires a directory (so it is kept for resolving) */
+    if (uri[strlen(uri) - 1] == '/') {
+        relative[length++] = '/';
+    }
+
+    relative[length] = '\0';
+    if (snprintf(path, sizeof(path), "%s%s%s", RootPath, streq(RootPath, "/") ? "" : "/", relative) >= (int)sizeof(path)) {
+        return NULL;
     }
 
-    fclose(fs);
-    return strdup(DefaultMimeType);
+    return strdup(path);
 }
 
 /**
- * Determine actual filesystem path based on RootPath and URI.
- *
- * @param   uri         Resource path of URI.
- * @return  An allocated string containing the full path of the resource on the
- * local filesystem.
+ * Open request path beneath the root directory.
  *
- * This function uses realpath(3) to generate the realpath of the
- * file requested in the URI.
+ * @param   path        Path returned by determine_request_path.
+ * @param   flags       Flags of open(2) (O_CLOEXEC is always added).
+ * @return  File descriptor (or -1 with errno set if the path cannot be opened
+ * or does not lead to something beneath RootPath).
  *
- * As a security check, if the real path does not begin with the RootPath, then
- * return NULL.
+ * The part of the path below RootPath is resolved relative to RootFd with a
+ * single openat2(2) using RESOLVE_BENEATH and RESOLVE_NO_MAGICLINKS.  The
+ * kernel rejects any path (including through symlinks, even ones swapped in
+ * after an earlier check) that would leave the root, so the descriptor always
+ * refers to something beneath it.  Everything the server opens on behalf of a
+ * request goes through here.
  *
- * Otherwise, return a newly allocated string containing the real path.  This
- * string must later be free'd.
+ * Kernels without openat2 fall back to realpath(3), checking the resolved
+ * path against RootPath.
  **/
-char * determine_request_path(const char *uri) {
-    char real_path[BUFSIZ];
-    char buffer   [BUFSIZ];
+int open_request_path(const char *path, int flags) {
+    size_t      length   = strlen(RootPath);
+    const char *relative = path + length;
+    char       *resolved;
+    int         fd;
 
-    log("Determining request path");
+    if (strncmp(path, RootPath, length) != 0 ||
+        (*relative != '/' && *relative != '\0' && !streq(RootPath, "/"))) {
+        errno = EXDEV;
+        return -1;
+    }
+
+    while (*relative == '/') {
+        relative++;
+    }
+
+    struct open_how how = {
+        .flags   = flags | O_CLOEXEC,
+        .resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS,
+    };
+
+    fd = syscall(SYS_openat2, RootFd, *relative ? relative : ".", &how, sizeof(how));
+
+    if (fd >= 0 || errno != ENOSYS) {
+        return fd;
+    }
+
+    if (!(resolved = determine_request_realpath(path))) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    fd = open(resolved, flags | O_CLOEXEC);
+    free(resolved);
+    return fd;
+}
+
+/**
+ * Determine actual filesystem path with realpath(3).
+ *
+ * @param   path        Path beneath RootPath (without dot segments).
+ * @return  An allocated string containing the real path (or NULL if it does
+ * not exist or is not beneath RootPath).
+ *
+ * This is the fallback for kernels without openat2(2).
+ **/
+char * determine_request_realpath(const char *path) {
+    char  *resolved = realpath(path, NULL);
+    size_t length   = strlen(RootPath);
 
-    if (sprintf(real_path, "%s%s", RootPath, uri)) {
-        realpath(real_path, buffer);
+    if (!resolved) {
+        return NULL;
     }
 
-    if (strncmp(real_path, RootPath, strlen(RootPath))) {
+    if (strncmp(resolved, RootPath, length) != 0 ||
+        (resolved[length] != '/' && resolved[length] != '\0' && !streq(RootPath, "/"))) {
         debug("Real path does not begin with %s", RootPath);
+        free(resolved);
         return NULL;
-    } else {
-        return strdup(real_path);
     }
 
-    return NULL;
+    return resolved;
+}
+
+/**
+ * Format time as HTTP date.
+ *
+ * @param   time        Time to format.
+ * @param   buffer      Buffer to store date in.
+ * @param   size        Size of buffer.
+ * @return  Length of date (or 0 if buffer is too small).
+ *
+ * HTTP dates are always in GMT (ie. "Sun, 06 Nov 1994 08:49:37 GMT").
+ **/
+size_t format_http_date(time_t time, char *buffer, size_t size) {
+    struct tm tm;
+
+    if (!gmtime_r(&time, &tm)) {
+        return 0;
+    }
+
+    return strftime(buffer, size, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+/**
+ * Parse HTTP date.
+ *
+ * @param   date        HTTP date string (ie. "Sun, 06 Nov 1994 08:49:37 GMT").
+ * @return  Parsed time (or -1 if date is invalid).
+ **/
+time_t parse_http_date(const char *date) {
+    struct tm tm = {0};
+    char     *end;
+
+    end = strptime(date, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (!end || *end) {
+        return -1;
+    }
+
+    return timegm(&tm);
 }
 
 /**
@@ -123,23 +241,45 @@ char * determine_request_path(const char *uri) {
 const char * http_status_string(Status status) {
     static char *StatusStrings[] = {
         "200 OK",
+        "206 Partial Content",
+        "304 Not Modified",
         "400 Bad Request",
         "404 Not Found",
+        "416 Range Not Satisfiable",
         "500 Internal Server Error",
+        "503 Service Unavailable",
+        "504 Gateway Timeout",
         "418 I'm A Teapot",
     };
 
     return StatusStrings[status];
 }
 
+/**
+ * Set file descriptor to nonblocking mode.
+ *
+ * @param   fd          File descriptor.
+ * @return  -1 on error and 0 on success.
+ **/
+int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+
+    if (flags < 0) {
+        return -1;
+    }
+
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
 /**
  * Advance string pointer pass all nonwhitespace characters
  *
  * @param   s           String.
- * @return  Point to first whitespace character in s.
+ * @return  Point to first whitespace character in s (or to its terminating
+ *          NUL if there is none).
  **/
 char * skip_nonwhitespace(char *s) {
-    if (!isspace(*s)) while (!isspace(*s)) s++;
+    while (*s && !isspace((unsigned char)*s)) s++;
 
     return s;
 }
@@ -151,7 +291,7 @@ char * skip_nonwhitespace(char *s) {
  * @return  Point to first non-whitespace character in s.
  **/
 char * skip_whitespace(char *s) {
-    if (isspace(*s)) while (isspace(*s)) s++;
+    while (isspace((unsigned char)*s)) s++;
 
     return s;
 }